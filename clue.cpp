@@ -5,18 +5,47 @@
 #include <algorithm>
 #include <random>
 #include <map>
+#include <unordered_map>
 #include <curl/curl.h> // Required for making HTTP requests
+#include <zlib.h> // For decoding PNG previews
 #include <sstream>
 #include <stdexcept>
 #include <cstring>
 #include <tuple>
 #include <memory> // Include the <memory> header
+#include <cstdint>
+#include <cmath>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <functional>
+#include <fstream>
+#include <chrono>
 #include <sys/stat.h> // For creating directories
 #include <libgen.h> // For dirname
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <sys/ioctl.h> // For the terminal size
+#include <sys/mman.h> // For mapping game records
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/file.h> // For flock
+#include <sys/resource.h> // For setpriority
+#include <sys/wait.h>
+#include <sys/epoll.h> // For the multiplayer server
+#ifdef __SSE2__
+#include <emmintrin.h> // For downscaling image previews
+#endif
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 // INSTRUCTIONS:
-// 1. Install libcurl:  sudo apt-get install libcurl4-openssl-dev
-// 2. Compile with: g++ clue.cpp -lcurl -o clue
+// 1. Install libcurl and zlib:  sudo apt-get install libcurl4-openssl-dev zlib1g-dev
+// 2. Compile with: make clue (or g++ -std=c++11 clue.cpp -o clue -lcurl -lpthread -lz)
 
 // Function to create a directory (including parent directories)
 bool createDirectory(const std::string& path) {
@@ -44,7 +73,9 @@ struct Player {
     std::string name;
     std::string character; // e.g., "Miss Scarlet"
     std::vector<std::string> hand; // Cards in the player's hand
+    uint64_t handMask = 0; // The same cards as a set of card IDs (see CardIndex)
     bool eliminated = false;
+    bool isBot = false; // Played by SolutionSolver instead of prompting
     int row;
     int col; // Current location of the player (row and column)
 };
@@ -59,23 +90,259 @@ struct Room {
     // Add any room-specific properties here, like connections to other rooms
 };
 
-// Define a struct to represent each cell on the grid
+// Kinds of cell on the grid
+enum class CellType : uint8_t { Empty, Hallway, Room };
+
+// Define a struct to represent each cell on the grid. Names live once in the board's string
+// table, so a cell is a small POD and the grid is one contiguous array.
 struct GridCell {
-    std::string type; // "empty", "hallway", or "room"
-    std::string name; // Name of the room or hallway, if applicable
+    CellType type;
+    uint16_t nameId; // Index into Board::names; 0 is the empty name of plain hallway cells
+};
+
+static_assert(sizeof(GridCell) == 4, "A grid cell is one byte of type and a 16-bit name ID, padded to 4 bytes");
+
+// Function to check whether a single orthogonal step between two cells is allowed: within the
+// same room, between hallways, or between a room and a hallway
+inline bool canStepBetween(const GridCell& start, const GridCell& dest) {
+    // Check if the destination is a valid location (room or hallway)
+    if (dest.type == CellType::Empty) {
+        return false; // Empty cell, not a valid location
+    }
+
+    // Allow movement within the same room or between adjacent hallways
+    if (start.type == dest.type) {
+        if (start.type == CellType::Room) {
+            return start.nameId == dest.nameId; // Moving between different rooms is not allowed
+        } else if (start.type == CellType::Hallway) {
+            return true; // Moving between adjacent hallways is allowed
+        }
+    }
+
+    // Allow moving from a room to an adjacent hallway, or vice versa
+    return (start.type == CellType::Room && dest.type == CellType::Hallway) || (start.type == CellType::Hallway && dest.type == CellType::Room);
+}
+
+// Shortest paths over the board's movement graph, computed once when the board is built, so
+// movement queries never search the grid during play. Each room is a single node (moving inside
+// a room is not counted) and each hallway cell is a node; edges are allowed single steps.
+// Boards with up to denseNodeLimit nodes get all-pairs tables up front; larger generated boards
+// compute a source's row the first time it is queried.
+struct BoardPaths {
+    static const uint32_t unreachable = 0xFFFFFFFF;
+    static const int denseNodeLimit = 2048;
+
+    // Shortest-path tree from one source node
+    struct Row {
+        std::vector<uint32_t> dist; // Hops to each node
+        std::vector<uint32_t> next; // First hop from the source towards each node
+        std::vector<uint32_t> order; // Reachable nodes sorted by distance
+        std::vector<uint32_t> roomOrder; // Reachable room nodes sorted by distance
+    };
+
+    int cols = 0;
+    int numNodes = 0;
+    std::vector<int32_t> cellNode; // Node of each cell, -1 for empty cells
+    std::vector<int32_t> nodeCell; // First cell of each node
+    std::vector<uint8_t> roomNode; // 1 if the node is a room
+    std::vector<uint32_t> adjOffsets; // Adjacency in compressed sparse row form
+    std::vector<uint32_t> adjTargets;
+    mutable std::vector<std::unique_ptr<Row>> rows; // Indexed by source node
+    mutable std::mutex rowsMutex; // Guards lazily computed rows on large boards
+
+    BoardPaths() {}
+    BoardPaths(const BoardPaths&) = delete;
+    BoardPaths& operator=(const BoardPaths&) = delete;
+
+    void build(int numRows, int numCols, const std::vector<GridCell>& cells) {
+        cols = numCols;
+        cellNode.assign(cells.size(), -1);
+        nodeCell.clear();
+        roomNode.clear();
+
+        // One node per room, one per hallway cell
+        std::map<uint16_t, int32_t> roomNodes;
+        for (size_t c = 0; c < cells.size(); ++c) {
+            if (cells[c].type == CellType::Room) {
+                auto it = roomNodes.find(cells[c].nameId);
+                if (it == roomNodes.end()) {
+                    it = roomNodes.insert(std::make_pair(cells[c].nameId, static_cast<int32_t>(nodeCell.size()))).first;
+                    nodeCell.push_back(static_cast<int32_t>(c));
+                    roomNode.push_back(1);
+                }
+                cellNode[c] = it->second;
+            } else if (cells[c].type == CellType::Hallway) {
+                cellNode[c] = static_cast<int32_t>(nodeCell.size());
+                nodeCell.push_back(static_cast<int32_t>(c));
+                roomNode.push_back(0);
+            }
+        }
+        numNodes = static_cast<int>(nodeCell.size());
+
+        // Collect the distinct node-to-node steps, then pack them
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        for (int r = 0; r < numRows; ++r) {
+            for (int c = 0; c < numCols; ++c) {
+                int from = r * numCols + c;
+                if (cellNode[from] < 0) {
+                    continue;
+                }
+                const int neighbours[2] = {c + 1 < numCols ? from + 1 : -1, r + 1 < numRows ? from + numCols : -1};
+                for (int to : neighbours) {
+                    if (to >= 0 && cellNode[to] >= 0 && cellNode[to] != cellNode[from] && canStepBetween(cells[from], cells[to])) {
+                        edges.push_back(std::make_pair(cellNode[from], cellNode[to]));
+                        edges.push_back(std::make_pair(cellNode[to], cellNode[from]));
+                    }
+                }
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        adjOffsets.assign(numNodes + 1, 0);
+        adjTargets.resize(edges.size());
+        for (size_t e = 0; e < edges.size(); ++e) {
+            adjOffsets[edges[e].first + 1]++;
+            adjTargets[e] = edges[e].second;
+        }
+        for (int n = 0; n < numNodes; ++n) {
+            adjOffsets[n + 1] += adjOffsets[n];
+        }
+
+        rows.clear();
+        rows.resize(numNodes);
+        if (numNodes <= denseNodeLimit) {
+            for (int n = 0; n < numNodes; ++n) {
+                rows[n] = computeRow(n);
+            }
+        }
+    }
+
+    // Node of the cell at (row, col), or -1 for an empty cell
+    int nodeAt(int row, int col) const {
+        return cellNode[row * cols + col];
+    }
+
+    bool isRoom(int node) const {
+        return roomNode[node] != 0;
+    }
+
+    const Row& rowFrom(int source) const {
+        if (numNodes > denseNodeLimit) {
+            std::lock_guard<std::mutex> lock(rowsMutex);
+            if (!rows[source]) {
+                rows[source] = computeRow(source);
+            }
+        }
+        return *rows[source];
+    }
+
+    // Number of moves between two nodes, or unreachable
+    uint32_t distance(int from, int to) const {
+        return rowFrom(from).dist[to];
+    }
+
+    // The node to step into next on a shortest path, or -1 if there is none
+    int nextHop(int from, int to) const {
+        uint32_t hop = rowFrom(from).next[to];
+        return hop == unreachable ? -1 : static_cast<int>(hop);
+    }
+
+    // Nodes on a shortest path, excluding the start; empty if unreachable.
+    // Walks back from the target through the source's distances, so only one row is needed.
+    std::vector<int> path(int from, int to) const {
+        const Row& row = rowFrom(from);
+        if (from == to || row.dist[to] == unreachable) {
+            return std::vector<int>();
+        }
+        std::vector<int> nodes(row.dist[to]);
+        uint32_t node = to;
+        for (uint32_t d = row.dist[to]; d > 0; --d) {
+            nodes[d - 1] = static_cast<int>(node);
+            for (uint32_t e = adjOffsets[node]; e < adjOffsets[node + 1]; ++e) {
+                if (row.dist[adjTargets[e]] == d - 1) {
+                    node = adjTargets[e];
+                    break;
+                }
+            }
+        }
+        return nodes;
+    }
+
+    // Nodes reachable within k moves (including the start), as a range of the source's BFS order
+    std::pair<const uint32_t*, const uint32_t*> reachableWithin(int from, uint32_t k) const {
+        const Row& row = rowFrom(from);
+        const uint32_t* begin = row.order.data();
+        const uint32_t* end = std::upper_bound(begin, begin + row.order.size(), k, [&row](uint32_t limit, uint32_t node) { return limit < row.dist[node]; });
+        return std::make_pair(begin, end);
+    }
+
+    // Room nodes reachable within k moves, nearest first
+    std::vector<int> roomsWithin(int from, uint32_t k) const {
+        std::vector<int> result;
+        const Row& row = rowFrom(from);
+        for (uint32_t node : row.roomOrder) {
+            if (row.dist[node] > k) {
+                break;
+            }
+            result.push_back(static_cast<int>(node));
+        }
+        return result;
+    }
+
+    size_t memoryUsage() const {
+        size_t bytes = sizeof(*this) + cellNode.capacity() * sizeof(int32_t) + nodeCell.capacity() * sizeof(int32_t) + roomNode.capacity() + (adjOffsets.capacity() + adjTargets.capacity()) * sizeof(uint32_t) + rows.capacity() * sizeof(rows[0]);
+        for (const auto& row : rows) {
+            if (row) {
+                bytes += sizeof(Row) + (row->dist.capacity() + row->next.capacity() + row->order.capacity() + row->roomOrder.capacity()) * sizeof(uint32_t);
+            }
+        }
+        return bytes;
+    }
+
+private:
+    // Breadth-first search from one source over the compact graph
+    std::unique_ptr<Row> computeRow(int source) const {
+        std::unique_ptr<Row> row(new Row());
+        row->dist.assign(numNodes, unreachable);
+        row->next.assign(numNodes, unreachable);
+        row->order.reserve(numNodes);
+        row->dist[source] = 0;
+        row->next[source] = source;
+        row->order.push_back(source);
+        for (size_t head = 0; head < row->order.size(); ++head) {
+            uint32_t node = row->order[head];
+            if (roomNode[node]) {
+                row->roomOrder.push_back(node);
+            }
+            for (uint32_t e = adjOffsets[node]; e < adjOffsets[node + 1]; ++e) {
+                uint32_t target = adjTargets[e];
+                if (row->dist[target] == unreachable) {
+                    row->dist[target] = row->dist[node] + 1;
+                    row->next[target] = static_cast<int>(node) == source ? target : row->next[node];
+                    row->order.push_back(target);
+                }
+            }
+        }
+        return row;
+    }
 };
 
+const uint32_t BoardPaths::unreachable;
+const int BoardPaths::denseNodeLimit;
+
 struct Board {
     int rows;
     int cols;
-    std::vector<std::vector<GridCell>> grid;
+    std::vector<GridCell> cells; // Row-major, rows * cols
+    std::vector<std::string> names; // String table of room and hallway names
+    BoardPaths paths; // Precomputed movement tables
 
-    Board(const std::vector<Card>& rooms) : rows(25), cols(25), grid(rows, std::vector<GridCell>(cols, {"hallway", ""})) {
+    Board(const std::vector<Card>& rooms) : rows(25), cols(25), cells(rows * cols, {CellType::Hallway, 0}), names(1, "") {
         // Initialize the board layout with multi-tile rooms
 
         // Define rooms with their positions and sizes (name, start_row, start_col, height, width)
         std::vector<std::tuple<std::string, int, int, int, int>> room_specs;
-        if (rooms.size() >= 9) {
+        if (rooms.size() == 9) {
             room_specs = {
                 {rooms[0].name, 1, 1, 5, 6},    // Room 1 - Top Left
                 {rooms[1].name, 1, 18, 5, 6},   // Room 2 - Top Right
@@ -87,6 +354,15 @@ struct Board {
                 {rooms[7].name, 13, 1, 4, 6},   // Room 8
                 {rooms[8].name, 13, 18, 4, 6}    // Room 9
             };
+        } else if (!rooms.empty()) {
+            // Not the nine rooms of the classic layout: generate one that fits them instead
+            std::vector<std::string> roomNames;
+            for (const Card& room : rooms) {
+                roomNames.push_back(room.name);
+            }
+            generateLayout(roomNames, 0);
+            paths.build(rows, cols, cells);
+            return;
         } else {
             std::cerr << "Not enough rooms to initialize the board." << std::endl;
             // It's important to prevent further execution if there aren't enough rooms
@@ -96,7 +372,7 @@ struct Board {
 
         // Place the rooms on the grid
         for (const auto& room_spec : room_specs) {
-            std::string room_name = std::get<0>(room_spec);
+            uint16_t room_id = internName(std::get<0>(room_spec));
             int start_row = std::get<1>(room_spec);
             int start_col = std::get<2>(room_spec);
             int height = std::get<3>(room_spec);
@@ -105,882 +381,7543 @@ struct Board {
             for (int i = start_row; i < start_row + height; ++i) {
                 for (int j = start_col; j < start_col + width; ++j) {
                     if (i < rows && j < cols) {
-                        grid[i][j] = {"room", room_name};
+                        at(i, j) = {CellType::Room, room_id};
                     }
                 }
             }
         }
 
         // Assign hallways (adjust positions as needed)
-        grid[1][7] = {"hallway", "Hall-1"};
-        grid[1][17] = {"hallway", "Hall-2"};
-        grid[1][13] = {"hallway", "Hall-3"};
-        grid[6][1] = {"hallway", "Hall-4"};
-        grid[6][7] = {"hallway", "Hall-5"};
-        grid[6][17] = {"hallway", "Hall-6"};
-        grid[6][24] = {"hallway", "Hall-7"};
-        grid[18][1] = {"hallway", "Hall-8"};
-        grid[18][7] = {"hallway", "Hall-9"};
-        grid[18][17] = {"hallway", "Hall-10"};
-        grid[18][24] = {"hallway", "Hall-11"};
-        grid[19][7] = {"hallway", "Hall-12"};
-        grid[19][17] = {"hallway", "Hall-13"};
-        grid[13][7] = {"hallway", "Hall-14"};
-        grid[13][17] = {"hallway", "Hall-15"};
+        const int hallways[][2] = {
+            {1, 7}, {1, 17}, {1, 13}, {6, 1}, {6, 7}, {6, 17}, {6, 24}, {18, 1},
+            {18, 7}, {18, 17}, {18, 24}, {19, 7}, {19, 17}, {13, 7}, {13, 17}
+        };
+        for (size_t h = 0; h < sizeof(hallways) / sizeof(hallways[0]); ++h) {
+            at(hallways[h][0], hallways[h][1]) = {CellType::Hallway, internName("Hall-" + std::to_string(h + 1))};
+        }
+
+        paths.build(rows, cols, cells);
     }
 
-    // Function to check if a move from one location to another is valid
-    bool isValidMove(int startRow, int startCol, int destRow, int destCol) {
-        // Check if the destination is within the grid bounds
-        if (destRow < 0 || destRow >= rows || destCol < 0 || destCol >= cols) {
-            return false;
-        }
+    // Generate a layout for any number of rooms on a numRows x numCols grid, deterministic per seed
+    Board(int numRows, int numCols, const std::vector<std::string>& roomNames, uint64_t seed) : rows(numRows), cols(numCols), cells(static_cast<size_t>(numRows) * numCols, {CellType::Empty, 0}), names(1, "") {
+        generateLayout(roomNames, seed);
+        paths.build(rows, cols, cells);
+    }
+
+    GridCell& at(int row, int col) {
+        return cells[row * cols + col];
+    }
 
-        // Get the cell types for the start and destination
-        std::string startType = grid[startRow][startCol].type;
-        std::string destType = grid[destRow][destCol].type;
+    const GridCell& at(int row, int col) const {
+        return cells[row * cols + col];
+    }
 
-        // Check if the destination is a valid location (room or hallway)
-        if (destType == "empty") {
-            return false; // Empty cell, not a valid location
+    const std::string& nameOf(const GridCell& cell) const {
+        return names[cell.nameId];
+    }
+
+    // Function to lay out rooms, hallways and doors procedurally.
+    // The grid is cut into one slot per room by evenly spaced hallway lines. The segments of those
+    // lines between crossings are kept along a random spanning tree of the crossings, plus some
+    // extra loops, so the hallway network is connected by construction. Each room is a random
+    // rectangle inside its slot, with a door corridor to one side of the slot whose segment is then
+    // forced open. A flood fill verifies that every room and hallway cell is reachable.
+    void generateLayout(const std::vector<std::string>& roomNames, uint64_t seed) {
+        std::mt19937_64 rng(seed);
+        auto randomBelow = [&rng](int n) { return n <= 1 ? 0 : static_cast<int>(rng() % static_cast<uint64_t>(n)); };
+
+        int numRooms = static_cast<int>(roomNames.size());
+        int slotCols = std::max(1, static_cast<int>(std::ceil(std::sqrt(numRooms * static_cast<double>(cols) / rows))));
+        int slotRows = std::max(1, (numRooms + slotCols - 1) / slotCols);
+        std::vector<int> lineRow(slotRows + 1);
+        std::vector<int> lineCol(slotCols + 1);
+        for (int k = 0; k <= slotRows; ++k) {
+            lineRow[k] = static_cast<int>(static_cast<long long>(k) * (rows - 1) / slotRows);
+        }
+        for (int k = 0; k <= slotCols; ++k) {
+            lineCol[k] = static_cast<int>(static_cast<long long>(k) * (cols - 1) / slotCols);
+        }
+        if ((rows - 1) / slotRows < 2 || (cols - 1) / slotCols < 2) {
+            throw std::runtime_error("Board of " + std::to_string(rows) + "x" + std::to_string(cols) + " is too small for " + std::to_string(numRooms) + " rooms.");
         }
 
-        // Check if the move is adjacent (up, down, left, right)
-        if (abs(startRow - destRow) + abs(startCol - destCol) != 1) {
-            return false; // Not an adjacent move
+        std::fill(cells.begin(), cells.end(), GridCell{CellType::Empty, 0});
+        names.assign(1, "");
+
+        // Segments: horizontal ones first (row line k, between column lines j and j + 1), then vertical
+        int crossingCols = slotCols + 1;
+        int numHorizontal = (slotRows + 1) * slotCols;
+        int numSegments = numHorizontal + slotRows * (slotCols + 1);
+        auto segmentEnds = [&](int segment) {
+            if (segment < numHorizontal) {
+                int k = segment / slotCols;
+                int j = segment % slotCols;
+                return std::make_pair(k * crossingCols + j, k * crossingCols + j + 1);
+            }
+            int k = (segment - numHorizontal) / crossingCols;
+            int j = (segment - numHorizontal) % crossingCols;
+            return std::make_pair(k * crossingCols + j, (k + 1) * crossingCols + j);
+        };
+
+        // Random spanning tree over the crossings (Kruskal with union-find), plus some loops
+        std::vector<int> parent((slotRows + 1) * crossingCols);
+        for (size_t i = 0; i < parent.size(); ++i) {
+            parent[i] = static_cast<int>(i);
+        }
+        auto findRoot = [&parent](int x) {
+            while (parent[x] != x) {
+                parent[x] = parent[parent[x]];
+                x = parent[x];
+            }
+            return x;
+        };
+        std::vector<int> order(numSegments);
+        for (int i = 0; i < numSegments; ++i) {
+            order[i] = i;
+        }
+        for (int i = numSegments - 1; i > 0; --i) {
+            std::swap(order[i], order[randomBelow(i + 1)]);
+        }
+        std::vector<uint8_t> keep(numSegments, 0);
+        for (int segment : order) {
+            std::pair<int, int> ends = segmentEnds(segment);
+            int a = findRoot(ends.first);
+            int b = findRoot(ends.second);
+            if (a != b) {
+                parent[a] = b;
+                keep[segment] = 1;
+            } else if (randomBelow(100) < 30) {
+                keep[segment] = 1;
+            }
         }
 
-        // Allow movement within the same room or between adjacent hallways
-        if (startType == destType) {
-            if (startType == "room") {
-                if (grid[startRow][startCol].name != grid[destRow][destCol].name) {
-                    return false; // Moving between different rooms is not allowed
+        // Rooms and their door corridors
+        for (int room = 0; room < numRooms; ++room) {
+            int slotRow = room / slotCols;
+            int slotCol = room % slotCols;
+            int top = lineRow[slotRow] + 1;
+            int left = lineCol[slotCol] + 1;
+            int innerHeight = lineRow[slotRow + 1] - top;
+            int innerWidth = lineCol[slotCol + 1] - left;
+            int height = std::max(1, innerHeight / 2 + randomBelow(innerHeight - innerHeight / 2 + 1));
+            int width = std::max(1, innerWidth / 2 + randomBelow(innerWidth - innerWidth / 2 + 1));
+            int roomTop = top + randomBelow(innerHeight - height + 1);
+            int roomLeft = left + randomBelow(innerWidth - width + 1);
+            uint16_t roomId = internName(roomNames[room]);
+            for (int i = roomTop; i < roomTop + height; ++i) {
+                for (int j = roomLeft; j < roomLeft + width; ++j) {
+                    at(i, j) = {CellType::Room, roomId};
                 }
-                return true; // Moving within the same room is allowed
-            } else if (startType == "hallway") {
-                return true; // Moving between adjacent hallways is allowed
             }
+
+            // Door: a straight corridor from a random edge of the room to that side of the slot
+            int side = randomBelow(4);
+            int segment;
+            if (side < 2) { // Up or down
+                int j = roomLeft + randomBelow(width);
+                int lineK = slotRow + (side == 1 ? 1 : 0);
+                int from = side == 0 ? lineRow[lineK] + 1 : roomTop + height;
+                int to = side == 0 ? roomTop - 1 : lineRow[lineK] - 1;
+                for (int i = from; i <= to; ++i) {
+                    at(i, j) = {CellType::Hallway, 0};
+                }
+                segment = lineK * slotCols + slotCol;
+            } else { // Left or right
+                int i = roomTop + randomBelow(height);
+                int lineK = slotCol + (side == 3 ? 1 : 0);
+                int from = side == 2 ? lineCol[lineK] + 1 : roomLeft + width;
+                int to = side == 2 ? roomLeft - 1 : lineCol[lineK] - 1;
+                for (int j = from; j <= to; ++j) {
+                    at(i, j) = {CellType::Hallway, 0};
+                }
+                segment = numHorizontal + slotRow * crossingCols + lineK;
+            }
+            keep[segment] = 1;
         }
 
-        // Allow moving from a room to an adjacent hallway, or vice versa
-        if ((startType == "room" && destType == "hallway") || (startType == "hallway" && destType == "room")) {
-            return true;
+        // Carve the kept segments, crossings included
+        for (int segment = 0; segment < numSegments; ++segment) {
+            if (!keep[segment]) {
+                continue;
+            }
+            if (segment < numHorizontal) {
+                int i = lineRow[segment / slotCols];
+                for (int j = lineCol[segment % slotCols]; j <= lineCol[segment % slotCols + 1]; ++j) {
+                    at(i, j) = {CellType::Hallway, 0};
+                }
+            } else {
+                int j = lineCol[(segment - numHorizontal) % crossingCols];
+                int k = (segment - numHorizontal) / crossingCols;
+                for (int i = lineRow[k]; i <= lineRow[k + 1]; ++i) {
+                    at(i, j) = {CellType::Hallway, 0};
+                }
+            }
         }
 
-        return false; // Invalid move
+        if (!isConnected()) {
+            throw std::runtime_error("Generated board layout is not connected.");
+        }
     }
 
-    // Function to display the current board state (player locations)
-    void displayBoard(const std::vector<Player>& players) {
-        const int cellWidth = 10; // Fixed width for each cell
-        std::cout << "\nCurrent Board State:\n";
-        for (int i = 0; i < rows; ++i) {
-            for (int j = 0; j < cols; ++j) {
-                bool playerPresent = false;
-                for (size_t k = 0; k < players.size(); ++k) {
-                    if (players[k].row == i && players[k].col == j) {
-                        std::cout << "[" << (char)('A' + k) << std::string(cellWidth - 2, ' ') << "]";
-                        playerPresent = true;
-                        break;
-                    }
+    // Function to check with a flood fill that every room and hallway cell can reach every other
+    bool isConnected() const {
+        int total = 0;
+        int first = -1;
+        for (int c = 0; c < rows * cols; ++c) {
+            if (cells[c].type != CellType::Empty) {
+                total++;
+                if (first < 0) {
+                    first = c;
                 }
-                if (!playerPresent) {
-                    if (grid[i][j].type == "empty") {
-                        std::cout << " . "; // Empty cell
-                    } else if (grid[i][j].type == "hallway") {
-                        std::cout << "[   ]"; // Hallway
-						//std::cout << std::string(cellWidth - 5, ' '); // REMOVE THIS LINE
-                    } else {
-                        std::string roomName = grid[i][j].name;
-
-                        // Abbreviate room name if it's too long
-                        if (roomName.length() > cellWidth - 2) {
-                            roomName = roomName.substr(0, cellWidth - 2);
-                        }
-
-                        // Pad the room name with spaces to center it
-                        int padding = (cellWidth - 2 - roomName.length()) / 2;
-                        std::string paddedRoomName = roomName;
-                        paddedRoomName.insert(0, padding, ' ');
-                        paddedRoomName.resize(cellWidth - 2, ' ');
-
-                        // Print the padded room name within brackets
-                        std::cout << "[" << paddedRoomName << "]";
-                    }
+            }
+        }
+        if (first < 0) {
+            return true;
+        }
+        std::vector<uint8_t> seen(cells.size(), 0);
+        std::vector<int> queue;
+        queue.reserve(total);
+        queue.push_back(first);
+        seen[first] = 1;
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int cell = queue[head];
+            int r = cell / cols;
+            int c = cell % cols;
+            const int neighbours[4] = {c > 0 ? cell - 1 : -1, c + 1 < cols ? cell + 1 : -1, r > 0 ? cell - cols : -1, r + 1 < rows ? cell + cols : -1};
+            for (int next : neighbours) {
+                if (next >= 0 && !seen[next] && canStepBetween(cells[cell], cells[next])) {
+                    seen[next] = 1;
+                    queue.push_back(next);
                 }
-				std::cout << std::string(cellWidth - 2, ' '); // ADD THIS LINE
             }
-            std::cout << "\n";
         }
+        return static_cast<int>(queue.size()) == total;
     }
-};
 
-struct Checklist {
-    std::map<std::string, bool> items; // Card name -> isKnown
+    // Starting cell for a player: along the top row on the classic board, else the nth hallway cell
+    std::pair<int, int> startPosition(int playerIndex) const {
+        if (playerIndex < cols && at(0, playerIndex).type == CellType::Hallway) {
+            return std::make_pair(0, playerIndex);
+        }
+        int seen = 0;
+        for (int c = 0; c < rows * cols; ++c) {
+            if (cells[c].type == CellType::Hallway && seen++ == playerIndex) {
+                return std::make_pair(c / cols, c % cols);
+            }
+        }
+        return std::make_pair(0, 0);
+    }
 
-    Checklist(const std::vector<Card>& characters, const std::vector<Card>& weapons, const std::vector<Card>& rooms) {
-        for (const auto& card : characters) {
-            items[card.name] = false;
+    // Add a name to the string table (or find it) and return its ID
+    uint16_t internName(const std::string& name) {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name) {
+                return static_cast<uint16_t>(i);
+            }
         }
-        for (const auto& card : weapons) {
-            items[card.name] = false;
+        names.push_back(name);
+        return static_cast<uint16_t>(names.size() - 1);
+    }
+
+    // Function to check if a move from one location to another is valid
+    bool isValidMove(int startRow, int startCol, int destRow, int destCol) const {
+        // Check if the destination is within the grid bounds
+        if (destRow < 0 || destRow >= rows || destCol < 0 || destCol >= cols) {
+            return false;
         }
-        for (const auto& card : rooms) {
-            items[card.name] = false;
+
+        // Check if the move is adjacent (up, down, left, right)
+        if (abs(startRow - destRow) + abs(startCol - destCol) != 1) {
+            return false; // Not an adjacent move
         }
+
+        return canStepBetween(at(startRow, startCol), at(destRow, destCol));
     }
 
-    void display(const std::vector<Card>& characters, const std::vector<Card>& weapons, const std::vector<Card>& rooms) {
-        std::cout << "\n--- Checklist ---\n";
-        std::cout << "Characters:\n";
-        for (const auto& card : characters) {
-            std::cout << card.name << ": " << (items[card.name] ? "Known" : "Unknown") << "\n";
+    // Function to get the cell to step into from (row, col) on a shortest path to a target node.
+    // Inside a room the step heads for the room cell bordering the next hallway cell.
+    std::pair<int, int> stepToward(int row, int col, int targetNode) const {
+        int node = paths.nodeAt(row, col);
+        int hop = node < 0 || node == targetNode ? -1 : paths.nextHop(node, targetNode);
+        if (hop < 0) {
+            return std::make_pair(row, col);
         }
-        std::cout << "Weapons:\n";
-        for (const auto& card : weapons) {
-            std::cout << card.name << ": " << (items[card.name] ? "Known" : "Unknown") << "\n";
+        const int steps[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+        for (const auto& step : steps) {
+            int r = row + step[0];
+            int c = col + step[1];
+            if (isValidMove(row, col, r, c) && paths.nodeAt(r, c) == hop) {
+                return std::make_pair(r, c);
+            }
         }
-        std::cout << "Rooms:\n";
-        for (const auto& card : rooms) {
-            std::cout << card.name << ": " << (items[card.name] ? "Known" : "Unknown") << "\n";
+        // Not next to the exit yet. The hop out of a room is always a single hallway cell, so find the
+        // room cell bordering it and walk towards that inside the (rectangular) room.
+        int hopCell = paths.nodeCell[hop];
+        for (const auto& step : steps) {
+            int r = hopCell / cols + step[0];
+            int c = hopCell % cols + step[1];
+            if (r >= 0 && r < rows && c >= 0 && c < cols && paths.nodeAt(r, c) == node) {
+                int dr = (r > row) - (r < row);
+                int dc = dr != 0 ? 0 : (c > col) - (c < col);
+                return std::make_pair(row + dr, col + dc);
+            }
         }
+        return std::make_pair(row, col);
     }
 
-    void markKnown(const std::string& cardName) {
-        items[cardName] = true;
+    // Bytes used by the grid and its string table
+    size_t memoryUsage() const {
+        size_t bytes = sizeof(*this) + cells.capacity() * sizeof(GridCell) + names.capacity() * sizeof(std::string);
+        for (const std::string& name : names) {
+            if (name.capacity() > 15) { // Longer than the small-string buffer
+                bytes += name.capacity() + 1;
+            }
+        }
+        return bytes;
     }
 };
 
+// Renders the board into a preallocated framebuffer of fixed-width cell glyphs and writes each
+// frame with a single system call. On a terminal the board is pinned above a scroll region, so
+// game text scrolls underneath it, and after the first frame only the cells that changed are
+// re-emitted behind ANSI cursor moves. Elsewhere (pipes, logs, terminals too small for the
+// board) each changed frame is written out in full as plain text.
+struct BoardRenderer {
+    static const int cellWidth = 4; // Three characters of glyph plus a separator
+
+    int rows = 0;
+    int cols = 0;
+    const Board* board = nullptr;
+    std::string frame; // Glyphs of the frame being composed, row-major, cellWidth bytes per cell
+    std::string shown; // Glyphs currently on screen
+    std::vector<int8_t> occupant; // Player index standing on each cell, -1 if none
+    std::vector<std::string> roomGlyphs; // Glyph for each room name ID
+    std::string output; // Bytes of the next write
+    int termRows = 0;
+    int termCols = 0;
+    bool incremental = false; // Whether the screen holds the pinned board the next frame can be diffed against
+    bool onTerminal = false; // Whether draw() has pinned the board on the real terminal
+
+    ~BoardRenderer() {
+        if (incremental && onTerminal) {
+            // Give the whole screen back to the shell
+            std::string reset = "\x1b[r\x1b[" + std::to_string(termRows) + ";1H\n";
+            writeAll(reset);
+        }
+    }
 
-// Global lists of characters, weapons, and rooms
-std::vector<Card> characters;
-std::vector<Card> weapons;
-std::vector<Card> rooms = {
-    {"room", "Cellar"},
-    {"room", "Observatory"},
-    {"room", "Theater"},
-    {"room", "Garage"},
-    {"room", "Studio"},
-    {"room", "Pantry"},
-    {"room", "Attic"},
-    {"room", "Gazebo"},
-    {"room", "Courtyard"}
-};
+    // Function to compose a frame and return the bytes that bring the screen up to date (empty if nothing changed)
+    const std::string& update(const Board& current, const std::vector<Player>& players, int screenRows, int screenCols) {
+        if (board != &current || rows != current.rows || cols != current.cols) {
+            attach(current);
+        }
+        bool fits = screenRows >= rows + 6 && screenCols >= cols * cellWidth;
+        bool sizeChanged = screenRows != termRows || screenCols != termCols;
+        termRows = screenRows;
+        termCols = screenCols;
+        compose(players);
+
+        output.clear();
+        if (!fits) {
+            if (incremental) {
+                output += "\x1b[r\x1b[2J\x1b[H";
+                incremental = false;
+            }
+            if (frame != shown) {
+                appendFullFrame(false);
+            }
+        } else if (!incremental || sizeChanged) {
+            // Pin the board to the top and let everything else scroll below it
+            output += "\x1b[r\x1b[2J\x1b[H";
+            appendFullFrame(true);
+            output += "\x1b[" + std::to_string(rows + 3) + ";" + std::to_string(termRows) + "r\x1b[" + std::to_string(rows + 3) + ";1H";
+            incremental = true;
+        } else {
+            appendChangedCells();
+        }
+        shown = frame;
+        return output;
+    }
+
+    // Function to draw the board on standard output
+    void draw(const Board& current, const std::vector<Player>& players) {
+        int screenRows = 0;
+        int screenCols = 0;
+        struct winsize size;
+        if (isatty(STDOUT_FILENO) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0) {
+            screenRows = size.ws_row;
+            screenCols = size.ws_col;
+        }
+        const std::string& bytes = update(current, players, screenRows, screenCols);
+        if (!bytes.empty()) {
+            std::cout.flush(); // Keep the prompts printed so far ahead of the frame
+            writeAll(bytes);
+            onTerminal = incremental;
+        }
+    }
 
-Board board(rooms);
+private:
+    // Function to size the buffers and precompute the room glyphs for a board
+    void attach(const Board& current) {
+        board = &current;
+        rows = current.rows;
+        cols = current.cols;
+        frame.assign(static_cast<size_t>(rows) * cols * cellWidth, ' ');
+        shown.clear();
+        occupant.assign(static_cast<size_t>(rows) * cols, -1);
+        output.reserve(frame.size() + rows * 16 + 64);
+        roomGlyphs.clear();
+        for (const std::string& name : current.names) {
+            std::string glyph = name.substr(0, cellWidth - 1);
+            glyph.resize(cellWidth, ' ');
+            roomGlyphs.push_back(glyph);
+        }
+        incremental = false;
+    }
 
-std::vector<Player> players;
-std::vector<Checklist> checklists;
+    // Function to fill the framebuffer from the board and the player positions
+    void compose(const std::vector<Player>& players) {
+        // Index the players by cell once, instead of scanning them for every cell
+        for (size_t k = 0; k < players.size() && k < 26; ++k) {
+            if (players[k].row >= 0 && players[k].row < rows && players[k].col >= 0 && players[k].col < cols) {
+                int8_t& slot = occupant[players[k].row * cols + players[k].col];
+                if (slot < 0) {
+                    slot = static_cast<int8_t>(k);
+                }
+            }
+        }
+        char* out = &frame[0];
+        for (size_t c = 0; c < occupant.size(); ++c, out += cellWidth) {
+            const GridCell& cell = board->cells[c];
+            if (occupant[c] >= 0) {
+                std::memcpy(out, "[A] ", cellWidth);
+                out[1] = static_cast<char>('A' + occupant[c]);
+            } else if (cell.type == CellType::Empty) {
+                std::memcpy(out, " .  ", cellWidth);
+            } else if (cell.type == CellType::Hallway) {
+                std::memcpy(out, "[ ] ", cellWidth);
+            } else {
+                std::memcpy(out, roomGlyphs[cell.nameId].data(), cellWidth);
+            }
+        }
+        for (const Player& player : players) {
+            if (player.row >= 0 && player.row < rows && player.col >= 0 && player.col < cols) {
+                occupant[player.row * cols + player.col] = -1;
+            }
+        }
+    }
 
-// Callback function to write the response data
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
-    size_t totalSize = size * nmemb;
-    output->append((char*)contents, totalSize);
-    return totalSize;
-}
+    // Function to append the whole board, one line per row
+    void appendFullFrame(bool pinned) {
+        output += pinned ? "Current Board State:\n" : "\nCurrent Board State:\n";
+        size_t rowBytes = static_cast<size_t>(cols) * cellWidth;
+        for (int i = 0; i < rows; ++i) {
+            output.append(frame, i * rowBytes, rowBytes);
+            output += '\n';
+        }
+    }
 
-// Function to make a request to the LLM API
-std::string getLLMResponse(const std::string& prompt, double temperature) {
-    CURL* curl;
-    CURLcode res;
-    std::string response;
+    // Function to append cursor moves and glyphs for the runs of cells that differ from the screen.
+    // Runs separated by a short gap are merged, as rewriting a few unchanged cells is cheaper than
+    // another cursor move.
+    void appendChangedCells() {
+        const int mergeGap = 2;
+        output += "\x1b" "7"; // Save the cursor, which sits in the scroll region
+        for (int i = 0; i < rows; ++i) {
+            int runStart = -1;
+            int runEnd = -1;
+            for (int j = 0; j <= cols; ++j) {
+                bool changed = j < cols && std::memcmp(&frame[(static_cast<size_t>(i) * cols + j) * cellWidth], &shown[(static_cast<size_t>(i) * cols + j) * cellWidth], cellWidth) != 0;
+                if (changed && runStart >= 0 && j - runEnd <= mergeGap + 1) {
+                    runEnd = j;
+                } else if (changed || j == cols) {
+                    if (runStart >= 0) {
+                        // Row 1 holds the title, so board row i is screen row i + 2
+                        output += "\x1b[" + std::to_string(i + 2) + ";" + std::to_string(runStart * cellWidth + 1) + "H";
+                        output.append(frame, (static_cast<size_t>(i) * cols + runStart) * cellWidth, static_cast<size_t>(runEnd - runStart + 1) * cellWidth);
+                    }
+                    runStart = runEnd = changed ? j : -1;
+                }
+            }
+        }
+        if (output.size() == 2) {
+            output.clear();
+        } else {
+            output += "\x1b" "8";
+        }
+    }
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    curl = curl_easy_init();
-    if (curl) {
-        // Set the URL
-        curl_easy_setopt(curl, CURLOPT_URL, "http://localhost:9090/v1/chat/completions");
+    // Function to write a buffer to standard output, retrying short and interrupted writes
+    static void writeAll(const std::string& bytes) {
+        size_t written = 0;
+        while (written < bytes.size()) {
+            ssize_t n = ::write(STDOUT_FILENO, bytes.data() + written, bytes.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return;
+            }
+            written += static_cast<size_t>(n);
+        }
+    }
+};
 
-        // Prepare the JSON payload
-        std::string data = R"({"model": "llama-3.2-3b-it-q8_0", "messages": [{"role": "system", "content": "You are a helpful assistant."}, {"role": "user", "content": ")" + prompt + R"("}], "temperature": )" + std::to_string(temperature) + R"(})";
+const int BoardRenderer::cellWidth;
 
-        // Set the request type to POST
-        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+// Dense integer IDs for the cards in play, so hands and suggestions can be 64-bit sets.
+// Characters come first, then weapons, then rooms.
+struct CardIndex {
+    static const int maxCards = 64;
 
-        // Set the POST data
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.c_str());
+    std::vector<Card> cards; // Card of each ID
+    std::map<std::string, int> ids; // Card name -> ID
 
-        // Set the data length
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data.length());
+    void build(const std::vector<Card>& characters, const std::vector<Card>& weapons, const std::vector<Card>& rooms) {
+        cards.clear();
+        ids.clear();
+        for (const std::vector<Card>* group : {&characters, &weapons, &rooms}) {
+            for (const Card& card : *group) {
+                if (ids.insert(std::make_pair(card.name, static_cast<int>(cards.size()))).second) {
+                    cards.push_back(card);
+                }
+            }
+        }
+        if (cards.size() > static_cast<size_t>(maxCards)) {
+            throw std::runtime_error("Too many cards: " + std::to_string(cards.size()) + " (at most " + std::to_string(maxCards) + ").");
+        }
+    }
 
-        // Set the callback function to write the response
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    // ID of the named card of the given type, or -1 if there is none
+    int idOf(const std::string& name, const std::string& type) const {
+        auto it = ids.find(name);
+        return it != ids.end() && cards[it->second].type == type ? it->second : -1;
+    }
 
-        // Set the content type to application/json
-        struct curl_slist* headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    static uint64_t maskOf(int id) {
+        return uint64_t(1) << id;
+    }
+};
 
-        // Perform the request
-        res = curl_easy_perform(curl);
+const int CardIndex::maxCards;
 
-        // Check for errors
-        if (res != CURLE_OK) {
-            throw std::runtime_error(std::string("curl_easy_perform() failed: ") + curl_easy_strerror(res));
+// Function to find who disproves a suggestion: the first player clockwise from the suggester
+// holding any suggested card. Returns the card shown (the lowest ID they hold) and sets
+// disprover, or returns -1 if nobody can disprove.
+inline int disproveSuggestion(const uint64_t* hands, int numPlayers, int suggester, uint64_t suggestion, int& disprover) {
+    for (int p = suggester + 1; p < numPlayers; ++p) {
+        if (uint64_t shown = hands[p] & suggestion) {
+            disprover = p;
+            return __builtin_ctzll(shown);
+        }
+    }
+    for (int p = 0; p < suggester; ++p) {
+        if (uint64_t shown = hands[p] & suggestion) {
+            disprover = p;
+            return __builtin_ctzll(shown);
         }
+    }
+    disprover = -1;
+    return -1;
+}
 
-        // Always cleanup
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
-    } else {
-        throw std::runtime_error("curl_easy_init() failed");
+// What one player can deduce about who holds each card. Owners are the players, then the
+// solution envelope; for each owner two card sets record what it is known to hold and known not
+// to hold. Facts are added as they are observed and propagated to a fixpoint:
+//   - a card held by one owner is held by no other, and a card every other owner lacks is held by the last
+//   - a player holding handSize cards holds nothing else, and one with only handSize candidates holds them all
+//   - the envelope holds exactly one card of each category
+//   - "player holds one of these cards" clauses shrink as cards are ruled out, and become a fact at one card left
+struct Deduction {
+    static const int maxPlayers = 32;
+
+    int numPlayers = 0;
+    int envelope = 0; // Owner index of the solution envelope
+    uint64_t allCards = 0;
+    uint64_t categories[3] = {0, 0, 0}; // Characters, weapons, rooms
+    std::vector<uint64_t> has; // Per owner
+    std::vector<uint64_t> hasNot; // Per owner
+    std::vector<int> handSizes; // Per player
+    std::vector<std::pair<int, uint64_t>> clauses; // (player, cards they hold at least one of)
+    bool consistent = true;
+
+    Deduction() {}
+
+    Deduction(const CardIndex& index, const std::vector<int>& playerHandSizes) {
+        for (size_t id = 0; id < index.cards.size(); ++id) {
+            allCards |= CardIndex::maskOf(static_cast<int>(id));
+            const std::string& type = index.cards[id].type;
+            categories[type == "character" ? 0 : (type == "weapon" ? 1 : 2)] |= CardIndex::maskOf(static_cast<int>(id));
+        }
+        reset(playerHandSizes);
     }
-    curl_global_cleanup();
 
-    return response;
-}
+    // Function to forget every fact for a new deal of the same cards, keeping the buffers
+    void reset(const std::vector<int>& playerHandSizes) {
+        if (playerHandSizes.size() > static_cast<size_t>(maxPlayers)) {
+            throw std::runtime_error("Too many players for deduction: " + std::to_string(playerHandSizes.size()));
+        }
+        numPlayers = static_cast<int>(playerHandSizes.size());
+        envelope = numPlayers;
+        has.assign(numPlayers + 1, 0);
+        hasNot.assign(numPlayers + 1, 0);
+        handSizes.assign(playerHandSizes.begin(), playerHandSizes.end());
+        clauses.clear();
+        consistent = true;
+    }
 
-// Helper function to validate the number of items returned from the LLM
-void validateLLMResponseCount(const std::vector<std::string>& items, size_t expectedCount, const std::string& itemType) {
-    if (items.size() != expectedCount) {
-        throw std::runtime_error("LLM returned " + std::to_string(items.size()) + " " + itemType + ", but expected " + std::to_string(expectedCount));
+    void addHas(int owner, uint64_t cards) {
+        has[owner] |= cards;
+        propagate();
     }
-}
 
-// Function to get a list of rooms from the LLM
-std::vector<std::string> getRoomsFromLLM(const std::string& gameTheme) {
-    const int maxRetries = 3;
-    int retryCount = 0;
-    std::vector<std::string> rooms;
+    void addHasNot(int owner, uint64_t cards) {
+        hasNot[owner] |= cards;
+        propagate();
+    }
 
-    while (retryCount < maxRetries) {
-        std::string prompt = "List 9 random rooms suitable for a " + gameTheme + " themed clue-like game, but not Hall, Lounge, Dining Room, Kitchen, Ballroom, Conservatory, Billiard Room, Library, or Study, separated by commas. Give me only the comma separated list, nothing else.";
-        double temperature = 1.0;
-        std::string response = getLLMResponse(prompt, temperature);
+    void addClause(int player, uint64_t cards) {
+        clauses.push_back(std::make_pair(player, cards));
+        propagate();
+    }
 
-        // Extract the content from the JSON response
-        size_t contentStart = response.find("\"content\":\"");
-        if (contentStart == std::string::npos) {
-            std::cerr << "Could not find 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-            retryCount++;
-            continue;
-        }
-        contentStart += strlen("\"content\":\"");
+    // Cards the owner may still hold
+    uint64_t possible(int owner) const {
+        return allCards & ~hasNot[owner];
+    }
 
-        // Look for the end of the content, allowing for variations in the closing sequence
-        size_t contentEnd = response.find("\"}]", contentStart);
-        if (contentEnd == std::string::npos) {
-            contentEnd = response.find("\"", contentStart); // Try to find the next quote
-            if (contentEnd == std::string::npos) {
-                std::cerr << "Could not find end of 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-                retryCount++;
-                continue;
+    // Function to apply the rules until nothing changes; returns false if the facts contradict each other
+    bool propagate() {
+        bool changed = true;
+        while (changed && consistent) {
+            changed = false;
+            int numOwners = numPlayers + 1;
+            uint64_t heldByAnyone = 0;
+            for (int o = 0; o < numOwners; ++o) {
+                heldByAnyone |= has[o];
+                if (has[o] & hasNot[o]) {
+                    consistent = false;
+                }
+            }
+            for (int o = 0; o < numOwners; ++o) {
+                uint64_t heldByOthers = 0;
+                uint64_t lackedByOthers = allCards;
+                for (int other = 0; other < numOwners; ++other) {
+                    if (other != o) {
+                        heldByOthers |= has[other];
+                        lackedByOthers &= hasNot[other];
+                    }
+                }
+                changed |= merge(hasNot[o], heldByOthers);
+                changed |= merge(has[o], lackedByOthers);
+            }
+            if ((heldByAnyone | possibleSomewhere()) != allCards) {
+                consistent = false; // A card nobody can hold
             }
-        }
-
-        std::string content = response.substr(contentStart, contentEnd - contentStart);
 
-        rooms.clear();
-        std::stringstream ss(content);
-        std::string room;
-        while (std::getline(ss, room, ',')) {
-            // Remove leading/trailing whitespace
-            room.erase(0, room.find_first_not_of(" \t\n\r"));
-            room.erase(room.find_last_not_of(" \t\n\r") + 1);
-            rooms.push_back(room);
-        }
+            for (int p = 0; p < numPlayers; ++p) {
+                int held = __builtin_popcountll(has[p]);
+                int candidates = __builtin_popcountll(possible(p));
+                if (held > handSizes[p] || candidates < handSizes[p]) {
+                    consistent = false;
+                } else if (held == handSizes[p]) {
+                    changed |= merge(hasNot[p], allCards & ~has[p]);
+                } else if (candidates == handSizes[p]) {
+                    changed |= merge(has[p], possible(p));
+                }
+            }
 
-        try {
-            validateLLMResponseCount(rooms, 9, "rooms");
-            // If validation succeeds, break out of the loop
-            break;
-        } catch (const std::exception& e) {
-            std::cerr << "Error validating LLM response: " << e.what() << " (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-            retryCount++;
-        }
-    }
+            for (uint64_t category : categories) {
+                uint64_t held = has[envelope] & category;
+                uint64_t candidates = possible(envelope) & category;
+                if (__builtin_popcountll(held) > 1 || candidates == 0) {
+                    consistent = false;
+                } else if (held) {
+                    changed |= merge(hasNot[envelope], category & ~held);
+                } else if (__builtin_popcountll(candidates) == 1) {
+                    changed |= merge(has[envelope], candidates);
+                }
+            }
 
-    // If max retries reached, return a default set of rooms
-    if (retryCount == maxRetries) {
-        std::cerr << "Max retries reached for getting rooms. Using default rooms." << std::endl;
-        return {"Cellar", "Observatory", "Theater", "Garage", "Studio", "Pantry", "Attic", "Gazebo", "Courtyard"};
+            for (size_t c = 0; c < clauses.size();) {
+                int p = clauses[c].first;
+                uint64_t live = clauses[c].second & possible(p);
+                if (clauses[c].second & has[p]) {
+                    // Satisfied, nothing more to learn from it
+                } else if (live == 0) {
+                    consistent = false;
+                } else if (__builtin_popcountll(live) == 1) {
+                    changed |= merge(has[p], live);
+                } else {
+                    clauses[c].second = live;
+                    ++c;
+                    continue;
+                }
+                clauses[c] = clauses.back();
+                clauses.pop_back();
+            }
+        }
+        return consistent;
     }
 
-    return rooms;
-}
-
-// Helper function to execute shell commands and return the output
-std::string exec(const char* cmd) {
-    char buffer[128];
-    std::string result = "";
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd, "r"), pclose);
-    if (!pipe) {
-        throw std::runtime_error("popen() failed!");
-    }
-    while (fgets(buffer, sizeof(buffer), pipe.get()) != nullptr) {
-        result += buffer;
+    // Function to check whether the remaining unplaced cards can still be dealt to the players
+    // within their hand sizes (a bipartite matching of cards to free hand slots)
+    bool handsCanBeCompleted() const {
+        uint64_t placed = 0;
+        for (uint64_t held : has) {
+            placed |= held;
+        }
+        int freeSlots[maxPlayers];
+        int load[maxPlayers];
+        int holder[64];
+        for (int p = 0; p < numPlayers; ++p) {
+            freeSlots[p] = handSizes[p] - __builtin_popcountll(has[p]);
+            load[p] = 0;
+        }
+        std::fill(holder, holder + 64, -1);
+        for (uint64_t rest = allCards & ~placed; rest; rest &= rest - 1) {
+            uint32_t visited = 0;
+            if (!placeCard(__builtin_ctzll(rest), visited, holder, load, freeSlots)) {
+                return false;
+            }
+        }
+        return true;
     }
-    return result;
-}
 
-// Function to generate images for the rooms
-void generateRoomImages(const std::vector<std::string>& rooms, const std::string& gameTheme) {
-    std::string rooms_dir = "images/rooms/";
-    if (!createDirectory(rooms_dir)) {
-        std::cerr << "Could not create rooms directory!" << std::endl;
-        return;
+private:
+    static bool merge(uint64_t& field, uint64_t bits) {
+        uint64_t merged = field | bits;
+        bool changed = merged != field;
+        field = merged;
+        return changed;
     }
 
-    for (const auto& room : rooms) {
-        // Generate a prompt for the room description
-        std::string prompt = "Describe the interior of a " + room + " in a " + gameTheme + " themed Clue-like game setting. Be descriptive and include details about the furniture, decor, and atmosphere. Start with the room name, '" + room + ", ' and then use short, concise language punctuated with commas to describe the things that should be in the image.  Keep everything on one line and only include the description, no preamble or further explanation.";
-        double temperature = 1.0;
-        std::string response = getLLMResponse(prompt, temperature);
-
-        // Extract the content from the JSON response
-        size_t contentStart = response.find("\"content\":\"");
-        if (contentStart == std::string::npos) {
-            std::cerr << "Could not find 'content' in LLM response." << std::endl;
-            continue;
+    uint64_t possibleSomewhere() const {
+        uint64_t cards = 0;
+        for (int o = 0; o <= numPlayers; ++o) {
+            cards |= possible(o);
         }
-        contentStart += strlen("\"content\":\"");
+        return cards;
+    }
 
-        // Look for the end of the content, allowing for variations in the closing sequence
-        size_t contentEnd = response.find("\"}]", contentStart);
-        if (contentEnd == std::string::npos) {
-            contentEnd = response.find("\"", contentStart); // Try to find the next quote
-            if (contentEnd == std::string::npos) {
-                std::cerr << "Could not find end of 'content' in LLM response." << std::endl;
+    // Augmenting-path step of the matching: give the card a slot, moving other cards along if needed
+    bool placeCard(int card, uint32_t& visited, int* holder, int* load, const int* freeSlots) const {
+        for (int p = 0; p < numPlayers; ++p) {
+            if ((visited >> p) & 1 || !(possible(p) & CardIndex::maskOf(card))) {
                 continue;
             }
+            visited |= uint32_t(1) << p;
+            if (load[p] < freeSlots[p]) {
+                holder[card] = p;
+                load[p]++;
+                return true;
+            }
+            for (int other = 0; other < 64; ++other) {
+                if (holder[other] == p) {
+                    holder[other] = -1;
+                    load[p]--;
+                    if (placeCard(other, visited, holder, load, freeSlots)) {
+                        holder[card] = p;
+                        load[p]++;
+                        return true;
+                    }
+                    holder[other] = p;
+                    load[p]++;
+                }
+            }
         }
+        return false;
+    }
+};
 
-        std::string room_description = response.substr(contentStart, contentEnd - contentStart);
-
-        // Remove quotes and newlines from the room description
-        room_description.erase(std::remove(room_description.begin(), room_description.end(), '\"'), room_description.end());
-        room_description.erase(std::remove(room_description.begin(), room_description.end(), '\n'), room_description.end());
-        room_description.erase(std::remove(room_description.begin(), room_description.end(), '\\'), room_description.end());
+const int Deduction::maxPlayers;
 
-        std::string filename = rooms_dir + room + ".png";
-        // Escape the quotes in the room description
-        std::string escaped_room_description = room_description;
-        size_t pos = 0;
-        while ((pos = escaped_room_description.find("\"", pos)) != std::string::npos) {
-            escaped_room_description.replace(pos, 1, "\\\"");
-            pos += 2;
-        }
-        std::string command = "./easy_diffusion \"" + escaped_room_description + "\" \"25\" \"512x512\" \"" + filename + "\"";
-        std::cout << "Generating image for " << room << "..." << std::endl;
-        std::cout << "Command: " << command << std::endl; // Print the command
-        std::cout << "Room description: " << room_description << std::endl; // Print the room description
-        std::string output = exec(command.c_str());
-		if (output.empty()) {
-			std::cerr << "Command failed: " << command << std::endl;
-		}
-        std::cout << output << std::endl;
+// A player's notes: what they know for certain about every card, and how likely each card is to
+// be in the envelope. The odds are uniform over the character x weapon x room triples still
+// consistent with everything the player has seen.
+struct Checklist {
+    const CardIndex* index;
+    int self;
+    Deduction deduction;
+    std::vector<double> envelopeOdds; // Per card ID
+    bool oddsStale = true;
+    std::vector<uint64_t> ruledOutSolutions; // Triples wrongly accused so far
+    long long revision = 0; // Bumped whenever the notes change, so derived results can be cached
+
+    Checklist(const CardIndex& cards, int player, uint64_t hand, const std::vector<int>& handSizes) : index(&cards), self(player), deduction(cards, handSizes) {
+        reset(player, hand, handSizes);
     }
-}
-
-// Function to get a list of weapons from the LLM
-std::vector<std::string> getWeaponsFromLLM(const std::string& gameTheme) {
-    const int maxRetries = 3;
-    int retryCount = 0;
-    std::vector<std::string> weapons;
 
-    while (retryCount < maxRetries) {
-        std::string prompt = "List 6 random weapons suitable for a " + gameTheme + " themed clue-like game, but not Candlestick, Dagger, Lead Pipe, Revolver, Rope, or Wrench, separated by commas. Give me only the comma separated list, nothing else.";
-        double temperature = 1.0;
-        std::string response = getLLMResponse(prompt, temperature);
+    // Function to start over for a new deal of the same cards, keeping the buffers
+    void reset(int player, uint64_t hand, const std::vector<int>& handSizes) {
+        self = player;
+        deduction.reset(handSizes);
+        deduction.has[self] = hand;
+        deduction.hasNot[self] = deduction.allCards & ~hand;
+        deduction.propagate();
+        oddsStale = true;
+        ruledOutSolutions.clear();
+        revision++;
+    }
 
-        // Extract the content from the JSON response
-        size_t contentStart = response.find("\"content\":\"");
-        if (contentStart == std::string::npos) {
-            std::cerr << "Could not find 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-            retryCount++;
-            continue;
+    // Function to record a suggestion seen at the table. Players after the suggester who did not
+    // disprove it hold none of the cards; the disprover holds one of them, and shownCard is the
+    // one they showed when this player is the suggester (otherwise -1).
+    void observeSuggestion(int suggester, uint64_t suggestion, int disprover, int shownCard) {
+        int numPlayers = deduction.numPlayers;
+        for (int p = (suggester + 1) % numPlayers; p != suggester && p != disprover; p = (p + 1) % numPlayers) {
+            deduction.hasNot[p] |= suggestion;
         }
-        contentStart += strlen("\"content\":\"");
-
-        // Look for the end of the content, allowing for variations in the closing sequence
-        size_t contentEnd = response.find("\"}]", contentStart);
-        if (contentEnd == std::string::npos) {
-            contentEnd = response.find("\"", contentStart); // Try to find the next quote
-            if (contentEnd == std::string::npos) {
-                std::cerr << "Could not find end of 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-                retryCount++;
-                continue;
+        if (disprover >= 0 && disprover != self) {
+            if (shownCard >= 0) {
+                deduction.has[disprover] |= CardIndex::maskOf(shownCard);
+            } else {
+                deduction.clauses.push_back(std::make_pair(disprover, suggestion));
             }
         }
+        deduction.propagate();
+        oddsStale = true;
+        revision++;
+    }
 
-        std::string content = response.substr(contentStart, contentEnd - contentStart);
+    // Function to record a wrong accusation: that exact triple is not the solution
+    void ruleOutSolution(uint64_t triple) {
+        ruledOutSolutions.push_back(triple);
+        oddsStale = true;
+        revision++;
+    }
 
-        weapons.clear();
-        std::stringstream ss(content);
-        std::string weapon;
-        while (std::getline(ss, weapon, ',')) {
-            // Remove leading/trailing whitespace
-            weapon.erase(0, weapon.find_first_not_of(" \t\n\r"));
-            weapon.erase(weapon.find_last_not_of(" \t\n\r") + 1);
-            weapons.push_back(weapon);
+    // Probability of each card being in the envelope, recomputed only after new observations
+    const std::vector<double>& solutionProbabilities() {
+        if (!oddsStale) {
+            return envelopeOdds;
         }
-
-        try {
-            validateLLMResponseCount(weapons, 6, "weapons");
-            // If validation succeeds, break out of the loop
-            break;
-        } catch (const std::exception& e) {
-            std::cerr << "Error validating LLM response: " << e.what() << " (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-            retryCount++;
+        oddsStale = false;
+        envelopeOdds.assign(index->cards.size(), 0.0);
+        std::vector<uint64_t> triples = consistentSolutions();
+        for (uint64_t triple : triples) {
+            for (uint64_t rest = triple; rest; rest &= rest - 1) {
+                envelopeOdds[__builtin_ctzll(rest)] += 1.0 / triples.size();
+            }
         }
+        return envelopeOdds;
     }
 
-    // If max retries reached, return an empty vector
-    if (retryCount == maxRetries) {
-        std::cerr << "Max retries reached for getting weapons. Returning empty list." << std::endl;
-        return {};
+    // Function to list every solution triple (as a card mask) that fits the facts and lets the
+    // remaining cards still be dealt
+    std::vector<uint64_t> consistentSolutions() const {
+        std::vector<uint64_t> triples;
+        Deduction trial;
+        consistentSolutions(triples, trial);
+        return triples;
     }
 
-    // Create the weapons directory
-    std::string weapons_dir = "images/weapons/";
-    if (!createDirectory(weapons_dir))
-    {
-        std::cerr << "Could not create weapons directory!" << std::endl;
+    // The same into caller-owned buffers; trial is scratch space for testing each triple
+    void consistentSolutions(std::vector<uint64_t>& triples, Deduction& trial) const {
+        triples.clear();
+        int envelope = deduction.envelope;
+        uint64_t candidates = deduction.possible(envelope);
+        for (uint64_t cs = candidates & deduction.categories[0]; cs; cs &= cs - 1) {
+            for (uint64_t ws = candidates & deduction.categories[1]; ws; ws &= ws - 1) {
+                for (uint64_t rs = candidates & deduction.categories[2]; rs; rs &= rs - 1) {
+                    uint64_t triple = (cs & -cs) | (ws & -ws) | (rs & -rs);
+                    if (std::find(ruledOutSolutions.begin(), ruledOutSolutions.end(), triple) != ruledOutSolutions.end()) {
+                        continue;
+                    }
+                    trial = deduction;
+                    trial.has[envelope] |= triple;
+                    if (trial.propagate() && trial.handsCanBeCompleted()) {
+                        triples.push_back(triple);
+                    }
+                }
+            }
+        }
     }
 
-    for (const auto& weapon : weapons) {
-		// Generate a prompt for the weapon description
-		std::string prompt = "Describe the physical appearance of a " + weapon + ". Start with '" + weapon + ", ' and then use short, concise language punctuated with commas to describe the things that should be in the image. Also mention 'centered in frame' to make sure the entire item is pictured. For example, if the item was a baseball bat the description could be as simple as 'baseball bat, wooden, centered in frame'";
-		double temperature = 1.0;
-		std::string response = getLLMResponse(prompt, temperature);
+    void display(const std::vector<Player>& players, std::ostream& out) {
+        const std::vector<double>& odds = solutionProbabilities();
+        const char* headings[3] = {"Characters:\n", "Weapons:\n", "Rooms:\n"};
+        out << "\n--- Checklist ---\n";
+        for (int category = 0; category < 3; ++category) {
+            out << headings[category];
+            for (uint64_t rest = deduction.categories[category]; rest; rest &= rest - 1) {
+                int card = __builtin_ctzll(rest);
+                uint64_t bit = CardIndex::maskOf(card);
+                out << index->cards[card].name << ": ";
+                if (deduction.has[self] & bit) {
+                    out << "In your hand";
+                } else if (deduction.has[deduction.envelope] & bit) {
+                    out << "In the envelope";
+                } else {
+                    int holder = -1;
+                    for (int p = 0; p < deduction.numPlayers; ++p) {
+                        if (deduction.has[p] & bit) {
+                            holder = p;
+                        }
+                    }
+                    if (holder >= 0) {
+                        out << "Held by " << players[holder].name;
+                    } else {
+                        out << "Unknown (" << static_cast<int>(odds[card] * 100 + 0.5) << "% envelope)";
+                    }
+                }
+                out << "\n";
+            }
+        }
+        if (!deduction.consistent) {
+            out << "(These notes contradict each other; a card was shown or dealt inconsistently.)\n";
+        }
+    }
+};
 
-		// Extract the content from the JSON response
-		size_t contentStart = response.find("\"content\":\"");
-		if (contentStart == std::string::npos) {
-			std::cerr << "Could not find 'content' in LLM response." << std::endl;
-			continue;
-		}
-		contentStart += strlen("\"content\":\"");
-
-		// Look for the end of the content, allowing for variations in the closing sequence
-		size_t contentEnd = response.find("\"}]", contentStart);
-		if (contentEnd == std::string::npos) {
-			contentEnd = response.find("\"", contentStart); // Try to find the next quote
-			if (contentEnd == std::string::npos) {
-				std::cerr << "Could not find end of 'content' in LLM response." << std::endl;
-				continue;
-			}
-		}
+// Posterior over the solution for one player's notes, weighting every consistent triple by the
+// number of ways the unseen cards could have been dealt around it. Small problems are counted
+// exactly by enumerating the deals; larger ones are estimated by importance sampling deals on
+// several threads, each with its own RNG.
+struct SolverResult {
+    std::vector<double> envelopeOdds; // Per card ID
+    uint64_t bestSolution = 0;
+    double bestProbability = 0;
+    double worlds = 0; // Deals counted, or total sample weight
+    bool exact = false;
+};
 
-		std::string weapon_description = response.substr(contentStart, contentEnd - contentStart);
+// Buffers for SolutionSolver::solve, so repeated decisions reuse their memory
+struct SolverScratch {
+    struct Worker {
+        Deduction trial;
+        std::vector<int> free;
+        std::vector<int> cards;
+        std::vector<uint64_t> hands;
+        std::vector<double> weights; // Sample weight per triple
+    };
+    std::vector<uint64_t> triples;
+    std::vector<double> weights; // Per triple
+    std::vector<Worker> workers;
+    SolverResult result;
+};
 
-		// Remove quotes and newlines from the weapon description
-		weapon_description.erase(std::remove(weapon_description.begin(), weapon_description.end(), '\"'), weapon_description.end());
-		weapon_description.erase(std::remove(weapon_description.begin(), weapon_description.end(), '\n'), weapon_description.end());
-		weapon_description.erase(std::remove(weapon_description.begin(), weapon_description.end(), '\\'), weapon_description.end());
+struct SolutionSolver {
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    double exactLimit = 2e7; // Enumerate when the estimated number of deals to visit is below this
+    long long samples = 200000; // Deals drawn when sampling
 
-        std::string filename = weapons_dir + weapon + ".png";
-        // Escape the quotes in the weapon description
-        std::string escaped_weapon_description = weapon_description;
-        size_t pos = 0;
-        while ((pos = escaped_weapon_description.find("\"", pos)) != std::string::npos) {
-            escaped_weapon_description.replace(pos, 1, "\\\"");
-            pos += 2;
-        }
-        std::string command = "./easy_diffusion \"" + escaped_weapon_description + "\" \"25\" \"512x512\" \"" + filename + "\"";
-        std::cout << "Generating image for " << weapon << "..." << std::endl;
-        std::cout << "Command: " << command << std::endl; // Print the command
-        std::cout << "Weapon description: " << weapon_description << std::endl; // Print the weapon description
-        std::string output = exec(command.c_str());
-		if (output.empty()) {
-			std::cerr << "Command failed: " << command << std::endl;
-		}
-        std::cout << output << std::endl;
+    SolverResult solve(const Checklist& notes, uint64_t seed) const {
+        SolverScratch scratch;
+        return solve(notes, seed, scratch);
     }
 
-    return weapons;
-}
-
-// Function to get a list of characters from the LLM
-std::vector<std::string> getCharactersFromLLM(const std::string& gameTheme) {
-    const int maxRetries = 3;
-    int retryCount = 0;
-    std::vector<std::string> characters;
-
-    while (retryCount < maxRetries) {
-        std::string prompt = "List 6 random characters suitable for a " + gameTheme + " themed clue-like game, but not Miss Scarlet, Colonel Mustard, Mrs. White, Mr. Green, Mrs. Peacock, or Professor Plum, separated by commas. Give me only the comma separated list, nothing else.";
-        double temperature = 1.0;
-        std::string response = getLLMResponse(prompt, temperature);
+    const SolverResult& solve(const Checklist& notes, uint64_t seed, SolverScratch& scratch) const {
+        SolverResult& result = scratch.result;
+        result.bestSolution = 0;
+        result.bestProbability = 0;
+        result.worlds = 0;
+        result.exact = false;
+        const Deduction& base = notes.deduction;
+        if (scratch.workers.size() < static_cast<size_t>(threads)) {
+            scratch.workers.resize(threads);
+        }
+        std::vector<uint64_t>& triples = scratch.triples;
+        notes.consistentSolutions(triples, scratch.workers[0].trial);
+        std::vector<double>& weights = scratch.weights;
+        weights.assign(triples.size(), 0.0);
+
+        // Size up the exact search: every unplaced card times the players it could go to
+        double estimate = 0;
+        for (uint64_t triple : triples) {
+            double deals = 1;
+            uint64_t unplaced = base.allCards & ~triple & ~playerCards(base);
+            for (uint64_t rest = unplaced; rest; rest &= rest - 1) {
+                deals *= std::max(1, candidatePlayers(base, __builtin_ctzll(rest)));
+            }
+            estimate += deals;
+        }
 
-        // Extract the content from the JSON response
-        size_t contentStart = response.find("\"content\":\"");
-        if (contentStart == std::string::npos) {
-            std::cerr << "Could not find 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-            retryCount++;
-            continue;
+        if (estimate <= exactLimit) {
+            result.exact = true;
+            runOnThreads(static_cast<int>(triples.size()), [&](int t, int w, std::mt19937_64&) {
+                SolverScratch::Worker& worker = scratch.workers[w];
+                Deduction& trial = worker.trial;
+                trial = base;
+                trial.has[trial.envelope] |= triples[t];
+                if (trial.propagate()) {
+                    worker.free.resize(trial.numPlayers);
+                    for (int p = 0; p < trial.numPlayers; ++p) {
+                        worker.free[p] = trial.handSizes[p] - __builtin_popcountll(trial.has[p]);
+                    }
+                    worker.hands.assign(trial.has.begin(), trial.has.end() - 1);
+                    worker.cards.clear();
+                    for (uint64_t rest = trial.allCards & ~playerCards(trial) & ~trial.has[trial.envelope]; rest; rest &= rest - 1) {
+                        worker.cards.push_back(__builtin_ctzll(rest));
+                    }
+                    weights[t] = countDeals(trial, worker.cards, 0, worker.free, worker.hands);
+                }
+            }, seed);
+        } else if (!triples.empty()) {
+            long long perThread = (samples + threads - 1) / threads;
+            runOnThreads(threads, [&](int, int w, std::mt19937_64& rng) {
+                SolverScratch::Worker& worker = scratch.workers[w];
+                worker.weights.assign(triples.size(), 0.0);
+                worker.free.resize(base.numPlayers);
+                for (long long s = 0; s < perThread; ++s) {
+                    size_t t = rng() % triples.size();
+                    // Deal each unplaced card into a random free slot of a player who may hold it. The
+                    // deal is weighted by the number of choices at each step, which makes the weighted
+                    // deals uniform over all valid ones.
+                    for (int p = 0; p < base.numPlayers; ++p) {
+                        worker.free[p] = base.handSizes[p] - __builtin_popcountll(base.has[p]);
+                    }
+                    worker.cards.clear();
+                    for (uint64_t rest = base.allCards & ~playerCards(base) & ~triples[t]; rest; rest &= rest - 1) {
+                        worker.cards.push_back(__builtin_ctzll(rest));
+                    }
+                    worker.hands.assign(base.has.begin(), base.has.end() - 1);
+                    double weight = 1;
+                    for (size_t i = 0; i < worker.cards.size() && weight > 0; ++i) {
+                        int card = worker.cards[i];
+                        int choices = 0;
+                        for (int p = 0; p < base.numPlayers; ++p) {
+                            choices += ((base.possible(p) >> card) & 1) ? worker.free[p] : 0;
+                        }
+                        weight *= choices;
+                        int pick = choices > 0 ? static_cast<int>(rng() % choices) : 0;
+                        for (int p = 0; p < base.numPlayers && choices > 0; ++p) {
+                            int slots = ((base.possible(p) >> card) & 1) ? worker.free[p] : 0;
+                            if (pick < slots) {
+                                worker.free[p]--;
+                                worker.hands[p] |= CardIndex::maskOf(card);
+                                break;
+                            }
+                            pick -= slots;
+                        }
+                    }
+                    if (weight > 0 && clausesHold(base, worker.hands)) {
+                        worker.weights[t] += weight;
+                    }
+                }
+            }, seed);
+            for (int w = 0; w < threads; ++w) {
+                for (size_t t = 0; t < triples.size(); ++t) {
+                    weights[t] += scratch.workers[w].weights[t];
+                }
+            }
         }
-        contentStart += strlen("\"content\":\"");
 
-        // Look for the end of the content, allowing for variations in the closing sequence
-        size_t contentEnd = response.find("\"}]", contentStart);
-        if (contentEnd == std::string::npos) {
-            contentEnd = response.find("\"", contentStart); // Try to find the next quote
-            if (contentEnd == std::string::npos) {
-                std::cerr << "Could not find end of 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-                retryCount++;
-                continue;
+        for (double weight : weights) {
+            result.worlds += weight;
+        }
+        if (result.worlds == 0) {
+            // Every sample was dead: fall back to treating the consistent triples as equally likely
+            weights.assign(triples.size(), 1.0);
+            result.worlds = static_cast<double>(triples.size());
+        }
+        result.envelopeOdds.assign(base.allCards ? 64 - __builtin_clzll(base.allCards) : 0, 0.0);
+        for (size_t t = 0; t < triples.size(); ++t) {
+            double probability = weights[t] / result.worlds;
+            for (uint64_t rest = triples[t]; rest; rest &= rest - 1) {
+                result.envelopeOdds[__builtin_ctzll(rest)] += probability;
+            }
+            if (probability > result.bestProbability) {
+                result.bestProbability = probability;
+                result.bestSolution = triples[t];
             }
         }
+        return result;
+    }
 
-        std::string content = response.substr(contentStart, contentEnd - contentStart);
+private:
+    static uint64_t playerCards(const Deduction& d) {
+        uint64_t cards = 0;
+        for (int p = 0; p < d.numPlayers; ++p) {
+            cards |= d.has[p];
+        }
+        return cards;
+    }
 
-        characters.clear();
-        std::stringstream ss(content);
-        std::string character;
-        while (std::getline(ss, character, ',')) {
-            // Remove leading/trailing whitespace
-            character.erase(0, character.find_first_not_of(" \t\n\r"));
-            character.erase(character.find_last_not_of(" \t\n\r") + 1);
-            characters.push_back(character);
+    static int candidatePlayers(const Deduction& d, int card) {
+        int count = 0;
+        for (int p = 0; p < d.numPlayers; ++p) {
+            count += !(d.has[p] & CardIndex::maskOf(card)) && ((d.possible(p) >> card) & 1);
         }
+        return count;
+    }
 
-        try {
-            validateLLMResponseCount(characters, 6, "characters");
-            // If validation succeeds, break out of the loop
-            break;
-        } catch (const std::exception& e) {
-            std::cerr << "Error validating LLM response: " << e.what() << " (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-            retryCount++;
+    static bool clausesHold(const Deduction& d, const std::vector<uint64_t>& hands) {
+        for (const auto& clause : d.clauses) {
+            if (!(hands[clause.first] & clause.second)) {
+                return false;
+            }
         }
+        return true;
     }
 
-    // If max retries reached, return an empty vector
-    if (retryCount == maxRetries) {
-        std::cerr << "Max retries reached for getting characters. Returning empty list." << std::endl;
-        return {};
+    // Function to count the deals of cards[next..] into the free hand slots that respect the notes
+    static double countDeals(const Deduction& d, const std::vector<int>& cards, size_t next, std::vector<int>& free, std::vector<uint64_t>& hands) {
+        if (next == cards.size()) {
+            return clausesHold(d, hands) ? 1.0 : 0.0;
+        }
+        double total = 0;
+        int card = cards[next];
+        for (int p = 0; p < d.numPlayers; ++p) {
+            if (free[p] > 0 && ((d.possible(p) >> card) & 1)) {
+                free[p]--;
+                hands[p] |= CardIndex::maskOf(card);
+                total += countDeals(d, cards, next + 1, free, hands);
+                hands[p] &= ~CardIndex::maskOf(card);
+                free[p]++;
+            }
+        }
+        return total;
     }
 
-    // Call easy_diffusion.cpp for each character
-	std::string characters_dir = "images/characters/";
-	if (!createDirectory(characters_dir))
-    {
-        std::cerr << "Could not create characters directory!" << std::endl;
+    // Function to run work items 0..numItems-1 across the solver's threads, giving each thread its own RNG
+    template <typename Work>
+    void runOnThreads(int numItems, Work work, uint64_t seed) const {
+        int numWorkers = std::min(threads, std::max(1, numItems));
+        if (numWorkers == 1) {
+            // No thread to start for a single worker, e.g. when games already run one per core
+            std::mt19937_64 rng(seed);
+            for (int item = 0; item < numItems; ++item) {
+                work(item, 0, rng);
+            }
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (int w = 0; w < numWorkers; ++w) {
+            workers.emplace_back([&, w]() {
+                std::mt19937_64 rng(seed + w);
+                for (int item = w; item < numItems; item += numWorkers) {
+                    work(item, w, rng);
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
     }
+};
 
-    for (const auto &character : characters)
-    {
-        // Generate a prompt for the character description
-        std::string prompt = "Describe the physical appearance of " + character + ". Describe them in short concise language as if you were describing them to a painter.  Such as  'A woman, sunglasses, a hat, brown coat.'  Only output your description and nothing else, no preamble or further explanation.";
-        double temperature = 1.0;
-        std::string response = getLLMResponse(prompt, temperature);
+// A bot's decision for one turn
+struct BotMove {
+    uint64_t accusation = 0; // Cards accused, or 0 to play on
+    uint64_t suggestion = 0; // Cards suggested after moving, or 0 for none
+    int row = 0;
+    int col = 0; // Where the bot ends its move
+};
 
-        // Extract the content from the JSON response
-        size_t contentStart = response.find("\"content\":\"");
-        if (contentStart == std::string::npos)
-        {
-            std::cerr << "Could not find 'content' in LLM response." << std::endl;
-            continue;
+// Function to map each board node to the room card it stands for, -1 for hallways and rooms not in play
+std::vector<int> roomCardsByNode(const Board& board, const CardIndex& cards) {
+    std::vector<int> roomCards(board.paths.numNodes, -1);
+    for (int node = 0; node < board.paths.numNodes; ++node) {
+        if (board.paths.isRoom(node)) {
+            roomCards[node] = cards.idOf(board.nameOf(board.cells[board.paths.nodeCell[node]]), "room");
         }
-        contentStart += strlen("\"content\":\"");
+    }
+    return roomCards;
+}
 
-        // Look for the end of the content, allowing for variations in the closing sequence
-        size_t contentEnd = response.find("\"}]", contentStart);
-        if (contentEnd == std::string::npos)
-        {
-            contentEnd = response.find("\"", contentStart); // Try to find the next quote
-            if (contentEnd == std::string::npos)
-            {
-                std::cerr << "Could not find end of 'content' in LLM response." << std::endl;
-                continue;
+// Function to decide a bot's turn from its posterior: accuse when the likeliest solution reaches
+// the risk threshold, otherwise head for the likeliest room and suggest the likeliest character
+// and weapon on entering a room
+BotMove chooseBotMove(const Board& board, const std::vector<int>& roomCards, const Deduction& notes, const SolverResult& posterior, int row, int col, double risk) {
+    BotMove move;
+    move.row = row;
+    move.col = col;
+    if (posterior.bestProbability >= risk) {
+        move.accusation = posterior.bestSolution;
+        return move;
+    }
+
+    // Likeliest card of each category still possible in the envelope
+    int likeliest[3] = {-1, -1, -1};
+    for (int category = 0; category < 3; ++category) {
+        for (uint64_t rest = notes.categories[category]; rest; rest &= rest - 1) {
+            int card = __builtin_ctzll(rest);
+            if (likeliest[category] < 0 || posterior.envelopeOdds[card] > posterior.envelopeOdds[likeliest[category]]) {
+                likeliest[category] = card;
+            }
+        }
+    }
+
+    // Walk one step towards the likeliest room other than the current one, if it is on the board
+    int here = board.paths.nodeAt(row, col);
+    int target = -1;
+    double targetOdds = -1;
+    for (int node = 0; node < board.paths.numNodes; ++node) {
+        if (roomCards[node] >= 0 && node != here && posterior.envelopeOdds[roomCards[node]] > targetOdds) {
+            target = node;
+            targetOdds = posterior.envelopeOdds[roomCards[node]];
+        }
+    }
+    if (target < 0) {
+        // None of the room cards are on this board: suggest from where the bot stands
+        move.suggestion = CardIndex::maskOf(likeliest[0]) | CardIndex::maskOf(likeliest[1]) | CardIndex::maskOf(likeliest[2]);
+        return move;
+    }
+    std::pair<int, int> next = board.stepToward(row, col, target);
+    move.row = next.first;
+    move.col = next.second;
+
+    // Entering a room allows a suggestion there
+    int entered = board.paths.nodeAt(move.row, move.col);
+    if (entered != here && roomCards[entered] >= 0) {
+        move.suggestion = CardIndex::maskOf(likeliest[0]) | CardIndex::maskOf(likeliest[1]) | CardIndex::maskOf(roomCards[entered]);
+    }
+    return move;
+}
+
+// The default cards, used when the LLM cannot supply a themed set
+const std::vector<Card> defaultCharacters = {
+    {"character", "Miss Scarlet"},
+    {"character", "Colonel Mustard"},
+    {"character", "Mrs. White"},
+    {"character", "Reverend Green"},
+    {"character", "Mrs. Peacock"},
+    {"character", "Professor Plum"}
+};
+const std::vector<Card> defaultWeapons = {
+    {"weapon", "Candlestick"},
+    {"weapon", "Dagger"},
+    {"weapon", "Lead Pipe"},
+    {"weapon", "Revolver"},
+    {"weapon", "Rope"},
+    {"weapon", "Wrench"}
+};
+const std::vector<Card> defaultRooms = {
+    {"room", "Cellar"},
+    {"room", "Observatory"},
+    {"room", "Theater"},
+    {"room", "Garage"},
+    {"room", "Studio"},
+    {"room", "Pantry"},
+    {"room", "Attic"},
+    {"room", "Gazebo"},
+    {"room", "Courtyard"}
+};
+
+// Boards shared by every session with the same rooms, so each layout and its path tables are
+// built once and freed with the last session using them
+struct BoardCache {
+    std::mutex mutex;
+    std::map<std::vector<std::string>, std::weak_ptr<const Board>> boards;
+
+    std::shared_ptr<const Board> get(const std::vector<Card>& rooms) {
+        std::vector<std::string> key;
+        for (const Card& room : rooms) {
+            key.push_back(room.name);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<const Board> board = boards[key].lock();
+        if (!board) {
+            board = std::make_shared<const Board>(rooms);
+            boards[key] = board;
+        }
+        return board;
+    }
+};
+
+BoardCache& boardCache() {
+    static BoardCache cache;
+    return cache;
+}
+
+// Game records: an append-only binary log of one game, enough to rebuild the state at any turn.
+// The header holds the seed, the cards in ID order, the seating and the deal. Then every change
+// to the game is one record: a kind byte followed by a fixed list of varint fields.
+//   Move: player, row, col
+//   Suggestion: player, character, weapon, room, disprover + 1, shown card + 1 (0 for none)
+//   Accusation: player, character, weapon, room
+//   TurnEnd: no fields
+// Numbers are unsigned LEB128 varints; strings are a varint length and their bytes.
+const char gameRecordMagic[8] = {'C', 'L', 'U', 'E', 'R', 'E', 'C', '1'};
+
+struct GameEvent {
+    enum Kind : uint8_t { Move = 1, Suggestion = 2, Accusation = 3, TurnEnd = 4 };
+    Kind kind = TurnEnd;
+    int player = 0;
+    int row = 0;
+    int col = 0;
+    int cards[3] = {0, 0, 0}; // Character, weapon and room IDs
+    int disprover = -1;
+    int shown = -1; // Card shown to the suggester, -1 if nobody could
+};
+
+// Function to append an unsigned LEB128 varint
+inline void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+inline void putText(std::string& out, const std::string& text) {
+    putVarint(out, text.size());
+    out += text;
+}
+
+// Decodes a game record from bytes in memory, usually a mapped file
+struct RecordReader {
+    const uint8_t* at;
+    const uint8_t* end;
+
+    RecordReader(const uint8_t* begin, const uint8_t* stop) : at(begin), end(stop) {}
+
+    // Function to read one varint, returning false if the bytes run out first
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; at < end && shift < 64; shift += 7) {
+            uint8_t byte = *at++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Function to read one varint of the header, which must be complete
+    uint64_t number() {
+        uint64_t value;
+        if (!varint(value)) {
+            throw std::runtime_error("Truncated game record header.");
+        }
+        return value;
+    }
+
+    std::string text() {
+        uint64_t length = number();
+        if (length > static_cast<uint64_t>(end - at)) {
+            throw std::runtime_error("Truncated game record header.");
+        }
+        std::string value(reinterpret_cast<const char*>(at), length);
+        at += length;
+        return value;
+    }
+
+    // Function to decode the next event. Returns false at the end of the data, or at a record
+    // cut short by a crash, leaving the reader where that record began.
+    bool next(GameEvent& event) {
+        const uint8_t* start = at;
+        if (at >= end) {
+            return false;
+        }
+        uint8_t kind = *at++;
+        if (kind < GameEvent::Move || kind > GameEvent::TurnEnd) {
+            throw std::runtime_error("Corrupt game record: unknown event kind " + std::to_string(kind) + ".");
+        }
+        int numFields = kind == GameEvent::Move ? 3 : kind == GameEvent::Suggestion ? 6 : kind == GameEvent::Accusation ? 4 : 0;
+        uint64_t fields[6];
+        for (int f = 0; f < numFields; ++f) {
+            if (!varint(fields[f])) {
+                at = start;
+                return false;
+            }
+        }
+        event.kind = static_cast<GameEvent::Kind>(kind);
+        event.player = numFields ? static_cast<int>(fields[0]) : 0;
+        if (kind == GameEvent::Move) {
+            event.row = static_cast<int>(fields[1]);
+            event.col = static_cast<int>(fields[2]);
+        } else if (numFields) {
+            for (int category = 0; category < 3; ++category) {
+                event.cards[category] = static_cast<int>(fields[1 + category]);
+            }
+            event.disprover = kind == GameEvent::Suggestion ? static_cast<int>(fields[4]) - 1 : -1;
+            event.shown = kind == GameEvent::Suggestion ? static_cast<int>(fields[5]) - 1 : -1;
+        }
+        return true;
+    }
+};
+
+// Writes one game's record to a file: the header once the cards are dealt, then its events.
+// Events are buffered and appended with one write(2) per turn, so a crash loses at most the turn
+// in progress.
+struct GameRecorder {
+    int fd = -1;
+    std::string path;
+    std::string pending; // Encoded events of the turn in progress
+
+    ~GameRecorder() {
+        close();
+    }
+
+    // Function to start a record, or to continue one when resuming a saved game
+    bool open(const std::string& recordPath, bool append = false) {
+        close();
+        path = recordPath;
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | (append ? 0 : O_TRUNC), 0644);
+        return fd >= 0;
+    }
+
+    void header(uint64_t seed, const CardIndex& cards, const std::vector<Player>& players, uint64_t solutionMask) {
+        pending.assign(gameRecordMagic, sizeof(gameRecordMagic));
+        putVarint(pending, seed);
+        putVarint(pending, cards.cards.size());
+        for (const Card& card : cards.cards) {
+            pending += static_cast<char>(card.type == "character" ? 0 : card.type == "weapon" ? 1 : 2);
+            putText(pending, card.name);
+        }
+        putVarint(pending, players.size());
+        for (const Player& player : players) {
+            pending += static_cast<char>(player.isBot);
+            putText(pending, player.name);
+            putText(pending, player.character);
+            putVarint(pending, player.handMask);
+        }
+        putVarint(pending, solutionMask);
+        flush();
+    }
+
+    void record(const GameEvent& event) {
+        pending += static_cast<char>(event.kind);
+        if (event.kind == GameEvent::Move) {
+            putVarint(pending, event.player);
+            putVarint(pending, event.row);
+            putVarint(pending, event.col);
+        } else if (event.kind != GameEvent::TurnEnd) {
+            putVarint(pending, event.player);
+            for (int card : event.cards) {
+                putVarint(pending, card);
+            }
+            if (event.kind == GameEvent::Suggestion) {
+                putVarint(pending, event.disprover + 1);
+                putVarint(pending, event.shown + 1);
+            }
+        } else {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (fd >= 0 && !pending.empty()) {
+            if (write(fd, pending.data(), pending.size()) != static_cast<ssize_t>(pending.size())) {
+                std::cerr << "Failed to write the game record: " << std::strerror(errno) << std::endl;
+            }
+        }
+        pending.clear();
+    }
+
+    void close() {
+        if (fd >= 0) {
+            flush();
+            ::close(fd);
+            fd = -1;
+        }
+    }
+};
+
+// One game of clue and everything it needs: its cards, board, players, notes and turn state.
+// Turns run as a state machine driven by one line of player input at a time, and everything the
+// game says is collected for the host to deliver, so one process can interleave many sessions.
+struct GameSession {
+    enum class Phase { ChooseAction, MoveRow, MoveCol, SuggestCharacter, SuggestWeapon, SuggestRoom, AccuseCharacter, AccuseWeapon, AccuseRoom, GameOver };
+
+    std::vector<Card> characters;
+    std::vector<Card> weapons;
+    std::vector<Card> rooms;
+    std::shared_ptr<const Board> board;
+    CardIndex cards;
+    std::vector<int> roomCards; // Room card of each board node
+    std::vector<Player> players;
+    std::vector<uint64_t> handMasks; // Each player's handMask, contiguous for disproval
+    std::vector<Checklist> checklists;
+    uint64_t solutionMask = 0; // The envelope's three cards
+    int winnerIndex = -1; // Player who made the correct accusation
+    int current = 0; // Whose turn it is
+    long long turnsPlayed = 0;
+    Phase phase = Phase::GameOver;
+    std::string pending[2]; // Answers so far in a multi-line action (row, or character and weapon)
+    // A piece of what the game says, and who may see it
+    struct Message {
+        int to = -1; // The only player it is for, or -1 for everyone
+        int except = -1; // A player it is kept from, or -1
+        bool prompt = false; // Asks for the next line; only interactive hosts need it
+        std::string text;
+    };
+    std::vector<Message> messages; // What the game has said since the last takeOutput() or takeMessages()
+    bool muted = false; // Say nothing, while replaying a record
+    bool collectPreviews = false; // Note the cards people are shown, for a terminal host that previews their images
+    std::vector<int> previews; // Card IDs noted since the last takePreviews()
+    uint64_t seed = 0; // Seed of the deal
+    std::string theme; // Theme the cards were made for, if any
+    std::unique_ptr<GameRecorder> recorder; // Where the game's record is written, if anywhere
+
+    // Everything that changes during play, so a replay can jump back to a turn
+    struct TurnState {
+        std::vector<Player> players;
+        std::vector<Checklist> checklists;
+        uint64_t solutionMask;
+        int winnerIndex;
+        int current;
+        long long turnsPlayed;
+        Phase phase;
+    };
+
+    GameSession(const std::vector<Card>& sessionCharacters, const std::vector<Card>& sessionWeapons, const std::vector<Card>& sessionRooms)
+        : characters(sessionCharacters), weapons(sessionWeapons), rooms(sessionRooms), board(boardCache().get(sessionRooms)) {
+        if (characters.empty() || weapons.empty() || rooms.empty()) {
+            throw std::runtime_error("A game needs at least one character, weapon and room.");
+        }
+        cards.build(characters, weapons, rooms);
+        roomCards = roomCardsByNode(*board, cards);
+    }
+
+    // Function to pick the solution, seat the players (bots last) and deal, then start the first turn
+    void deal(const std::vector<std::string>& humanNames, int numBots, uint64_t dealSeed) {
+        int numPlayers = static_cast<int>(humanNames.size()) + numBots;
+        seed = dealSeed;
+        std::mt19937_64 rng(seed);
+        std::vector<Card> deck;
+        deck.insert(deck.end(), characters.begin(), characters.end());
+        deck.insert(deck.end(), weapons.begin(), weapons.end());
+        deck.insert(deck.end(), rooms.begin(), rooms.end());
+        std::shuffle(deck.begin(), deck.end(), rng);
+
+        // Select the solution (one character, one weapon, one room) and remove it from the deck
+        solutionMask = 0;
+        for (const char* type : {"character", "weapon", "room"}) {
+            auto it = std::find_if(deck.begin(), deck.end(), [type](const Card& card) { return card.type == type; });
+            solutionMask |= CardIndex::maskOf(cards.ids[it->name]);
+            deck.erase(it);
+        }
+
+        players.clear();
+        for (int i = 0; i < numPlayers; ++i) {
+            Player newPlayer;
+            newPlayer.isBot = i >= static_cast<int>(humanNames.size());
+            newPlayer.name = newPlayer.isBot ? "Bot-" + std::to_string(i - humanNames.size() + 1) : humanNames[i];
+            newPlayer.character = characters[i % characters.size()].name; // Assign characters in order for now
+            // Assign initial locations: a hallway cell of the board, whatever its layout
+            std::pair<int, int> start = board->startPosition(i);
+            newPlayer.row = start.first;
+            newPlayer.col = start.second;
+            players.push_back(newPlayer);
+        }
+
+        // Deal the remaining cards to the players
+        int playerIndex = 0;
+        for (const Card& card : deck) {
+            players[playerIndex].hand.push_back(card.name);
+            players[playerIndex].handMask |= CardIndex::maskOf(cards.ids[card.name]);
+            playerIndex = (playerIndex + 1) % numPlayers;
+        }
+        startGame();
+    }
+
+    // Function to start the first turn once the players are seated and dealt, recording the deal
+    void startGame() {
+        handMasks.clear();
+        std::vector<int> handSizes;
+        for (const Player& player : players) {
+            handMasks.push_back(player.handMask);
+            handSizes.push_back(static_cast<int>(player.hand.size()));
+        }
+        checklists.clear();
+        for (size_t i = 0; i < players.size(); ++i) {
+            checklists.emplace_back(cards, static_cast<int>(i), players[i].handMask, handSizes); // Initialize checklist for each player
+        }
+
+        winnerIndex = -1;
+        turnsPlayed = 0;
+        current = 0;
+        if (recorder) {
+            recorder->header(seed, cards, players, solutionMask);
+        }
+        beginTurn();
+    }
+
+    // Function to carry on at the start of the current player's turn after loading a saved game
+    void resumeTurn() {
+        int activePlayers = 0;
+        for (const Player& player : players) {
+            activePlayers += !player.eliminated;
+        }
+        if (winnerIndex >= 0 || activePlayers <= 1) {
+            phase = Phase::GameOver;
+            return;
+        }
+        beginTurn();
+    }
+
+    TurnState saveState() const {
+        TurnState state;
+        state.players = players;
+        state.checklists = checklists;
+        state.solutionMask = solutionMask;
+        state.winnerIndex = winnerIndex;
+        state.current = current;
+        state.turnsPlayed = turnsPlayed;
+        state.phase = phase;
+        return state;
+    }
+
+    void restoreState(const TurnState& state) {
+        players = state.players;
+        checklists = state.checklists;
+        solutionMask = state.solutionMask;
+        winnerIndex = state.winnerIndex;
+        current = state.current;
+        turnsPlayed = state.turnsPlayed;
+        phase = state.phase;
+        handMasks.clear();
+        for (const Player& player : players) {
+            handMasks.push_back(player.handMask);
+        }
+    }
+
+    // Function to redo one recorded event, exactly as when it was played
+    void apply(const GameEvent& event) {
+        switch (event.kind) {
+            case GameEvent::Move:
+                players[event.player].row = event.row;
+                players[event.player].col = event.col;
+                break;
+            case GameEvent::Suggestion:
+                resolveSuggestion(event.player, event.cards[0], event.cards[1], event.cards[2]);
+                break;
+            case GameEvent::Accusation:
+                resolveAccusation(event.player, CardIndex::maskOf(event.cards[0]) | CardIndex::maskOf(event.cards[1]) | CardIndex::maskOf(event.cards[2]));
+                break;
+            case GameEvent::TurnEnd:
+                endTurn();
+                break;
+        }
+    }
+
+    bool over() const {
+        return phase == Phase::GameOver;
+    }
+
+    // Whether the game is waiting on a line from the current (human) player
+    bool awaitingInput() const {
+        return phase != Phase::GameOver && !players[current].isBot;
+    }
+
+    // Function to hand over what the game has said since the last call, as seen on one shared
+    // terminal: everything for everyone and for people, nothing for bots' eyes only
+    std::string takeOutput() {
+        std::string text;
+        for (const Message& message : messages) {
+            bool forBot = message.to >= 0 && players[message.to].isBot;
+            bool hiddenFromPerson = message.except >= 0 && !players[message.except].isBot;
+            if (!forBot && !hiddenFromPerson) {
+                text += message.text;
+            }
+        }
+        messages.clear();
+        return text;
+    }
+
+    // Function to hand over the cards people walked into or were shown since the last call
+    std::vector<int> takePreviews() {
+        std::vector<int> taken;
+        taken.swap(previews);
+        return taken;
+    }
+
+    // Function to hand over what the game has said since the last call, for hosts that deliver
+    // each player's messages separately
+    std::vector<Message> takeMessages() {
+        std::vector<Message> taken;
+        taken.swap(messages);
+        return taken;
+    }
+
+    // Function to advance the current player's turn with one line of their input
+    void handleInput(const std::string& line) {
+        if (!awaitingInput()) {
+            return;
+        }
+        Player& player = players[current];
+        switch (phase) {
+            case Phase::ChooseAction: {
+                int choice = 0;
+                try {
+                    choice = std::stoi(line);
+                } catch (const std::exception& e) {
+                }
+                if (choice == 1) { // Move
+                    prompt(current, "Enter the row you want to move to: ");
+                    phase = Phase::MoveRow;
+                } else if (choice == 2) { // Suggestion
+                    prompt(current, "Make a suggestion (Character, Weapon, Room):\nCharacter: ");
+                    phase = Phase::SuggestCharacter;
+                } else if (choice == 3) { // Accusation
+                    prompt(current, "Make an accusation (Character, Weapon, Room):\nCharacter: ");
+                    phase = Phase::AccuseCharacter;
+                } else if (choice == 4) { // Show Checklist
+                    std::ostringstream checklist;
+                    checklists[current].display(players, checklist);
+                    tell(current, checklist.str());
+                    endTurn();
+                } else if (choice == 5) { // End turn
+                    tell(current, "Ending turn.\n");
+                    endTurn();
+                } else {
+                    tell(current, "Invalid choice.\n");
+                    endTurn();
+                }
+                break;
+            }
+            case Phase::MoveRow:
+                pending[0] = line;
+                prompt(current, "Enter the column you want to move to: ");
+                phase = Phase::MoveCol;
+                break;
+            case Phase::MoveCol: {
+                int newRow = -1;
+                int newCol = -1;
+                try {
+                    newRow = std::stoi(pending[0]);
+                    newCol = std::stoi(line);
+                } catch (const std::exception& e) {
+                }
+                if (board->isValidMove(player.row, player.col, newRow, newCol)) {
+                    int left = board->paths.nodeAt(player.row, player.col);
+                    player.row = newRow;
+                    player.col = newCol;
+                    recordMove(current);
+                    tell(current, "You moved to row " + std::to_string(newRow) + ", column " + std::to_string(newCol) + "\n");
+                    int entered = board->paths.nodeAt(newRow, newCol);
+                    if (entered != left && roomCards[entered] >= 0) {
+                        notePreview(current, roomCards[entered]);
+                    }
+                } else {
+                    tell(current, "Invalid move.\n");
+                }
+                endTurn();
+                break;
+            }
+            case Phase::SuggestCharacter:
+            case Phase::AccuseCharacter:
+                pending[0] = line;
+                prompt(current, "Weapon: ");
+                phase = phase == Phase::SuggestCharacter ? Phase::SuggestWeapon : Phase::AccuseWeapon;
+                break;
+            case Phase::SuggestWeapon:
+            case Phase::AccuseWeapon:
+                pending[1] = line;
+                prompt(current, "Room: ");
+                phase = phase == Phase::SuggestWeapon ? Phase::SuggestRoom : Phase::AccuseRoom;
+                break;
+            case Phase::SuggestRoom:
+            case Phase::AccuseRoom: {
+                bool suggesting = phase == Phase::SuggestRoom;
+                if (suggesting) {
+                    tell(current, "You suggested it was " + pending[0] + " with the " + pending[1] + " in the " + line + "\n");
+                    sayExcept(current, player.name + " suggests " + pending[0] + " with the " + pending[1] + " in the " + line + ".\n");
+                }
+                int characterId = cards.idOf(pending[0], "character");
+                int weaponId = cards.idOf(pending[1], "weapon");
+                int roomId = cards.idOf(line, "room");
+                if (characterId < 0 || weaponId < 0 || roomId < 0) {
+                    tell(current, std::string("That is not a valid ") + (suggesting ? "suggestion" : "accusation") + ": name one character, one weapon and one room in play.\n");
+                } else if (suggesting) {
+                    resolveSuggestion(current, characterId, weaponId, roomId);
+                } else {
+                    resolveAccusation(current, CardIndex::maskOf(characterId) | CardIndex::maskOf(weaponId) | CardIndex::maskOf(roomId));
+                }
+                endTurn();
+                break;
+            }
+            case Phase::GameOver:
+                break;
+        }
+    }
+
+    // Function to play the current player's turn when it is a bot's
+    void playBotTurn(const SolutionSolver& solver, double risk, uint64_t seed) {
+        if (phase == Phase::GameOver || !players[current].isBot) {
+            return;
+        }
+        Player& bot = players[current];
+        const SolverResult posterior = solver.solve(checklists[current], seed);
+        BotMove move = chooseBotMove(*board, roomCards, checklists[current].deduction, posterior, bot.row, bot.col, risk);
+        if (move.accusation) {
+            say(bot.name + " accuses: " + describeCards(move.accusation) + " (" + std::to_string(static_cast<int>(posterior.bestProbability * 100 + 0.5)) + "% sure).\n");
+            resolveAccusation(current, move.accusation);
+        } else {
+            if (bot.row != move.row || bot.col != move.col) {
+                bot.row = move.row;
+                bot.col = move.col;
+                recordMove(current);
+            }
+            if (move.suggestion) {
+                int ids[3];
+                for (int category = 0; category < 3; ++category) {
+                    ids[category] = __builtin_ctzll(move.suggestion & checklists[current].deduction.categories[category]);
+                }
+                say(bot.name + " suggests " + cards.cards[ids[0]].name + " with the " + cards.cards[ids[1]].name + " in the " + cards.cards[ids[2]].name + ".\n");
+                resolveSuggestion(current, ids[0], ids[1], ids[2]);
+            }
+        }
+        endTurn();
+    }
+
+    // Function to name the cards of a card mask, in ID order
+    std::string describeCards(uint64_t mask) const {
+        std::string text;
+        for (uint64_t rest = mask; rest; rest &= rest - 1) {
+            text += (text.empty() ? "" : ", ") + cards.cards[__builtin_ctzll(rest)].name;
+        }
+        return text;
+    }
+
+    // Rough bytes owned by this session (the shared board is not counted)
+    size_t memoryUsage() const {
+        size_t bytes = sizeof(*this) + messages.capacity() * sizeof(Message) + (handMasks.capacity() + roomCards.capacity()) * sizeof(uint64_t);
+        for (const std::vector<Card>* group : {&characters, &weapons, &rooms}) {
+            bytes += group->capacity() * sizeof(Card);
+        }
+        bytes += cards.cards.capacity() * sizeof(Card) + cards.ids.size() * 64;
+        for (const Player& player : players) {
+            bytes += sizeof(Player) + player.hand.capacity() * sizeof(std::string);
+        }
+        for (const Checklist& checklist : checklists) {
+            const Deduction& d = checklist.deduction;
+            bytes += sizeof(Checklist) + (d.has.capacity() + d.hasNot.capacity() + checklist.ruledOutSolutions.capacity()) * sizeof(uint64_t)
+                     + d.handSizes.capacity() * sizeof(int) + d.clauses.capacity() * sizeof(d.clauses[0]) + checklist.envelopeOdds.capacity() * sizeof(double);
+        }
+        return bytes;
+    }
+
+private:
+    // Functions to say something to everyone, to one player, or to everyone but one player
+    void say(const std::string& text) {
+        addMessage(-1, -1, false, text);
+    }
+
+    void tell(int playerIndex, const std::string& text) {
+        addMessage(playerIndex, -1, false, text);
+    }
+
+    void prompt(int playerIndex, const std::string& text) {
+        addMessage(playerIndex, -1, true, text);
+    }
+
+    void sayExcept(int playerIndex, const std::string& text) {
+        addMessage(-1, playerIndex, false, text);
+    }
+
+    // Function to append a message, merging it into the last one when it has the same audience
+    void addMessage(int to, int except, bool isPrompt, const std::string& text) {
+        if (muted) {
+            return;
+        }
+        if (!messages.empty() && messages.back().to == to && messages.back().except == except && messages.back().prompt == isPrompt) {
+            messages.back().text += text;
+            return;
+        }
+        Message message;
+        message.to = to;
+        message.except = except;
+        message.prompt = isPrompt;
+        message.text = text;
+        messages.push_back(message);
+    }
+
+    // Function to note a card a person was shown, if the host previews images
+    void notePreview(int playerIndex, int card) {
+        if (collectPreviews && !muted && !players[playerIndex].isBot) {
+            previews.push_back(card);
+        }
+    }
+
+    void recordMove(int playerIndex) {
+        if (recorder) {
+            GameEvent event;
+            event.kind = GameEvent::Move;
+            event.player = playerIndex;
+            event.row = players[playerIndex].row;
+            event.col = players[playerIndex].col;
+            recorder->record(event);
+        }
+    }
+
+    // Function to announce the current player's turn and, for people, show their hand and the menu
+    void beginTurn() {
+        phase = Phase::ChooseAction;
+        const Player& player = players[current];
+        say("\n" + player.name + "'s turn (" + player.character + "):\n");
+        say("Current location: Row " + std::to_string(player.row) + ", Column " + std::to_string(player.col) + "\n");
+        if (!player.isBot) {
+            // Display player's hand (for debugging)
+            std::string hand = "Your hand: ";
+            for (const std::string& card : player.hand) {
+                hand += card + ", ";
+            }
+            tell(current, hand + "\n");
+            prompt(current, "\n" + player.name + ", what would you like to do?\n1. Move\n2. Make a suggestion\n3. Make an accusation\n4. Show Checklist\n5. End turn\n");
+        }
+    }
+
+    // Function to finish a turn: end the game if it is decided, else pass to the next player still in
+    void endTurn() {
+        turnsPlayed++;
+        if (recorder) {
+            recorder->record(GameEvent());
+        }
+        int activePlayers = 0;
+        for (const Player& player : players) {
+            activePlayers += !player.eliminated;
+        }
+        if (winnerIndex >= 0 || activePlayers <= 1) {
+            phase = Phase::GameOver;
+            say("Game over!\n");
+            if (winnerIndex < 0 && activePlayers == 1) {
+                for (size_t i = 0; i < players.size(); ++i) {
+                    if (!players[i].eliminated) {
+                        winnerIndex = static_cast<int>(i); // The last player standing
+                    }
+                }
+            }
+            if (winnerIndex >= 0) {
+                say(players[winnerIndex].name + " wins.\n");
+            }
+            say("The solution was " + describeCards(solutionMask) + ".\n");
+            return;
+        }
+        do {
+            current = (current + 1) % static_cast<int>(players.size());
+        } while (players[current].eliminated);
+        beginTurn();
+    }
+
+    // Function to resolve a suggestion: find the disprover and let every checklist observe the outcome
+    void resolveSuggestion(int playerIndex, int characterId, int weaponId, int roomId) {
+        uint64_t suggestion = CardIndex::maskOf(characterId) | CardIndex::maskOf(weaponId) | CardIndex::maskOf(roomId);
+        int disprover;
+        int shown = disproveSuggestion(handMasks.data(), static_cast<int>(handMasks.size()), playerIndex, suggestion, disprover);
+        if (recorder) {
+            GameEvent event;
+            event.kind = GameEvent::Suggestion;
+            event.player = playerIndex;
+            event.cards[0] = characterId;
+            event.cards[1] = weaponId;
+            event.cards[2] = roomId;
+            event.disprover = shown < 0 ? -1 : disprover;
+            event.shown = shown;
+            recorder->record(event);
+        }
+        if (shown < 0) {
+            say("Nobody could disprove the suggestion.\n");
+        } else {
+            tell(playerIndex, players[disprover].name + " disproved it by showing you " + cards.cards[shown].name + ".\n");
+            notePreview(playerIndex, shown);
+            sayExcept(playerIndex, players[disprover].name + " disproved it by showing " + players[playerIndex].name + " a card.\n");
+        }
+        // Everyone sees who disproved it; only the suggester sees the card
+        for (size_t q = 0; q < checklists.size(); ++q) {
+            checklists[q].observeSuggestion(playerIndex, suggestion, disprover, static_cast<int>(q) == playerIndex ? shown : -1);
+        }
+    }
+
+    // Function to resolve an accusation: a correct one wins, a wrong one eliminates the accuser
+    void resolveAccusation(int playerIndex, uint64_t triple) {
+        if (recorder) {
+            GameEvent event;
+            event.kind = GameEvent::Accusation;
+            event.player = playerIndex;
+            for (int category = 0; category < 3; ++category) {
+                event.cards[category] = __builtin_ctzll(triple & checklists[playerIndex].deduction.categories[category]);
+            }
+            recorder->record(event);
+        }
+        if (triple == solutionMask) {
+            say(players[playerIndex].name + " solved the mystery!\n");
+            winnerIndex = playerIndex;
+            return;
+        }
+        say(players[playerIndex].name + " accused wrongly and is out of the game (but still shows cards).\n");
+        players[playerIndex].eliminated = true;
+        for (Checklist& checklist : checklists) {
+            checklist.ruleOutSolution(triple);
+        }
+    }
+};
+
+// A game record mapped into memory, and a session rebuilt from it that can be moved to the
+// start of any turn. Seeking forward replays the turns in between; snapshots of the turn state,
+// taken every snapshotInterval turns on the way, let later seeks replay at most that many turns.
+struct GameReplay {
+    int fd = -1;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::unique_ptr<GameSession> session;
+    std::vector<size_t> turnOffsets; // Offset of each turn's first event, then the end of the last turn
+    std::vector<GameSession::TurnState> snapshots; // State at the start of turn k * snapshotInterval
+    int snapshotInterval;
+    long long position = 0; // Turn the session is at the start of
+
+    GameReplay(const std::string& path, int interval = 32) : snapshotInterval(std::max(1, interval)) {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            throw std::runtime_error("Cannot open game record " + path + ": " + std::strerror(errno));
+        }
+        size = static_cast<size_t>(info.st_size);
+        if (size < sizeof(gameRecordMagic) || (data = static_cast<const uint8_t*>(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0))) == MAP_FAILED
+            || std::memcmp(data, gameRecordMagic, sizeof(gameRecordMagic)) != 0) {
+            data = nullptr;
+            ::close(fd);
+            throw std::runtime_error("Not a clue game record: " + path);
+        }
+
+        try {
+            readHeader(path);
+        } catch (...) {
+            munmap(const_cast<uint8_t*>(data), size);
+            ::close(fd);
+            throw;
+        }
+    }
+
+    ~GameReplay() {
+        munmap(const_cast<uint8_t*>(data), size);
+        ::close(fd);
+    }
+
+    long long turns() const {
+        return static_cast<long long>(turnOffsets.size()) - 1;
+    }
+
+    // Function to read the events of one turn, straight from the mapped record
+    std::vector<GameEvent> eventsOf(long long turn) const {
+        std::vector<GameEvent> events;
+        RecordReader reader(data + turnOffsets[turn], data + turnOffsets[turn + 1]);
+        GameEvent event;
+        while (reader.next(event)) {
+            events.push_back(event);
+        }
+        return events;
+    }
+
+    // Function to bring the session to the start of a turn (clamped to the recorded turns)
+    GameSession& seek(long long turn) {
+        turn = std::max(0LL, std::min(turn, turns()));
+        long long nearest = std::min(turn / snapshotInterval, static_cast<long long>(snapshots.size()) - 1) * snapshotInterval;
+        if (turn < position || nearest > position) {
+            session->restoreState(snapshots[nearest / snapshotInterval]);
+            position = nearest;
+        }
+        RecordReader reader(data + turnOffsets[position], data + turnOffsets[turn]);
+        GameEvent event;
+        while (reader.next(event)) {
+            session->apply(event);
+            if (event.kind == GameEvent::TurnEnd && ++position % snapshotInterval == 0 && position / snapshotInterval == static_cast<long long>(snapshots.size())) {
+                snapshots.push_back(session->saveState());
+            }
+        }
+        return *session;
+    }
+
+private:
+    // Function to read the header (seed, cards, then the seating and the deal), set up the
+    // session at its first turn and index the turns
+    void readHeader(const std::string& path) {
+        RecordReader reader(data + sizeof(gameRecordMagic), data + size);
+        uint64_t seed = reader.number();
+        std::vector<Card> groups[3];
+        static const char* types[3] = {"character", "weapon", "room"};
+        for (uint64_t c = reader.number(); c > 0; --c) {
+            if (reader.at >= reader.end || *reader.at > 2) {
+                throw std::runtime_error("Corrupt game record header: " + path);
+            }
+            int type = *reader.at++;
+            groups[type].push_back({types[type], reader.text()});
+        }
+        session.reset(new GameSession(groups[0], groups[1], groups[2]));
+        session->muted = true;
+        session->seed = seed;
+        for (uint64_t p = reader.number(); p > 0; --p) {
+            Player player;
+            player.isBot = reader.at < reader.end && *reader.at++ != 0;
+            player.name = reader.text();
+            player.character = reader.text();
+            player.handMask = reader.number();
+            for (uint64_t rest = player.handMask; rest; rest &= rest - 1) {
+                player.hand.push_back(session->cards.cards[__builtin_ctzll(rest)].name);
+            }
+            std::pair<int, int> start = session->board->startPosition(static_cast<int>(session->players.size()));
+            player.row = start.first;
+            player.col = start.second;
+            session->players.push_back(player);
+        }
+        session->solutionMask = reader.number();
+        if (session->players.empty()) {
+            throw std::runtime_error("Corrupt game record header: " + path);
+        }
+        session->startGame();
+        snapshots.push_back(session->saveState());
+
+        // Index where each complete turn starts; a turn cut short by a crash is left out
+        GameEvent event;
+        turnOffsets.push_back(reader.at - data);
+        while (reader.next(event)) {
+            if (event.kind == GameEvent::TurnEnd) {
+                turnOffsets.push_back(reader.at - data);
+            }
+        }
+    }
+};
+
+// Saved games: a whole session at a turn boundary in one file, laid out as fixed-size records in
+// native byte order so a loader can map the file and use them in place. The header locates each
+// array by byte offset and count, and strings live in one blob named by offset and length. A
+// file of another version, or whose offsets leave the file, is rejected rather than parsed.
+const char gameSnapshotMagic[8] = {'C', 'L', 'U', 'E', 'S', 'A', 'V', 'E'};
+const uint32_t gameSnapshotVersion = 1;
+
+struct SnapshotSpan {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct SnapshotString {
+    uint32_t offset; // Into the string blob
+    uint32_t length;
+};
+
+struct SnapshotCard {
+    SnapshotString name;
+    SnapshotString asset; // Image path
+    uint32_t type; // 0 character, 1 weapon, 2 room
+    uint32_t reserved;
+};
+
+struct SnapshotPlayer {
+    SnapshotString name;
+    SnapshotString character;
+    uint64_t handMask;
+    int32_t row;
+    int32_t col;
+    uint8_t eliminated;
+    uint8_t isBot;
+    uint8_t reserved[6];
+};
+
+// A player's checklist. Its has and hasNot masks are numPlayers + 1 entries (the envelope last)
+// of the shared has and hasNot arrays, in player order.
+struct SnapshotNotes {
+    SnapshotSpan clauses; // Into the clause array
+    SnapshotSpan ruledOut; // Into the ruled-out solution array
+    uint32_t consistent;
+    uint32_t reserved;
+};
+
+struct SnapshotClause {
+    int64_t player;
+    uint64_t cards;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t fileBytes;
+    uint64_t seed;
+    uint64_t solutionMask;
+    int64_t turnsPlayed;
+    int32_t current;
+    int32_t winnerIndex;
+    int32_t numPlayers;
+    int32_t reserved;
+    SnapshotString theme;
+    SnapshotString recordPath;
+    SnapshotSpan strings; // Bytes
+    SnapshotSpan cards; // In card ID order
+    SnapshotSpan players;
+    SnapshotSpan notes; // One per player
+    SnapshotSpan has; // uint64_t masks
+    SnapshotSpan hasNot;
+    SnapshotSpan clauses;
+    SnapshotSpan ruledOut; // uint64_t triples
+};
+
+static_assert(sizeof(SnapshotCard) == 24 && sizeof(SnapshotPlayer) == 40 && sizeof(SnapshotNotes) == 40 && sizeof(SnapshotClause) == 16,
+              "Saved game records must keep their layout");
+
+std::string imageRoot = "images/"; // Directory generated images are written under
+
+// Image files of a resumed game's cards, as saved with it (type, tab, name -> path)
+std::map<std::string, std::string> savedAssetPaths;
+
+// Function to name the image file of a card
+std::string assetPath(const Card& card) {
+    auto saved = savedAssetPaths.find(card.type + "\t" + card.name);
+    return saved != savedAssetPaths.end() ? saved->second : imageRoot + card.type + "s/" + card.name + ".png";
+}
+
+// Function to save a session at a turn boundary. The file is built in the buffer (reused between
+// saves), written next to the path and renamed over it, so a crash leaves the previous save intact.
+bool saveGameSnapshot(const GameSession& session, const std::string& path, std::string& buffer) {
+    int numPlayers = static_cast<int>(session.players.size());
+    std::string strings;
+    auto addString = [&strings](const std::string& text) -> SnapshotString {
+        SnapshotString ref = {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size())};
+        strings += text;
+        return ref;
+    };
+
+    std::vector<SnapshotCard> cards(session.cards.cards.size());
+    for (size_t id = 0; id < cards.size(); ++id) {
+        const Card& card = session.cards.cards[id];
+        cards[id].name = addString(card.name);
+        cards[id].asset = addString(assetPath(card));
+        cards[id].type = card.type == "character" ? 0 : card.type == "weapon" ? 1 : 2;
+        cards[id].reserved = 0;
+    }
+    std::vector<SnapshotPlayer> players(numPlayers);
+    for (int p = 0; p < numPlayers; ++p) {
+        const Player& player = session.players[p];
+        std::memset(&players[p], 0, sizeof(SnapshotPlayer));
+        players[p].name = addString(player.name);
+        players[p].character = addString(player.character);
+        players[p].handMask = player.handMask;
+        players[p].row = player.row;
+        players[p].col = player.col;
+        players[p].eliminated = player.eliminated;
+        players[p].isBot = player.isBot;
+    }
+    std::vector<SnapshotNotes> notes(numPlayers);
+    std::vector<uint64_t> has, hasNot, ruledOut;
+    std::vector<SnapshotClause> clauses;
+    for (int p = 0; p < numPlayers; ++p) {
+        const Checklist& checklist = session.checklists[p];
+        const Deduction& deduction = checklist.deduction;
+        has.insert(has.end(), deduction.has.begin(), deduction.has.end());
+        hasNot.insert(hasNot.end(), deduction.hasNot.begin(), deduction.hasNot.end());
+        notes[p].clauses = {clauses.size(), deduction.clauses.size()};
+        for (const std::pair<int, uint64_t>& clause : deduction.clauses) {
+            clauses.push_back({clause.first, clause.second});
+        }
+        notes[p].ruledOut = {ruledOut.size(), checklist.ruledOutSolutions.size()};
+        ruledOut.insert(ruledOut.end(), checklist.ruledOutSolutions.begin(), checklist.ruledOutSolutions.end());
+        notes[p].consistent = deduction.consistent;
+        notes[p].reserved = 0;
+    }
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, gameSnapshotMagic, sizeof(header.magic));
+    header.version = gameSnapshotVersion;
+    header.headerBytes = sizeof(SnapshotHeader);
+    header.seed = session.seed;
+    header.solutionMask = session.solutionMask;
+    header.turnsPlayed = session.turnsPlayed;
+    header.current = session.current;
+    header.winnerIndex = session.winnerIndex;
+    header.numPlayers = numPlayers;
+    header.theme = addString(session.theme);
+    header.recordPath = addString(session.recorder ? session.recorder->path : "");
+
+    // Lay the arrays out after the header, each 8-byte aligned, and the string blob last
+    buffer.assign(sizeof(SnapshotHeader), '\0');
+    auto addArray = [&buffer](const void* items, size_t count, size_t itemBytes) -> SnapshotSpan {
+        buffer.resize((buffer.size() + 7) & ~static_cast<size_t>(7), '\0');
+        SnapshotSpan span = {buffer.size(), count};
+        buffer.append(static_cast<const char*>(items), count * itemBytes);
+        return span;
+    };
+    header.cards = addArray(cards.data(), cards.size(), sizeof(SnapshotCard));
+    header.players = addArray(players.data(), players.size(), sizeof(SnapshotPlayer));
+    header.notes = addArray(notes.data(), notes.size(), sizeof(SnapshotNotes));
+    header.has = addArray(has.data(), has.size(), sizeof(uint64_t));
+    header.hasNot = addArray(hasNot.data(), hasNot.size(), sizeof(uint64_t));
+    header.clauses = addArray(clauses.data(), clauses.size(), sizeof(SnapshotClause));
+    header.ruledOut = addArray(ruledOut.data(), ruledOut.size(), sizeof(uint64_t));
+    header.strings = addArray(strings.data(), strings.size(), 1);
+    header.fileBytes = buffer.size();
+    std::memcpy(&buffer[0], &header, sizeof(header));
+
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool written = fd >= 0 && write(fd, buffer.data(), buffer.size()) == static_cast<ssize_t>(buffer.size());
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to save the game to " << path << ": " << std::strerror(errno) << std::endl;
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Function to load a saved game by mapping it, checking the header and copying the arrays out.
+// The session continues its record, if it had one, and resumes at the saved turn.
+std::unique_ptr<GameSession> loadGameSnapshot(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        throw std::runtime_error("Cannot open saved game " + path + ": " + std::strerror(errno));
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = size >= sizeof(SnapshotHeader) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Not a saved clue game: " + path);
+    }
+    struct Mapping {
+        void* base;
+        size_t size;
+        ~Mapping() {
+            munmap(base, size);
+        }
+    } mapped = {mapping, size};
+    const char* base = static_cast<const char*>(mapping);
+    const SnapshotHeader& header = *reinterpret_cast<const SnapshotHeader*>(base);
+    if (std::memcmp(header.magic, gameSnapshotMagic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not a saved clue game: " + path);
+    }
+    if (header.version != gameSnapshotVersion || header.headerBytes != sizeof(SnapshotHeader)) {
+        throw std::runtime_error("Saved game " + path + " is version " + std::to_string(header.version) + "; this clue reads version " + std::to_string(gameSnapshotVersion) + ".");
+    }
+
+    // Every array must lie inside the file, and the counts must agree with each other
+    auto fits = [size](const SnapshotSpan& span, size_t itemBytes) -> bool {
+        return span.offset <= size && span.count <= (size - span.offset) / itemBytes && span.offset % std::min<size_t>(itemBytes, 8) == 0;
+    };
+    int numPlayers = header.numPlayers;
+    bool valid = header.fileBytes == size && numPlayers > 0 && numPlayers <= Deduction::maxPlayers && fits(header.strings, 1)
+                 && fits(header.cards, sizeof(SnapshotCard)) && header.cards.count <= static_cast<uint64_t>(CardIndex::maxCards)
+                 && fits(header.players, sizeof(SnapshotPlayer)) && header.players.count == static_cast<uint64_t>(numPlayers)
+                 && fits(header.notes, sizeof(SnapshotNotes)) && header.notes.count == static_cast<uint64_t>(numPlayers)
+                 && fits(header.has, sizeof(uint64_t)) && header.has.count == static_cast<uint64_t>(numPlayers) * (numPlayers + 1)
+                 && fits(header.hasNot, sizeof(uint64_t)) && header.hasNot.count == header.has.count
+                 && fits(header.clauses, sizeof(SnapshotClause)) && fits(header.ruledOut, sizeof(uint64_t))
+                 && header.current >= 0 && header.current < numPlayers && header.winnerIndex >= -1 && header.winnerIndex < numPlayers;
+    const char* blob = base + header.strings.offset;
+    auto text = [&](const SnapshotString& ref) -> std::string {
+        if (static_cast<uint64_t>(ref.offset) + ref.length > header.strings.count) {
+            throw std::runtime_error("Corrupt saved game: " + path);
+        }
+        return std::string(blob + ref.offset, ref.length);
+    };
+    if (!valid) {
+        throw std::runtime_error("Corrupt saved game: " + path);
+    }
+
+    const SnapshotCard* cards = reinterpret_cast<const SnapshotCard*>(base + header.cards.offset);
+    std::vector<Card> groups[3];
+    static const char* types[3] = {"character", "weapon", "room"};
+    std::map<std::string, std::string> assets;
+    for (uint64_t id = 0; id < header.cards.count; ++id) {
+        uint32_t type = std::min<uint32_t>(cards[id].type, 2);
+        groups[type].push_back({types[type], text(cards[id].name)});
+        std::string asset = text(cards[id].asset);
+        if (!asset.empty()) {
+            assets[groups[type].back().type + "\t" + groups[type].back().name] = asset;
+        }
+    }
+    std::unique_ptr<GameSession> session(new GameSession(groups[0], groups[1], groups[2]));
+    session->theme = text(header.theme);
+    session->seed = header.seed;
+    size_t numCards = session->cards.cards.size();
+    uint64_t allCards = numCards == 64 ? ~uint64_t(0) : (uint64_t(1) << numCards) - 1;
+    // The solution is one card of each category
+    uint64_t categories[3] = {0, 0, 0};
+    for (size_t id = 0; id < numCards; ++id) {
+        const std::string& type = session->cards.cards[id].type;
+        categories[type == "character" ? 0 : (type == "weapon" ? 1 : 2)] |= CardIndex::maskOf(static_cast<int>(id));
+    }
+    if (header.solutionMask & ~allCards) {
+        throw std::runtime_error("Corrupt saved game: " + path);
+    }
+    for (uint64_t category : categories) {
+        if (__builtin_popcountll(header.solutionMask & category) != 1) {
+            throw std::runtime_error("Corrupt saved game: " + path);
+        }
+    }
+    session->solutionMask = header.solutionMask;
+    const SnapshotPlayer* players = reinterpret_cast<const SnapshotPlayer*>(base + header.players.offset);
+    for (int p = 0; p < numPlayers; ++p) {
+        if (players[p].handMask & ~allCards) {
+            throw std::runtime_error("Corrupt saved game: " + path);
+        }
+        Player player;
+        player.name = text(players[p].name);
+        player.character = text(players[p].character);
+        player.handMask = players[p].handMask;
+        for (uint64_t rest = player.handMask; rest; rest &= rest - 1) {
+            player.hand.push_back(session->cards.cards[__builtin_ctzll(rest)].name);
+        }
+        player.row = players[p].row;
+        player.col = players[p].col;
+        player.eliminated = players[p].eliminated != 0;
+        player.isBot = players[p].isBot != 0;
+        if (player.row < 0 || player.row >= session->board->rows || player.col < 0 || player.col >= session->board->cols) {
+            throw std::runtime_error("Corrupt saved game: " + path);
+        }
+        session->players.push_back(player);
+    }
+    session->muted = true;
+    session->startGame();
+
+    // Then put back what play had changed since the deal
+    const SnapshotNotes* notes = reinterpret_cast<const SnapshotNotes*>(base + header.notes.offset);
+    const uint64_t* has = reinterpret_cast<const uint64_t*>(base + header.has.offset);
+    const uint64_t* hasNot = reinterpret_cast<const uint64_t*>(base + header.hasNot.offset);
+    const SnapshotClause* clauses = reinterpret_cast<const SnapshotClause*>(base + header.clauses.offset);
+    const uint64_t* ruledOut = reinterpret_cast<const uint64_t*>(base + header.ruledOut.offset);
+    for (int p = 0; p < numPlayers; ++p) {
+        // Compared without adding offset and count, which a crafted file could overflow
+        const SnapshotSpan& ownClauses = notes[p].clauses;
+        const SnapshotSpan& ownRuledOut = notes[p].ruledOut;
+        if (ownClauses.offset > header.clauses.count || ownClauses.count > header.clauses.count - ownClauses.offset
+            || ownRuledOut.offset > header.ruledOut.count || ownRuledOut.count > header.ruledOut.count - ownRuledOut.offset) {
+            throw std::runtime_error("Corrupt saved game: " + path);
+        }
+        Checklist& checklist = session->checklists[p];
+        Deduction& deduction = checklist.deduction;
+        deduction.has.assign(has + p * (numPlayers + 1), has + (p + 1) * (numPlayers + 1));
+        deduction.hasNot.assign(hasNot + p * (numPlayers + 1), hasNot + (p + 1) * (numPlayers + 1));
+        deduction.clauses.clear();
+        for (uint64_t c = notes[p].clauses.offset; c < notes[p].clauses.offset + notes[p].clauses.count; ++c) {
+            // Clause players index has and hasNot, whose last column is the envelope
+            if (clauses[c].player < 0 || clauses[c].player > numPlayers) {
+                throw std::runtime_error("Corrupt saved game: " + path);
+            }
+            deduction.clauses.push_back(std::make_pair(static_cast<int>(clauses[c].player), clauses[c].cards));
+        }
+        deduction.consistent = notes[p].consistent != 0;
+        checklist.ruledOutSolutions.assign(ruledOut + notes[p].ruledOut.offset, ruledOut + notes[p].ruledOut.offset + notes[p].ruledOut.count);
+        checklist.oddsStale = true;
+        checklist.revision++;
+    }
+    session->current = header.current;
+    session->winnerIndex = header.winnerIndex;
+    session->turnsPlayed = header.turnsPlayed;
+    session->takeMessages();
+    savedAssetPaths.swap(assets); // Its images stay where they were rendered, whatever imageRoot is now
+    session->muted = false;
+
+    std::string record = text(header.recordPath);
+    if (!record.empty()) {
+        session->recorder.reset(new GameRecorder());
+        if (!session->recorder->open(record, true)) {
+            std::cerr << "Cannot continue the game record " << record << ", playing without a record." << std::endl;
+            session->recorder.reset();
+        }
+    }
+    session->resumeTurn();
+    return session;
+}
+
+BoardRenderer boardRenderer;
+int numBots = 0; // The last numBots players are bots
+double accusationThreshold = 0.9; // Bots accuse once the likeliest solution is at least this probable
+SolutionSolver solutionSolver;
+uint64_t gameSeed = 0; // Seed for the deal and the bots, from --seed
+bool haveGameSeed = false; // Otherwise each game draws its own
+std::string recordPath; // Where the game's record goes; empty for games/game-<seed>.cluerec
+std::string savePath; // Where the game is saved after every turn; empty for games/game-<seed>.cluesave
+
+// Callback function to write the response data
+size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
+    size_t totalSize = size * nmemb;
+    output->append((char*)contents, totalSize);
+    return totalSize;
+}
+
+// Function to hash bytes with 64-bit FNV-1a, continuing from a previous hash
+inline uint64_t fnv1a64(const void* bytes, size_t size, uint64_t hash = 14695981039346656037ULL) {
+    const unsigned char* at = static_cast<const unsigned char*>(bytes);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= at[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Set by SIGINT or SIGTERM while a theme is being generated: the job in flight is stopped and
+// setup ends, to be resumed from the asset manifest next time
+volatile std::sig_atomic_t cancelRequested = 0;
+
+// Function to end setup with an exception once it has been cancelled
+void checkCancelled() {
+    if (cancelRequested) {
+        throw std::runtime_error("Setup cancelled. Start clue again and leave the theme blank to resume it.");
+    }
+}
+
+// Routes SIGINT and SIGTERM to cancelRequested while in scope. A second signal exits at once.
+struct SetupCancellation {
+    struct sigaction previousInterrupt;
+    struct sigaction previousTerminate;
+
+    SetupCancellation() {
+        cancelRequested = 0;
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = requestCancel;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, &previousInterrupt);
+        sigaction(SIGTERM, &action, &previousTerminate);
+    }
+
+    ~SetupCancellation() {
+        sigaction(SIGINT, &previousInterrupt, nullptr);
+        sigaction(SIGTERM, &previousTerminate, nullptr);
+    }
+
+    static void requestCancel(int) {
+        if (cancelRequested) {
+            _exit(130);
+        }
+        cancelRequested = 1;
+    }
+};
+
+// Asset job manifest: every LLM and render job of a theme's setup, journaled to the manifest file
+// in the image directory, so a setup that was killed or cancelled resumes where it stopped. The
+// first line names the theme; each other line is one state change of a job (running, done,
+// failed, timed out or cancelled) with a hash of the job's parameters and its output: the LLM's
+// answer, or the image path. The last line for a job wins. A done job is reused only while its
+// parameters hash the same and, for images, the file is still there.
+class AssetManifest {
+public:
+    std::string theme; // The setup the manifest belongs to, "" if there is none
+
+    // Function to read a manifest, remembering its path for updates
+    void open(const std::string& manifestPath) {
+        path = manifestPath;
+        theme.clear();
+        jobs.clear();
+        complete = false;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::vector<std::string> fields;
+            std::stringstream columns(line);
+            std::string field;
+            while (std::getline(columns, field, '\t')) {
+                fields.push_back(field);
+            }
+            if (fields.size() == 2 && fields[0] == "theme") {
+                theme = fields[1];
+            } else if (fields.size() == 1 && fields[0] == "complete") {
+                complete = true;
+            } else if (fields.size() >= 3) {
+                Job& job = jobs[fields[0]];
+                job.state = fields[1];
+                job.hash = std::strtoull(fields[2].c_str(), nullptr, 16);
+                job.output = fields.size() > 3 ? fields[3] : "";
+            }
+        }
+    }
+
+    // Whether the manifest holds a setup that did not finish
+    bool unfinished() const {
+        return !theme.empty() && !complete;
+    }
+
+    // Function to count the jobs that are done
+    size_t doneJobs() const {
+        size_t done = 0;
+        for (const auto& job : jobs) {
+            done += job.second.state == "done";
+        }
+        return done;
+    }
+
+    // Function to start the setup of a theme: an unfinished setup of the same theme carries on,
+    // anything else starts an empty manifest
+    void begin(const std::string& setupTheme) {
+        if (path.empty() || (setupTheme == theme && !complete)) {
+            return;
+        }
+        theme = setupTheme;
+        jobs.clear();
+        complete = false;
+        createDirectory(path.substr(0, path.find_last_of('/') + 1));
+        std::ofstream(path, std::ios::trunc) << "theme\t" << clean(theme) << "\n";
+    }
+
+    // Function to mark the whole setup finished
+    void finish() {
+        if (!path.empty() && !theme.empty() && !complete) {
+            complete = true;
+            std::ofstream(path, std::ios::app) << "complete\n";
+        }
+    }
+
+    // Function to get the output of a job done with these parameters, or "" if it has to run
+    std::string output(const std::string& id, const std::string& params) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto job = jobs.find(id);
+        if (job == jobs.end() || job->second.state != "done" || job->second.hash != fnv1a64(params.data(), params.size())) {
+            return "";
+        }
+        return job->second.output;
+    }
+
+    // Function to record a job's new state. Only jobs of the current setup are recorded.
+    void update(const std::string& id, const std::string& state, const std::string& params, const std::string& jobOutput = "") {
+        std::lock_guard<std::mutex> lock(mutex); // Renders finish on worker threads
+        if (path.empty() || theme.empty()) {
+            return;
+        }
+        Job& job = jobs[id];
+        job.state = state;
+        job.hash = fnv1a64(params.data(), params.size());
+        job.output = clean(jobOutput);
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(job.hash));
+        std::ofstream(path, std::ios::app) << clean(id) << "\t" << state << "\t" << hash << "\t" << job.output << "\n";
+    }
+
+private:
+    struct Job {
+        std::string state;
+        uint64_t hash = 0;
+        std::string output;
+    };
+
+    std::string path;
+    std::map<std::string, Job> jobs;
+    bool complete = false;
+    mutable std::mutex mutex;
+
+    // Function to keep tabs and newlines out of a field
+    static std::string clean(std::string text) {
+        std::replace(text.begin(), text.end(), '\t', ' ');
+        std::replace(text.begin(), text.end(), '\n', ' ');
+        return text;
+    }
+};
+
+AssetManifest assetManifest;
+
+// Live view of a theme's setup on the terminal: a heading and one line per LLM call and render in
+// flight, below the setup's log. While it is shown, std::cout and std::cerr write through it, so
+// log lines scroll above the job lines instead of through them. A thread of its own redraws the
+// job lines at most five times a second, and only when they changed.
+class SetupDashboard {
+public:
+    bool enabled = true; // Cleared by --no-dashboard
+
+    ~SetupDashboard() {
+        stop();
+    }
+
+    // Function to start showing the dashboard, if standard output is a terminal that can take it
+    void start(const std::string& title) {
+        const char* term = getenv("TERM");
+        if (!enabled || active || !isatty(STDOUT_FILENO) || (term != nullptr && std::string(term) == "dumb")) {
+            return;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        heading = title;
+        jobs.clear();
+        finished = 0;
+        shown.clear();
+        drawnLines = 0;
+        stopping = false;
+        active = true;
+        outBuf.reset(new LogBuf(*this, STDOUT_FILENO));
+        errBuf.reset(new LogBuf(*this, STDERR_FILENO));
+        savedOut = std::cout.rdbuf(outBuf.get());
+        savedErr = std::cerr.rdbuf(errBuf.get());
+        painter = std::thread(&SetupDashboard::paint, this);
+    }
+
+    // Function to take the job lines off the screen and give the streams back
+    void stop() {
+        if (!active) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        painter.join();
+        std::cout.rdbuf(savedOut);
+        std::cerr.rdbuf(savedErr);
+        std::lock_guard<std::mutex> lock(mutex);
+        erase();
+        for (LogBuf* buf : {outBuf.get(), errBuf.get()}) {
+            if (!buf->pending.empty()) {
+                writeAll(buf->fd, buf->pending + "\n");
+            }
+        }
+        active = false;
+    }
+
+    // Function to add a job line; returns its id for update() and remove(), or -1 if not shown
+    int add(const std::string& label, const std::string& state) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!active) {
+            return -1;
+        }
+        Job& job = jobs[nextId];
+        job.label = label;
+        job.state = state;
+        job.started = std::chrono::steady_clock::now();
+        return nextId++;
+    }
+
+    // Function to change a job's state, with its step progress if it has any
+    void update(int id, const std::string& state, int step = 0, int steps = 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto job = jobs.find(id);
+        if (job != jobs.end()) {
+            job->second.state = state;
+            job->second.step = step;
+            job->second.steps = steps;
+        }
+    }
+
+    // Function to drop a finished job's line
+    void remove(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished += jobs.erase(id);
+    }
+
+private:
+    struct Job {
+        std::string label;
+        std::string state;
+        int step = 0;
+        int steps = 0;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    // Stream buffer that hands whole lines to the dashboard, which prints them above the job lines
+    struct LogBuf : public std::streambuf {
+        SetupDashboard& view;
+        int fd;
+        std::string pending; // Text after the last newline, guarded by the dashboard's mutex
+
+        LogBuf(SetupDashboard& view, int fd) : view(view), fd(fd) {}
+
+        int overflow(int c) override {
+            if (c != EOF) {
+                char byte = static_cast<char>(c);
+                view.log(*this, &byte, 1);
+            }
+            return c;
+        }
+
+        std::streamsize xsputn(const char* text, std::streamsize length) override {
+            view.log(*this, text, length);
+            return length;
+        }
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread painter;
+    bool active = false;
+    bool stopping = false;
+    std::string heading;
+    std::map<int, Job> jobs; // In the order they started
+    int nextId = 0;
+    size_t finished = 0;
+    std::string shown; // The job lines as last drawn
+    int drawnLines = 0;
+    std::chrono::steady_clock::time_point lastDraw;
+    std::unique_ptr<LogBuf> outBuf;
+    std::unique_ptr<LogBuf> errBuf;
+    std::streambuf* savedOut = nullptr;
+    std::streambuf* savedErr = nullptr;
+
+    static void writeAll(int fd, const std::string& bytes) {
+        size_t written = 0;
+        while (written < bytes.size()) {
+            ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return;
+            }
+            written += static_cast<size_t>(n);
+        }
+    }
+
+    // Function to print the complete lines written to a stream above the job lines
+    void log(LogBuf& buf, const char* text, std::streamsize length) {
+        std::lock_guard<std::mutex> lock(mutex);
+        buf.pending.append(text, static_cast<size_t>(length));
+        size_t end = buf.pending.rfind('\n');
+        if (end == std::string::npos) {
+            return;
+        }
+        erase();
+        writeAll(buf.fd, buf.pending.substr(0, end + 1));
+        buf.pending.erase(0, end + 1);
+        if (std::chrono::steady_clock::now() - lastDraw >= std::chrono::milliseconds(200)) {
+            int lineCount;
+            std::string frame = compose(lineCount);
+            draw(frame, lineCount); // Put the job lines back under the log; otherwise the painter will
+        }
+    }
+
+    // Function to clear the job lines drawn last, leaving the cursor where the first one was
+    void erase() {
+        if (drawnLines > 0) {
+            writeAll(STDOUT_FILENO, "\x1b[" + std::to_string(drawnLines) + "F\x1b[J");
+            drawnLines = 0;
+        }
+    }
+
+    // Function to lay out the heading and job lines, cut to the terminal width so none of them wrap
+    std::string compose(int& lineCount) const {
+        struct winsize size;
+        size_t width = ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 1 ? size.ws_col - 1 : 79;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::vector<std::string> lines;
+        lines.push_back("Setup: " + heading + " | " + std::to_string(finished) + " done, " + std::to_string(jobs.size()) + " in flight");
+        for (const auto& entry : jobs) {
+            const Job& job = entry.second;
+            std::string line = "  " + job.label;
+            line.resize(std::max<size_t>(line.size() + 1, 36), ' ');
+            if (job.steps > 0) {
+                int filled = std::min(10, 10 * job.step / job.steps);
+                line += "[" + std::string(filled, '#') + std::string(10 - filled, '.') + "] " + std::to_string(job.step) + "/" + std::to_string(job.steps) + " ";
+            }
+            line += job.state + " " + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(now - job.started).count()) + "s";
+            lines.push_back(line);
+        }
+        std::string frame;
+        for (std::string& line : lines) {
+            if (line.size() > width) {
+                size_t cut = width;
+                while (cut > 0 && (static_cast<unsigned char>(line[cut]) & 0xC0) == 0x80) {
+                    cut--; // Do not split a UTF-8 character
+                }
+                line.resize(cut);
+            }
+            frame += line + "\n";
+        }
+        lineCount = static_cast<int>(lines.size());
+        return frame;
+    }
+
+    // Function to replace the job lines on the screen with a new frame in a single write
+    void draw(const std::string& frame, int lineCount) {
+        std::string bytes = drawnLines > 0 ? "\x1b[" + std::to_string(drawnLines) + "F\x1b[J" : "";
+        writeAll(STDOUT_FILENO, bytes + frame);
+        shown = frame;
+        drawnLines = lineCount;
+        lastDraw = std::chrono::steady_clock::now();
+    }
+
+    // Painter thread: redraw every 200 ms if anything on the job lines changed
+    void paint() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, std::chrono::milliseconds(200), [this]() { return stopping; })) {
+            int lineCount;
+            std::string frame = compose(lineCount);
+            if (frame != shown || drawnLines == 0) {
+                draw(frame, lineCount);
+            }
+        }
+    }
+};
+
+SetupDashboard setupDashboard;
+
+// LLM backends: one or more OpenAI-compatible chat servers, such as several llama.cpp instances,
+// listed in llm_backends.conf (or the file given with --llm-config). Each request goes to the
+// healthy backend with the fewest requests in flight, breaking ties by recent latency, and moves
+// on to the next backend if it fails or times out. A backend that fails failure_threshold times
+// in a row has its circuit opened: it gets no requests for open_seconds, then one trial request
+// (or a passing health check) decides whether it closes again. A background thread checks every
+// backend's health endpoint every health_interval seconds.
+struct LlmBackend {
+    enum Circuit { Closed, Open, HalfOpen };
+
+    std::string url; // Chat completions endpoint
+    std::string model;
+    std::string healthUrl;
+    int outstanding = 0;
+    bool healthy = true;
+    Circuit circuit = Closed;
+    int consecutiveFailures = 0;
+    std::chrono::steady_clock::time_point openUntil;
+    long long requests = 0;
+    long long failures = 0;
+    long long timeouts = 0;
+    long long circuitOpens = 0;
+    long long healthFailures = 0;
+    double latencyEwmaMs = 0; // 0 until the first success, so new backends get tried
+    std::vector<double> latenciesMs; // The last latencySamples successes
+    size_t latencyNext = 0;
+};
+
+class LlmRouter {
+public:
+    std::string logPath; // Routing decisions as JSON lines, from --llm-log
+
+    ~LlmRouter() {
+        std::unique_ptr<std::thread> checker;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            checker.swap(healthThread);
+        }
+        wake.notify_all();
+        if (checker) {
+            checker->join();
+        }
+    }
+
+    // Function to read the backend list and settings. Throws if the file cannot be read or has
+    // no backends.
+    void load(const std::string& path) {
+        std::ifstream file(path);
+        if (!file) {
+            throw std::runtime_error("Could not open LLM config " + path + ".");
+        }
+        std::vector<LlmBackend> loaded;
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            std::istringstream words(line.substr(0, line.find('#')));
+            std::string key;
+            if (!(words >> key)) {
+                continue;
+            }
+            if (key == "backend") {
+                LlmBackend backend;
+                std::string word;
+                while (words >> word) {
+                    if (word.compare(0, 7, "health=") == 0) {
+                        backend.healthUrl = word.substr(7);
+                    } else if (backend.url.empty()) {
+                        backend.url = word;
+                    } else {
+                        backend.model = word;
+                    }
+                }
+                if (backend.url.empty()) {
+                    throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": backend needs a URL.");
+                }
+                loaded.push_back(configured(backend));
+                continue;
+            }
+            double value;
+            if (!(words >> value) || value < 0) {
+                throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": " + key + " needs a number.");
+            }
+            if (key == "timeout") {
+                timeoutSeconds = value;
+            } else if (key == "connect_timeout") {
+                connectSeconds = value;
+            } else if (key == "health_interval") {
+                healthInterval = value;
+            } else if (key == "failure_threshold") {
+                failureThreshold = std::max(1, static_cast<int>(value));
+            } else if (key == "open_seconds") {
+                openSeconds = value;
+            } else {
+                throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": unknown setting " + key + ".");
+            }
+        }
+        if (loaded.empty()) {
+            throw std::runtime_error(path + " lists no backends.");
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        backends.swap(loaded);
+    }
+
+    // Function to send a chat request, trying each backend at most once. Returns the raw response
+    // body; throws if every backend failed or had its circuit open.
+    std::string chat(const std::string& prompt, double temperature) {
+        start();
+        std::vector<bool> tried(backends.size(), false);
+        std::string lastError;
+        for (size_t attempt = 0; attempt < backends.size(); ++attempt) {
+            int chosen;
+            std::string url;
+            std::string model;
+            int outstanding;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                chosen = pick(tried);
+                if (chosen < 0) {
+                    break;
+                }
+                LlmBackend& backend = backends[chosen];
+                tried[chosen] = true;
+                outstanding = backend.outstanding++;
+                url = backend.url;
+                model = backend.model;
+            }
+
+            // Prepare the JSON payload
+            std::string data = R"({"model": ")" + model + R"(", "messages": [{"role": "system", "content": "You are a helpful assistant."}, {"role": "user", "content": ")" + prompt + R"("}], "temperature": )" + std::to_string(temperature) + R"(})";
+            std::string response;
+            std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+            std::string error = request(url, &data, response, timeoutSeconds);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count();
+            finish(chosen, error, ms, outstanding, attempt);
+            if (error.empty()) {
+                return response;
+            }
+            if (error == "cancelled") {
+                throw std::runtime_error("LLM request cancelled.");
+            }
+            std::cerr << "LLM backend " << url << " failed: " << error << std::endl;
+            lastError = error;
+        }
+        throw std::runtime_error(lastError.empty() ? "No LLM backend available: every circuit is open."
+                                                   : "All LLM backends failed, last error: " + lastError);
+    }
+
+    // Function to print each backend's traffic, failures, circuit and latency
+    void printStats(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        static const char* circuits[3] = {"closed", "open", "half-open"};
+        for (const LlmBackend& backend : backends) {
+            std::vector<double> sorted = backend.latenciesMs;
+            std::sort(sorted.begin(), sorted.end());
+            out << "LLM backend " << backend.url << " | Requests: " << backend.requests << " | Failed: " << backend.failures
+                << " | Timed out: " << backend.timeouts << " | Circuit: " << circuits[backend.circuit] << " (opened " << backend.circuitOpens
+                << " times) | Health: " << (backend.healthy ? "up" : "down") << " (" << backend.healthFailures << " failed checks)";
+            if (!sorted.empty()) {
+                out << " | Latency p50 " << sorted[sorted.size() / 2] << " ms, p99 " << sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)] << " ms";
+            }
+            out << std::endl;
+        }
+    }
+
+private:
+    static const size_t latencySamples = 1024;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<LlmBackend> backends;
+    std::unique_ptr<std::thread> healthThread;
+    bool stopping = false;
+    double timeoutSeconds = 120;
+    double connectSeconds = 5;
+    double healthInterval = 10;
+    int failureThreshold = 3;
+    double openSeconds = 30;
+    bool curlReady = false;
+    bool forkHandlersSet = false;
+    std::ofstream log;
+
+    // Function to fill in a backend's defaults: the chat path on a bare /v1 URL, the model, and
+    // llama.cpp's /health on the same host
+    static LlmBackend configured(LlmBackend backend) {
+        const std::string chatPath = "/chat/completions";
+        if (backend.url.size() < chatPath.size() || backend.url.compare(backend.url.size() - chatPath.size(), chatPath.size(), chatPath) != 0) {
+            backend.url += chatPath;
+        }
+        if (backend.model.empty()) {
+            backend.model = "llama-3.2-3b-it-q8_0";
+        }
+        if (backend.healthUrl.empty()) {
+            size_t hostStart = backend.url.find("://");
+            size_t pathStart = backend.url.find('/', hostStart == std::string::npos ? 0 : hostStart + 3);
+            backend.healthUrl = backend.url.substr(0, pathStart) + "/health";
+        }
+        return backend;
+    }
+
+    // Function to load the default config on first use and start the health checks. Without a
+    // config file there is one backend, the local llama.cpp server.
+    void start() {
+        bool haveBackends;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            haveBackends = !backends.empty();
+        }
+        struct stat info;
+        if (!haveBackends && stat("llm_backends.conf", &info) == 0) {
+            load("llm_backends.conf");
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (backends.empty()) {
+            LlmBackend backend;
+            backend.url = "http://localhost:9090/v1";
+            backends.push_back(configured(backend));
+        }
+        if (!curlReady) {
+            curl_global_init(CURL_GLOBAL_DEFAULT);
+            curlReady = true;
+        }
+        if (!healthThread && healthInterval > 0 && !stopping) {
+            if (!forkHandlersSet) {
+                pthread_atfork(beforeFork, afterForkInParent, afterForkInChild);
+                forkHandlersSet = true;
+            }
+            healthThread.reset(new std::thread(&LlmRouter::checkHealth, this));
+        }
+    }
+
+    // Fork handlers, so a forked process (the theme pool's refill) gets the router unlocked and
+    // starts health checks of its own: the thread doing them is not copied into the child
+    static void beforeFork();
+    static void afterForkInParent();
+    static void afterForkInChild();
+
+    // Function to choose the next backend for a request, or -1 if none will take one. Must be
+    // called with the mutex held.
+    int pick(const std::vector<bool>& tried) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        int best = -1;
+        for (int pass = 0; pass < 2 && best < 0; ++pass) { // Backends failing health checks last
+            for (size_t b = 0; b < backends.size(); ++b) {
+                LlmBackend& backend = backends[b];
+                if (tried[b] || (pass == 0 && !backend.healthy)) {
+                    continue;
+                }
+                if (backend.circuit == LlmBackend::Open && now >= backend.openUntil) {
+                    backend.circuit = LlmBackend::HalfOpen;
+                }
+                if (backend.circuit == LlmBackend::Open || (backend.circuit == LlmBackend::HalfOpen && backend.outstanding > 0)) {
+                    continue; // Open, or its one trial request is already in flight
+                }
+                if (best < 0 || backend.outstanding < backends[best].outstanding
+                    || (backend.outstanding == backends[best].outstanding && backend.latencyEwmaMs < backends[best].latencyEwmaMs)) {
+                    best = static_cast<int>(b);
+                }
+            }
+        }
+        return best;
+    }
+
+    // Function to account for a finished request: latency, failure counts and the circuit
+    void finish(int chosen, const std::string& error, double ms, int outstanding, size_t attempt) {
+        std::lock_guard<std::mutex> lock(mutex);
+        LlmBackend& backend = backends[chosen];
+        backend.outstanding--;
+        if (error == "cancelled") {
+            return; // Says nothing about the backend
+        }
+        backend.requests++;
+        if (error.empty()) {
+            backend.consecutiveFailures = 0;
+            backend.circuit = LlmBackend::Closed;
+            backend.latencyEwmaMs = backend.latencyEwmaMs == 0 ? ms : backend.latencyEwmaMs * 0.8 + ms * 0.2;
+            if (backend.latenciesMs.size() < latencySamples) {
+                backend.latenciesMs.push_back(ms);
+            } else {
+                backend.latenciesMs[backend.latencyNext] = ms;
+            }
+            backend.latencyNext = (backend.latencyNext + 1) % latencySamples;
+        } else {
+            backend.failures++;
+            backend.timeouts += error == "timed out";
+            backend.consecutiveFailures++;
+            if (backend.circuit == LlmBackend::HalfOpen || (backend.circuit == LlmBackend::Closed && backend.consecutiveFailures >= failureThreshold)) {
+                backend.circuit = LlmBackend::Open;
+                backend.openUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<long long>(openSeconds * 1000));
+                backend.circuitOpens++;
+                std::cerr << "LLM backend " << backend.url << " circuit opened for " << openSeconds << " s." << std::endl;
+            }
+        }
+        if (!logPath.empty()) {
+            if (!log.is_open()) {
+                log.open(logPath, std::ios::app);
+            }
+            static const char* circuits[3] = {"closed", "open", "half-open"};
+            log << "{\"time_ms\":" << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+                << ",\"backend\":\"" << backend.url << "\",\"attempt\":" << attempt << ",\"outstanding\":" << outstanding
+                << ",\"status\":\"" << (error.empty() ? "ok" : error) << "\",\"latency_ms\":" << ms << ",\"circuit\":\"" << circuits[backend.circuit] << "\"}" << std::endl;
+        }
+    }
+
+    // Progress callback that aborts a transfer once setup is cancelled
+    static int cancelTransfer(void*, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        return cancelRequested ? 1 : 0;
+    }
+
+    // Function to make one HTTP request, a POST of *data or a GET if it is null. Returns "" on a
+    // 2xx response, otherwise what went wrong.
+    std::string request(const std::string& url, const std::string* data, std::string& response, double seconds) {
+        CURL* curl = curl_easy_init();
+        if (!curl) {
+            return "curl_easy_init() failed";
+        }
+        struct curl_slist* headers = NULL;
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L); // Timeouts without signals, for the health thread
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(seconds * 1000));
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(std::min(seconds, connectSeconds) * 1000));
+        if (data) {
+            curl_easy_setopt(curl, CURLOPT_POST, 1L);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data->c_str());
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data->length());
+            headers = curl_slist_append(headers, "Content-Type: application/json");
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        }
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, cancelTransfer);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        CURLcode res = curl_easy_perform(curl);
+        long status = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        curl_easy_cleanup(curl);
+        curl_slist_free_all(headers);
+        if (res == CURLE_OPERATION_TIMEDOUT) {
+            return "timed out";
+        }
+        if (res == CURLE_ABORTED_BY_CALLBACK) {
+            return "cancelled";
+        }
+        if (res != CURLE_OK) {
+            return curl_easy_strerror(res);
+        }
+        if (status < 200 || status >= 300) {
+            return "HTTP " + std::to_string(status);
+        }
+        return "";
+    }
+
+    // Function run by the health thread: probe every backend each interval. A backend is up if
+    // it answers below 500 (one without a health endpoint answers 404); llama.cpp answers 503
+    // while it loads a model. A passing check lets an open circuit take its trial request.
+    void checkHealth() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            for (size_t b = 0; b < backends.size() && !stopping; ++b) {
+                std::string url = backends[b].healthUrl;
+                lock.unlock();
+                std::string body;
+                std::string error = request(url, nullptr, body, std::min(2.0, healthInterval));
+                bool up = error.empty() || (error.compare(0, 5, "HTTP ") == 0 && std::atoi(error.c_str() + 5) < 500);
+                lock.lock();
+                LlmBackend& backend = backends[b];
+                if (!up) {
+                    backend.healthFailures++;
+                } else if (backend.circuit == LlmBackend::Open) {
+                    backend.openUntil = std::chrono::steady_clock::now();
+                }
+                backend.healthy = up;
+            }
+            wake.wait_for(lock, std::chrono::milliseconds(static_cast<long long>(healthInterval * 1000)));
+        }
+    }
+};
+
+LlmRouter llmRouter;
+
+void LlmRouter::beforeFork() {
+    llmRouter.mutex.lock();
+}
+
+void LlmRouter::afterForkInParent() {
+    llmRouter.mutex.unlock();
+}
+
+void LlmRouter::afterForkInChild() {
+    llmRouter.healthThread.release(); // Only the parent may join it
+    llmRouter.mutex.unlock();
+}
+
+// Function to make a request to the LLM API, showing it on the setup dashboard as the given job
+std::string getLLMResponse(const std::string& prompt, double temperature, const std::string& job) {
+    int line = setupDashboard.add("LLM " + job, "waiting");
+    try {
+        std::string response = llmRouter.chat(prompt, temperature);
+        setupDashboard.remove(line);
+        return response;
+    } catch (...) {
+        setupDashboard.remove(line);
+        throw;
+    }
+}
+
+// Theme bank: every card list and description the LLM produced that passed validation, kept by
+// theme so a later game with the same or a close enough theme can skip the LLM. On disk it is an
+// append-only log of length-prefixed records that several games may add to at once; in memory a
+// hash index on the normalized theme answers exact lookups, a sorted key list answers prefixes
+// ("pirate" finds "pirate ship") and trigram posting lists find near spellings. New records from
+// other processes are read on the next lookup.
+const char themeBankMagic[8] = {'C', 'L', 'U', 'E', 'B', 'A', 'N', 'K'};
+
+class ThemeBank {
+public:
+    enum CardType { Character = 0, Weapon = 1, Room = 2 }; // Same numbering as theme packs
+
+    std::string directory = "theme_bank"; // Where bank.log lives
+    bool enabled = true;
+    bool verbose = true; // Print a line with the lookup time for every list served
+
+    // Which stored theme a lookup settled on, and how
+    struct Match {
+        int theme = -1;
+        const char* how = "none";
+    };
+
+    // Function to reduce a theme to its index key: lower case words of letters and digits
+    static std::string normalize(const std::string& theme) {
+        std::string key;
+        for (char c : theme) {
+            if (std::isalnum(static_cast<unsigned char>(c))) {
+                key += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            } else if (!key.empty() && key.back() != ' ') {
+                key += ' ';
+            }
+        }
+        if (!key.empty() && key.back() == ' ') {
+            key.pop_back();
+        }
+        return key;
+    }
+
+    // Function to find the stored theme closest to one asked for: exact key first, then the
+    // shortest stored key it is a prefix of, then the best trigram similarity above a threshold
+    Match find(const std::string& theme) {
+        refresh();
+        Match match;
+        std::string key = normalize(theme);
+        if (key.empty()) {
+            return match;
+        }
+        auto exact = byKey.find(key);
+        if (exact != byKey.end()) {
+            match.theme = exact->second;
+            match.how = "exact";
+            return match;
+        }
+        if (key.size() >= 3) {
+            if (!sorted) {
+                std::sort(sortedKeys.begin(), sortedKeys.end());
+                sorted = true;
+            }
+            size_t best = std::string::npos;
+            for (auto it = std::lower_bound(sortedKeys.begin(), sortedKeys.end(), std::make_pair(key, -1));
+                 it != sortedKeys.end() && it->first.compare(0, key.size(), key) == 0; ++it) {
+                if (it->first[key.size()] == ' ' && it->first.size() < best) { // Whole words only
+                    best = it->first.size();
+                    match.theme = it->second;
+                    match.how = "prefix";
+                }
+            }
+            if (match.theme >= 0) {
+                return match;
+            }
+        }
+        std::vector<uint32_t> grams = trigrams(key);
+        shared.resize(themes.size(), 0);
+        std::vector<int> touched;
+        for (uint32_t gram : grams) {
+            auto postings = byTrigram.find(gram);
+            if (postings != byTrigram.end()) {
+                for (int id : postings->second) {
+                    if (shared[id]++ == 0) {
+                        touched.push_back(id);
+                    }
+                }
+            }
+        }
+        double bestScore = minimumSimilarity;
+        for (int id : touched) {
+            // Dice coefficient over the two trigram sets
+            double score = 2.0 * shared[id] / (grams.size() + themes[id].trigramCount);
+            if (score > bestScore || (score == bestScore && id > match.theme)) {
+                bestScore = score;
+                match.theme = id;
+                match.how = "fuzzy";
+            }
+            shared[id] = 0;
+        }
+        return match;
+    }
+
+    // Function to get a stored card list for a theme, or an empty list if there is none
+    std::vector<std::string> list(const std::string& theme, CardType type) {
+        if (!enabled) {
+            return {};
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Match match = find(theme);
+        if (match.theme < 0 || themes[match.theme].lists[type].empty()) {
+            return {};
+        }
+        const std::vector<std::string>& stored = themes[match.theme].lists[type];
+        long long micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        if (verbose) {
+            static const char* typeNames[3] = {"characters", "weapons", "rooms"};
+            std::cout << "Theme bank: " << typeNames[type] << " for \"" << theme << "\" from \"" << themes[match.theme].theme
+                      << "\" (" << match.how << " match, " << micros << " us lookup)" << std::endl;
+        }
+        return stored;
+    }
+
+    // Function to get a stored description of a card under a theme, or "" if there is none
+    std::string description(const std::string& theme, CardType type, const std::string& name) {
+        if (!enabled) {
+            return "";
+        }
+        Match match = find(theme);
+        if (match.theme < 0) {
+            return "";
+        }
+        const std::map<std::string, std::string>& stored = themes[match.theme].descriptions[type];
+        auto found = stored.find(normalize(name));
+        return found == stored.end() ? "" : found->second;
+    }
+
+    void storeList(const std::string& theme, CardType type, const std::vector<std::string>& cards) {
+        if (normalize(theme).empty()) {
+            return;
+        }
+        std::string record;
+        record += static_cast<char>(ListRecord);
+        putVarint(record, type);
+        putText(record, theme);
+        putVarint(record, cards.size());
+        for (const std::string& card : cards) {
+            putText(record, card);
+        }
+        append(record);
+    }
+
+    void storeDescription(const std::string& theme, CardType type, const std::string& name, const std::string& text) {
+        if (normalize(theme).empty() || text.empty()) {
+            return;
+        }
+        std::string record;
+        record += static_cast<char>(DescriptionRecord);
+        putVarint(record, type);
+        putText(record, theme);
+        putText(record, name);
+        putText(record, text);
+        append(record);
+    }
+
+    // Function to print what the bank holds and how long lookups of every stored theme take
+    int printStats() {
+        verbose = false;
+        refresh();
+        size_t lists = 0;
+        size_t descriptions = 0;
+        for (const Entry& entry : themes) {
+            for (int type = 0; type < 3; ++type) {
+                lists += !entry.lists[type].empty();
+                descriptions += entry.descriptions[type].size();
+            }
+        }
+        std::cout << "Theme bank " << path() << ": " << themes.size() << " themes, " << lists << " card lists, "
+                  << descriptions << " descriptions, " << loadedBytes << " bytes\n";
+        if (themes.empty()) {
+            return 0;
+        }
+        std::vector<std::string> queries[3];
+        for (const Entry& entry : themes) {
+            queries[0].push_back(entry.theme);
+            queries[1].push_back(entry.key.substr(0, entry.key.find(' ')));
+            std::string misspelt = entry.key;
+            std::swap(misspelt[misspelt.size() / 2], misspelt[misspelt.size() / 2 - (misspelt.size() > 1)]);
+            queries[2].push_back(misspelt + "s");
+        }
+        static const char* kinds[3] = {"Exact", "First word", "Misspelt"};
+        for (int kind = 0; kind < 3; ++kind) {
+            std::vector<double> micros;
+            int hits = 0;
+            for (const std::string& query : queries[kind]) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                hits += find(query).theme >= 0;
+                micros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            }
+            std::sort(micros.begin(), micros.end());
+            std::cout << kinds[kind] << " lookups: " << hits << "/" << micros.size() << " found, p50 " << micros[micros.size() / 2]
+                      << " us, p99 " << micros[std::min(micros.size() - 1, micros.size() * 99 / 100)] << " us\n";
+        }
+        return 0;
+    }
+
+    size_t themeCount() {
+        refresh();
+        return themes.size();
+    }
+
+private:
+    enum RecordKind { ListRecord = 1, DescriptionRecord = 2 };
+    const double minimumSimilarity = 0.7;
+
+    struct Entry {
+        std::string theme; // As first stored
+        std::string key;
+        size_t trigramCount = 0;
+        std::vector<std::string> lists[3]; // Latest list of each card type
+        std::map<std::string, std::string> descriptions[3]; // By normalized card name
+    };
+
+    std::vector<Entry> themes;
+    std::unordered_map<std::string, int> byKey;
+    std::vector<std::pair<std::string, int>> sortedKeys;
+    bool sorted = true;
+    std::unordered_map<uint32_t, std::vector<int>> byTrigram;
+    off_t loadedBytes = 0; // How much of the log has been indexed
+    std::vector<int> shared; // Trigrams each theme shares with a query
+
+    std::string path() const {
+        return directory + "/bank.log";
+    }
+
+    // Function to list the distinct trigrams of a key, padded so word starts count too
+    static std::vector<uint32_t> trigrams(const std::string& key) {
+        std::string padded = "  " + key + " ";
+        std::vector<uint32_t> grams;
+        for (size_t i = 0; i + 3 <= padded.size(); ++i) {
+            grams.push_back(static_cast<uint8_t>(padded[i]) << 16 | static_cast<uint8_t>(padded[i + 1]) << 8 | static_cast<uint8_t>(padded[i + 2]));
+        }
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        return grams;
+    }
+
+    // Function to get the entry for a theme, adding it to every index if it is new
+    Entry& entryFor(const std::string& theme) {
+        std::string key = normalize(theme);
+        auto found = byKey.find(key);
+        if (found != byKey.end()) {
+            return themes[found->second];
+        }
+        int id = static_cast<int>(themes.size());
+        themes.emplace_back();
+        Entry& entry = themes.back();
+        entry.theme = theme;
+        entry.key = key;
+        byKey[key] = id;
+        sortedKeys.push_back(std::make_pair(key, id));
+        sorted = false;
+        std::vector<uint32_t> grams = trigrams(key);
+        entry.trigramCount = grams.size();
+        for (uint32_t gram : grams) {
+            byTrigram[gram].push_back(id);
+        }
+        return entry;
+    }
+
+    // Function to index whatever has been appended to the log since the last call. A record
+    // still being written (or cut short by a crash) is left for later.
+    void refresh() {
+        struct stat info;
+        if (!enabled || stat(path().c_str(), &info) != 0 || info.st_size <= loadedBytes) {
+            return;
+        }
+        int fd = ::open(path().c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        std::string bytes(info.st_size - loadedBytes, '\0');
+        ssize_t got = pread(fd, &bytes[0], bytes.size(), loadedBytes);
+        ::close(fd);
+        if (got <= 0) {
+            return;
+        }
+        bytes.resize(got);
+        const uint8_t* start = reinterpret_cast<const uint8_t*>(bytes.data());
+        off_t base = loadedBytes;
+        RecordReader reader(start, start + bytes.size());
+        if (base == 0) {
+            if (bytes.size() < sizeof(themeBankMagic)) {
+                return; // Still being started by another game
+            }
+            if (std::memcmp(start, themeBankMagic, sizeof(themeBankMagic)) != 0) {
+                std::cerr << path() << " is not a theme bank, ignoring it." << std::endl;
+                enabled = false;
+                return;
+            }
+            reader.at += sizeof(themeBankMagic);
+            loadedBytes = sizeof(themeBankMagic);
+        }
+        uint64_t length;
+        while (reader.varint(length) && length <= static_cast<uint64_t>(reader.end - reader.at)) {
+            const uint8_t* next = reader.at + length;
+            try {
+                RecordReader record(reader.at, next);
+                parse(record);
+            } catch (const std::exception& e) {
+                std::cerr << "Skipping a corrupt theme bank record: " << e.what() << std::endl;
+            }
+            reader.at = next;
+            loadedBytes = base + (reader.at - start);
+        }
+    }
+
+    // Function to apply one record to the indexes
+    void parse(RecordReader& record) {
+        if (record.at >= record.end) {
+            throw std::runtime_error("empty record");
+        }
+        uint8_t kind = *record.at++;
+        uint64_t type = record.number();
+        if (type > Room) {
+            throw std::runtime_error("unknown card type");
+        }
+        Entry& entry = entryFor(record.text());
+        if (kind == ListRecord) {
+            uint64_t count = record.number();
+            std::vector<std::string> cards;
+            for (uint64_t i = 0; i < count; ++i) {
+                cards.push_back(record.text());
+            }
+            entry.lists[type].swap(cards);
+        } else if (kind == DescriptionRecord) {
+            std::string name = normalize(record.text());
+            entry.descriptions[type][name] = record.text();
+        } else {
+            throw std::runtime_error("unknown record kind");
+        }
+    }
+
+    // Function to add a record to the log with one locked write, starting the log if needed
+    void append(const std::string& record) {
+        if (!enabled) {
+            return;
+        }
+        createDirectory(directory);
+        int fd = ::open(path().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cerr << "Could not open " << path() << std::endl;
+            return;
+        }
+        flock(fd, LOCK_EX);
+        std::string bytes;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size == 0) {
+            bytes.assign(themeBankMagic, sizeof(themeBankMagic));
+        }
+        putVarint(bytes, record.size());
+        bytes += record;
+        if (write(fd, bytes.data(), bytes.size()) != static_cast<ssize_t>(bytes.size())) {
+            std::cerr << "Could not write to " << path() << std::endl;
+        }
+        ::close(fd); // Releases the lock
+    }
+};
+
+ThemeBank themeBank;
+
+// Function to join a card list for the asset manifest
+std::string joinList(const std::vector<std::string>& cards) {
+    std::string joined;
+    for (const std::string& card : cards) {
+        joined += (joined.empty() ? "" : ",") + card;
+    }
+    return joined;
+}
+
+// Function to get a card list without the LLM: from the manifest of an interrupted setup, or
+// from the theme bank (recording it in the manifest). Returns an empty list if neither has one.
+std::vector<std::string> resumeList(const std::string& job, const std::string& prompt, const std::string& gameTheme, ThemeBank::CardType type) {
+    std::vector<std::string> cards;
+    std::stringstream resumed(assetManifest.output(job, prompt));
+    std::string card;
+    while (std::getline(resumed, card, ',')) {
+        cards.push_back(card);
+    }
+    if (!cards.empty()) {
+        std::cout << "Resuming with the " << job << " of the interrupted setup." << std::endl;
+        return cards;
+    }
+    cards = themeBank.list(gameTheme, type);
+    if (!cards.empty()) {
+        assetManifest.update(job, "done", prompt, joinList(cards));
+    }
+    return cards;
+}
+
+// Function to get a card description for an image prompt, from the theme bank if this card was
+// described under this theme before, otherwise from the LLM (banking the answer). Returns "" if
+// the LLM response could not be read.
+std::string getDescriptionFromLLM(const std::string& prompt, const std::string& gameTheme, ThemeBank::CardType type, const std::string& name) {
+    static const char* typeNames[3] = {"character", "weapon", "room"};
+    std::string job = std::string("describe ") + typeNames[type] + " " + name;
+    checkCancelled();
+    std::string description = assetManifest.output(job, prompt);
+    if (!description.empty()) {
+        return description;
+    }
+    description = themeBank.description(gameTheme, type, name);
+    if (!description.empty()) {
+        assetManifest.update(job, "done", prompt, description);
+        return description;
+    }
+    double temperature = 1.0;
+    assetManifest.update(job, "running", prompt);
+    std::string response = getLLMResponse(prompt, temperature, job);
+
+    // Extract the content from the JSON response
+    size_t contentStart = response.find("\"content\":\"");
+    if (contentStart == std::string::npos) {
+        std::cerr << "Could not find 'content' in LLM response." << std::endl;
+        assetManifest.update(job, "failed", prompt);
+        return "";
+    }
+    contentStart += strlen("\"content\":\"");
+
+    // Look for the end of the content, allowing for variations in the closing sequence
+    size_t contentEnd = response.find("\"}]", contentStart);
+    if (contentEnd == std::string::npos) {
+        contentEnd = response.find("\"", contentStart); // Try to find the next quote
+        if (contentEnd == std::string::npos) {
+            std::cerr << "Could not find end of 'content' in LLM response." << std::endl;
+            assetManifest.update(job, "failed", prompt);
+            return "";
+        }
+    }
+
+    description = response.substr(contentStart, contentEnd - contentStart);
+
+    // Remove quotes and newlines from the description
+    description.erase(std::remove(description.begin(), description.end(), '\"'), description.end());
+    description.erase(std::remove(description.begin(), description.end(), '\n'), description.end());
+    description.erase(std::remove(description.begin(), description.end(), '\\'), description.end());
+    themeBank.storeDescription(gameTheme, type, name, description);
+    assetManifest.update(job, "done", prompt, description);
+    return description;
+}
+
+// Helper function to validate the number of items returned from the LLM
+void validateLLMResponseCount(const std::vector<std::string>& items, size_t expectedCount, const std::string& itemType) {
+    if (items.size() != expectedCount) {
+        throw std::runtime_error("LLM returned " + std::to_string(items.size()) + " " + itemType + ", but expected " + std::to_string(expectedCount));
+    }
+}
+
+// Function to get a list of rooms from the LLM
+std::vector<std::string> getRoomsFromLLM(const std::string& gameTheme) {
+    const int maxRetries = 3;
+    int retryCount = 0;
+
+    std::string prompt = "List 9 random rooms suitable for a " + gameTheme + " themed clue-like game, but not Hall, Lounge, Dining Room, Kitchen, Ballroom, Conservatory, Billiard Room, Library, or Study, separated by commas. Give me only the comma separated list, nothing else.";
+
+    // Serve the list from an interrupted setup, or from the theme bank if this theme has been generated before
+    std::vector<std::string> rooms = resumeList("rooms", prompt, gameTheme, ThemeBank::Room);
+    if (!rooms.empty()) {
+        return rooms;
+    }
+
+    assetManifest.update("rooms", "running", prompt);
+    while (retryCount < maxRetries) {
+        double temperature = 1.0;
+        std::string response = getLLMResponse(prompt, temperature, "rooms");
+
+        // Extract the content from the JSON response
+        size_t contentStart = response.find("\"content\":\"");
+        if (contentStart == std::string::npos) {
+            std::cerr << "Could not find 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+            retryCount++;
+            continue;
+        }
+        contentStart += strlen("\"content\":\"");
+
+        // Look for the end of the content, allowing for variations in the closing sequence
+        size_t contentEnd = response.find("\"}]", contentStart);
+        if (contentEnd == std::string::npos) {
+            contentEnd = response.find("\"", contentStart); // Try to find the next quote
+            if (contentEnd == std::string::npos) {
+                std::cerr << "Could not find end of 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+                retryCount++;
+                continue;
+            }
+        }
+
+        std::string content = response.substr(contentStart, contentEnd - contentStart);
+
+        rooms.clear();
+        std::stringstream ss(content);
+        std::string room;
+        while (std::getline(ss, room, ',')) {
+            // Remove leading/trailing whitespace
+            room.erase(0, room.find_first_not_of(" \t\n\r"));
+            room.erase(room.find_last_not_of(" \t\n\r") + 1);
+            rooms.push_back(room);
+        }
+
+        try {
+            validateLLMResponseCount(rooms, 9, "rooms");
+            themeBank.storeList(gameTheme, ThemeBank::Room, rooms);
+            assetManifest.update("rooms", "done", prompt, joinList(rooms));
+            // If validation succeeds, break out of the loop
+            break;
+        } catch (const std::exception& e) {
+            std::cerr << "Error validating LLM response: " << e.what() << " (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+            retryCount++;
+        }
+    }
+
+    // If max retries reached, return a default set of rooms
+    if (retryCount == maxRetries) {
+        std::cerr << "Max retries reached for getting rooms. Using default rooms." << std::endl;
+        assetManifest.update("rooms", "failed", prompt);
+        return {"Cellar", "Observatory", "Theater", "Garage", "Studio", "Pantry", "Attic", "Gazebo", "Courtyard"};
+    }
+
+    return rooms;
+}
+
+// Function to read a string or number field of a one-line JSON object, or "" if it has none
+std::string jsonField(const std::string& json, const std::string& key) {
+    size_t at = json.find("\"" + key + "\":");
+    if (at == std::string::npos) {
+        return "";
+    }
+    at += key.size() + 3;
+    std::string value;
+    if (at < json.size() && json[at] == '"') {
+        for (size_t i = at + 1; i < json.size() && json[i] != '"'; ++i) {
+            if (json[i] == '\\' && i + 1 < json.size()) {
+                ++i;
+            }
+            value += json[i];
+        }
+        return value;
+    }
+    size_t end = json.find_first_of(",}", at);
+    return json.substr(at, end == std::string::npos ? std::string::npos : end - at);
+}
+
+// Descriptor a program run by runWithDeadline() writes its progress events to
+const int progressEventFd = 3;
+
+// Function to run a program and collect its standard output, stopping it at a deadline (0 for
+// none) or when setup is cancelled. The program gets SIGTERM first, so it can cancel its own work,
+// and SIGKILL if it is still running 10 seconds later. With onEvent, each line the program writes
+// to descriptor progressEventFd is passed to it as it arrives. Returns "done", "failed" (a
+// non-zero exit), "timed out" or "cancelled".
+std::string runWithDeadline(const std::vector<std::string>& args, double seconds, std::string& output, const std::function<void(const std::string&)>& onEvent = nullptr) {
+    int pipeFds[2];
+    int eventFds[2] = {-1, -1};
+    if (pipe2(pipeFds, O_CLOEXEC) != 0) {
+        return "failed";
+    }
+    if (onEvent && pipe2(eventFds, O_CLOEXEC) != 0) {
+        ::close(pipeFds[0]);
+        ::close(pipeFds[1]);
+        return "failed";
+    }
+    std::vector<char*> argv;
+    for (const std::string& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    std::cout.flush();
+    pid_t child = fork();
+    if (child == 0) {
+        dup2(pipeFds[1], STDOUT_FILENO);
+        if (eventFds[1] == progressEventFd) {
+            fcntl(progressEventFd, F_SETFD, 0); // dup2 onto itself would leave it close-on-exec
+        } else if (eventFds[1] >= 0) {
+            dup2(eventFds[1], progressEventFd);
+        }
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    ::close(pipeFds[1]);
+    if (eventFds[1] >= 0) {
+        ::close(eventFds[1]);
+    }
+    if (child < 0) {
+        ::close(pipeFds[0]);
+        if (eventFds[0] >= 0) {
+            ::close(eventFds[0]);
+        }
+        return "failed";
+    }
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<long long>(seconds * 1000));
+    std::chrono::steady_clock::time_point stopSent;
+    std::string outcome;
+    bool killed = false;
+    bool exited = false;
+    int status = 0;
+    std::string events; // Event bytes that do not make a full line yet
+    char buffer[4096];
+    // Function to read what is waiting on a descriptor; false once the program closed it
+    auto readFrom = [&buffer](int fd, std::string& into) {
+        ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got > 0) {
+            into.append(buffer, got);
+        }
+        return got > 0 || (got < 0 && errno == EINTR);
+    };
+    auto deliverEvents = [&events, &onEvent]() {
+        size_t lineStart = 0;
+        size_t lineEnd;
+        while ((lineEnd = events.find('\n', lineStart)) != std::string::npos) {
+            onEvent(events.substr(lineStart, lineEnd - lineStart));
+            lineStart = lineEnd + 1;
+        }
+        events.erase(0, lineStart);
+    };
+    pollfd readable[2] = {{pipeFds[0], POLLIN, 0}, {eventFds[0], POLLIN, 0}}; // Negative descriptors are skipped
+    while (!exited) {
+        if (poll(readable, 2, 100) > 0) {
+            if (readable[1].revents != 0 && !readFrom(readable[1].fd, events)) {
+                readable[1].fd = -1;
+            }
+            if (readable[0].revents != 0 && !readFrom(readable[0].fd, output)) {
+                break; // The program closed its output
+            }
+            deliverEvents();
+        }
+        // Something it started may hold the pipe open after it exits, so check on it directly
+        exited = waitpid(child, &status, WNOHANG) == child;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (outcome.empty() && (cancelRequested || (seconds > 0 && now >= deadline))) {
+            outcome = cancelRequested ? "cancelled" : "timed out";
+            kill(child, SIGTERM);
+            stopSent = now;
+        } else if (!outcome.empty() && !killed && now - stopSent >= std::chrono::seconds(10)) {
+            kill(child, SIGKILL);
+            killed = true;
+        }
+    }
+    // Take what it wrote just before exiting, without waiting on anything it left running
+    for (int i = 0; i < 2; ++i) {
+        pollfd waiting = {readable[i].fd, POLLIN, 0};
+        while (readable[i].fd >= 0 && poll(&waiting, 1, 0) > 0 && readFrom(waiting.fd, i == 0 ? output : events)) {
+        }
+    }
+    if (onEvent) {
+        deliverEvents();
+        ::close(eventFds[0]);
+    }
+    ::close(pipeFds[0]);
+    while (!exited && waitpid(child, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (outcome.empty()) {
+        outcome = !WIFEXITED(status) ? "failed" : WEXITSTATUS(status) == 0 ? "done" : WEXITSTATUS(status) == 124 ? "timed out" : "failed"; // 124: it hit its own --timeout
+    }
+    return outcome;
+}
+
+// Function to derive a stable image seed from a description, so repeated assets hit the render cache
+unsigned int imageSeedFor(const std::string& description) {
+    unsigned int hash = 2166136261u; // FNV-1a
+    for (unsigned char c : description) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Kinds of generated assets, used to weight the render budget
+enum class AssetKind { Room, Weapon, Character };
+
+// Steps and resolution of one render
+struct RenderQuality {
+    int steps;
+    int width;
+    int height;
+};
+
+// Quality tiers from best to cheapest. Without a budget every asset renders at 25 steps, 512x512.
+const std::vector<RenderQuality> renderQualityTiers = {
+    {30, 512, 512},
+    {25, 512, 512},
+    {20, 512, 512},
+    {20, 448, 448},
+    {15, 384, 384},
+    {10, 320, 320},
+    {6, 256, 256}
+};
+
+// Scheduler that spreads a total asset-generation deadline over the remaining renders.
+// It measures the server's live throughput in megapixel-steps per second and gives each asset
+// the best tier expected to finish within its weighted share of the time left, so characters
+// get more of the budget than rooms, and rooms more than weapons.
+struct AssetBudget {
+    bool enabled = false;
+    std::chrono::steady_clock::time_point deadline;
+    double pixelStepsPerSecond = 1.0; // Prior until the first render is measured
+    double overheadSeconds = 4.0; // Process start-up and status-poll latency per render
+    double gapSeconds = 0.0; // Time spent between renders, mostly LLM description calls
+    int remaining[3] = {0, 0, 0}; // Assets left to render, indexed by AssetKind
+    bool renderedBefore = false;
+    std::chrono::steady_clock::time_point lastRenderEnd;
+    std::mutex mutex; // Renders finish on worker threads
+
+    void start(double budgetSeconds, int rooms, int weapons, int characters) {
+        enabled = true;
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<long long>(budgetSeconds * 1000));
+        remaining[static_cast<int>(AssetKind::Room)] = rooms;
+        remaining[static_cast<int>(AssetKind::Weapon)] = weapons;
+        remaining[static_cast<int>(AssetKind::Character)] = characters;
+    }
+
+    static double weight(AssetKind kind) {
+        switch (kind) {
+            case AssetKind::Character: return 1.5;
+            case AssetKind::Room: return 1.0;
+            default: return 0.6;
+        }
+    }
+
+    // Best tier each kind may use, even when time is plentiful
+    static size_t bestTier(AssetKind kind) {
+        switch (kind) {
+            case AssetKind::Character: return 0;
+            case AssetKind::Room: return 1;
+            default: return 3;
+        }
+    }
+
+    double predictSeconds(const RenderQuality& quality) const {
+        double pixelSteps = quality.steps * (quality.width * quality.height / 1e6);
+        return overheadSeconds + pixelSteps / pixelStepsPerSecond;
+    }
+
+    // Pick the quality for the next asset of this kind. Returns false if not even the cheapest
+    // tier fits in the time left, in which case the asset should fall back to an existing image.
+    bool chooseQuality(AssetKind kind, const std::string& name, RenderQuality& quality) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!enabled) {
+            quality = {25, 512, 512};
+            return true;
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (renderedBefore) {
+            double gap = std::chrono::duration<double>(now - lastRenderEnd).count();
+            gapSeconds = gapSeconds == 0.0 ? gap : 0.5 * gapSeconds + 0.5 * gap;
+        }
+
+        int& left = remaining[static_cast<int>(kind)];
+        left = std::max(left, 1);
+        double totalWeight = 0.0;
+        int assetsLeft = 0;
+        for (int k = 0; k < 3; ++k) {
+            totalWeight += remaining[k] * weight(static_cast<AssetKind>(k));
+            assetsLeft += remaining[k];
+        }
+        left--;
+
+        // Keep time for the description calls of the assets after this one
+        double timeLeft = std::chrono::duration<double>(deadline - now).count();
+        double available = timeLeft - gapSeconds * (assetsLeft - 1);
+        double slice = available * weight(kind) / totalWeight;
+
+        for (size_t tier = bestTier(kind); tier < renderQualityTiers.size(); ++tier) {
+            if (predictSeconds(renderQualityTiers[tier]) <= slice) {
+                quality = renderQualityTiers[tier];
+                std::cout << "Render budget: " << static_cast<int>(timeLeft) << "s left, " << name << " gets " << quality.steps << " steps at " << quality.width << "x" << quality.height << " (about " << static_cast<int>(predictSeconds(quality)) << "s)" << std::endl;
+                return true;
+            }
+        }
+
+        // Borrow from the later assets rather than skip this one, as long as the cheapest tier still fits
+        if (predictSeconds(renderQualityTiers.back()) <= timeLeft) {
+            quality = renderQualityTiers.back();
+            std::cout << "Render budget: " << static_cast<int>(timeLeft) << "s left, " << name << " gets the cheapest tier" << std::endl;
+            return true;
+        }
+        return false;
+    }
+
+    // Update the throughput estimate. Cache hits and failed renders say nothing about the server.
+    void recordRender(const RenderQuality& quality, double seconds, bool measured) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (measured) {
+            double pixelSteps = quality.steps * (quality.width * quality.height / 1e6);
+            double renderSeconds = std::max(0.5, seconds - overheadSeconds);
+            pixelStepsPerSecond = 0.5 * pixelStepsPerSecond + 0.5 * (pixelSteps / renderSeconds);
+        }
+        renderedBefore = true;
+        lastRenderEnd = std::chrono::steady_clock::now();
+    }
+};
+
+AssetBudget assetBudget;
+
+// Whether images are rendered as a quick preview refined in the background
+bool progressiveImages = false;
+
+// Full-quality passes of progressive renders, held back until every preview of the setup is saved:
+// the render server works through its queue in order, so a refinement submitted earlier would
+// delay every preview behind it
+std::vector<std::vector<std::string>> pendingRefinements;
+std::mutex refinementsMutex;
+
+// Function to start the held-back refinements as detached, low-priority easy_diffusion processes
+void startRefinements() {
+    std::vector<std::vector<std::string>> refinements;
+    {
+        std::lock_guard<std::mutex> lock(refinementsMutex);
+        refinements.swap(pendingRefinements);
+    }
+    for (const std::vector<std::string>& args : refinements) {
+        std::vector<char*> argv;
+        for (const std::string& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        std::cout.flush();
+        pid_t child = fork();
+        if (child == 0) {
+            // Fork again so the refinement is not this process's child, and keeps running after clue exits
+            setsid();
+            if (fork() != 0) {
+                _exit(0);
+            }
+            int devNull = ::open("/dev/null", O_RDWR);
+            dup2(devNull, STDIN_FILENO);
+            dup2(devNull, STDOUT_FILENO);
+            dup2(devNull, STDERR_FILENO);
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+        if (child > 0) {
+            while (waitpid(child, nullptr, 0) < 0 && errno == EINTR) {
+            }
+        }
+    }
+    if (!refinements.empty()) {
+        std::cout << "Refining " << refinements.size() << " images at full quality in the background." << std::endl;
+    }
+}
+
+// Seconds one render may take before it is cancelled (0 = no limit), from --render-timeout
+double renderTimeoutSeconds = 600;
+
+// Renders run at once while setup carries on with the LLM, from --render-jobs
+int renderJobs = 1;
+
+// An image the generation pipeline asked for, and the description it was rendered from
+struct GeneratedAsset {
+    AssetKind kind;
+    std::string name;
+    std::string description;
+    std::string filename;
+};
+
+std::vector<GeneratedAsset> generatedAssets; // Every image asked for since generateTheme() started
+
+// 8x8 grey PNG written for assets that ran out of render budget
+const unsigned char placeholderPng[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52,
+    0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x08, 0x08, 0x02, 0x00, 0x00, 0x00, 0x4b, 0x6d, 0x29,
+    0xdc, 0x00, 0x00, 0x00, 0x0f, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x68, 0xc0, 0x01, 0x18,
+    0x86, 0x96, 0x04, 0x00, 0x82, 0xf3, 0x60, 0x01, 0x25, 0x95, 0xb3, 0x63, 0x00, 0x00, 0x00, 0x00,
+    0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82
+};
+
+// Function to keep a previously generated image, or write a placeholder, for an asset that did not fit the budget
+void useFallbackImage(const std::string& name, const std::string& filename) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) == 0 && info.st_size > 0) {
+        std::cout << "Out of render budget for " << name << ", keeping the existing " << filename << std::endl;
+        return;
+    }
+    std::ofstream image(filename, std::ios::binary);
+    image.write(reinterpret_cast<const char*>(placeholderPng), sizeof(placeholderPng));
+    std::cout << "Out of render budget for " << name << ", wrote a placeholder to " << filename << std::endl;
+}
+
+// A render waiting for a render worker, with everything renderAssetImage() decided for it
+struct QueuedRender {
+    std::string job; // Its id in the asset manifest
+    std::string params;
+    std::string name;
+    std::string filename;
+    RenderQuality quality;
+    std::vector<std::string> args;
+    std::string command;
+    double deadlineSeconds; // 0 for none
+    std::vector<std::string> refineArgs; // The full-quality pass of a progressive render, empty otherwise
+};
+
+// Function to run a queued render on a render worker and record how it went
+void runQueuedRender(const QueuedRender& render) {
+    if (cancelRequested) {
+        assetManifest.update(render.job, "cancelled", render.params);
+        return;
+    }
+    int line = setupDashboard.add(render.job, "starting");
+    long long startedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string output;
+    bool saved = false;
+    std::string state = runWithDeadline(render.args, render.deadlineSeconds, output, [&](const std::string& event) {
+        std::string kind = jsonField(event, "event");
+        if (kind == "submitted") {
+            setupDashboard.update(line, "queued on " + jsonField(event, "server"));
+        } else if (kind == "step") {
+            setupDashboard.update(line, jsonField(event, "status"), std::atoi(jsonField(event, "step").c_str()), std::atoi(jsonField(event, "total").c_str()));
+        } else if (kind == "decoded") {
+            setupDashboard.update(line, "saving");
+        } else if (kind == "saved") {
+            saved = true;
+        } else if (kind == "failed") {
+            setupDashboard.update(line, "failed: " + jsonField(event, "error"));
+        }
+    });
+    setupDashboard.remove(line);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // A progressive render returns after its preview, which says nothing about full-quality throughput
+    assetBudget.recordRender(render.quality, seconds, saved && !progressiveImages);
+    struct stat info;
+    if (state == "done" && stat(render.filename.c_str(), &info) != 0) {
+        state = "failed";
+    }
+    assetManifest.update(render.job, state, render.params, state == "done" ? render.filename : "");
+    if (state == "done" && !render.refineArgs.empty()) {
+        std::vector<std::string> refineArgs = render.refineArgs;
+        refineArgs.push_back("--refine-of");
+        refineArgs.push_back(std::to_string(seconds * 1000));
+        refineArgs.push_back(std::to_string(startedMs));
+        std::lock_guard<std::mutex> lock(refinementsMutex);
+        pendingRefinements.push_back(refineArgs);
+    }
+    if (state != "done") {
+        std::cerr << "Render " + state + ": " + render.command + "\n" << std::flush;
+    }
+    std::cout << output + "\n" << std::flush; // One write, as other renders may be printing too
+}
+
+// Render workers: setup queues each image here and goes on to the next card's LLM call while up
+// to renderJobs renders run. At most one render per worker waits in the queue, so the render
+// budget is never planned far ahead of the renders themselves. Without workers, submit() renders
+// on the calling thread.
+class RenderQueue {
+public:
+    // Function to start the workers for a setup
+    void start(int workers) {
+        stopping = false;
+        for (int w = 0; w < std::max(1, workers); ++w) {
+            threads.push_back(std::thread(&RenderQueue::work, this));
+        }
+    }
+
+    // Function to queue a render, waiting while every worker already has one waiting
+    void submit(const QueuedRender& render) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (threads.empty()) {
+            lock.unlock();
+            runQueuedRender(render);
+            return;
+        }
+        changed.wait(lock, [this]() { return waiting.size() < threads.size(); });
+        waiting.push_back(render);
+        changed.notify_all();
+    }
+
+    // Function to wait for every queued render to finish and stop the workers
+    void drain() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (std::thread& worker : threads) {
+            worker.join();
+        }
+        threads.clear();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<QueuedRender> waiting;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this]() { return stopping || !waiting.empty(); });
+            if (waiting.empty()) {
+                return;
+            }
+            QueuedRender render = waiting.front();
+            waiting.pop_front();
+            changed.notify_all();
+            lock.unlock();
+            runQueuedRender(render);
+            lock.lock();
+        }
+    }
+};
+
+RenderQueue renderQueue;
+
+// Function to render the image for one asset with easy_diffusion. The render is queued for a
+// render worker, and its progress shows on the setup dashboard.
+void renderAssetImage(AssetKind kind, const std::string& name, const std::string& description, const std::string& filename) {
+    generatedAssets.push_back({kind, name, description, filename});
+
+    // An interrupted setup may have rendered it already
+    checkCancelled();
+    static const char* kindNames[3] = {"room", "weapon", "character"};
+    std::string job = std::string("render ") + kindNames[static_cast<int>(kind)] + " " + name;
+    std::string params = description + "\n" + filename;
+    struct stat info;
+    if (assetManifest.output(job, params) == filename && stat(filename.c_str(), &info) == 0 && info.st_size > 0) {
+        std::cout << "Already rendered " << name << " to " << filename << ", skipping it." << std::endl;
+        return;
+    }
+
+    RenderQuality quality;
+    if (!assetBudget.chooseQuality(kind, name, quality)) {
+        useFallbackImage(name, filename);
+        return;
+    }
+
+    std::vector<std::string> args = {"./easy_diffusion", description, std::to_string(quality.steps), std::to_string(quality.width) + "x" + std::to_string(quality.height), filename,
+                                     "--seed", std::to_string(imageSeedFor(description))};
+    std::vector<std::string> refineArgs;
+    if (progressiveImages) {
+        // The full-quality pass waits for startRefinements(), after the last preview of the setup
+        refineArgs = args;
+        if (renderTimeoutSeconds > 0) {
+            refineArgs.push_back("--timeout");
+            refineArgs.push_back(std::to_string(static_cast<int>(std::ceil(renderTimeoutSeconds))));
+        }
+        args.push_back("--progressive");
+        args.push_back("--preview-only");
+    }
+    // Give the render the time left in the budget, if that is shorter than the render timeout
+    double timeout = renderTimeoutSeconds;
+    if (assetBudget.enabled) {
+        double budgetLeft = std::max(1.0, std::chrono::duration<double>(assetBudget.deadline - std::chrono::steady_clock::now()).count());
+        timeout = timeout > 0 ? std::min(timeout, budgetLeft) : budgetLeft;
+    }
+    if (timeout > 0) {
+        args.push_back("--timeout");
+        args.push_back(std::to_string(static_cast<int>(std::ceil(timeout))));
+    }
+    std::string command;
+    for (const std::string& arg : args) {
+        command += (command.empty() ? "" : " ") + (arg.find(' ') == std::string::npos ? arg : "\"" + arg + "\"");
+    }
+    args.push_back("--progress-fd");
+    args.push_back(std::to_string(progressEventFd));
+    std::cout << "Generating image for " << name << "..." << std::endl;
+    std::cout << "Command: " << command << std::endl; // Print the command
+
+    assetManifest.update(job, "running", params);
+    // easy_diffusion stops itself at the timeout; the extra seconds cover its start-up and clean-up
+    renderQueue.submit({job, params, name, filename, quality, args, command, timeout > 0 ? timeout + 15 : 0, refineArgs});
+}
+
+// Function to generate images for the rooms
+void generateRoomImages(const std::vector<std::string>& rooms, const std::string& gameTheme) {
+    std::string rooms_dir = imageRoot + "rooms/";
+    if (!createDirectory(rooms_dir)) {
+        std::cerr << "Could not create rooms directory!" << std::endl;
+        return;
+    }
+
+    for (const auto& room : rooms) {
+        // Generate a prompt for the room description
+        std::string prompt = "Describe the interior of a " + room + " in a " + gameTheme + " themed Clue-like game setting. Be descriptive and include details about the furniture, decor, and atmosphere. Start with the room name, '" + room + ", ' and then use short, concise language punctuated with commas to describe the things that should be in the image.  Keep everything on one line and only include the description, no preamble or further explanation.";
+        std::string room_description = getDescriptionFromLLM(prompt, gameTheme, ThemeBank::Room, room);
+        if (room_description.empty()) {
+            continue;
+        }
+
+        std::string filename = rooms_dir + room + ".png";
+        std::cout << "Room description: " << room_description << std::endl; // Print the room description
+        renderAssetImage(AssetKind::Room, room, room_description, filename);
+    }
+}
+
+// Function to get a list of weapons from the LLM
+std::vector<std::string> getWeaponsFromLLM(const std::string& gameTheme) {
+    const int maxRetries = 3;
+    int retryCount = 0;
+
+    std::string prompt = "List 6 random weapons suitable for a " + gameTheme + " themed clue-like game, but not Candlestick, Dagger, Lead Pipe, Revolver, Rope, or Wrench, separated by commas. Give me only the comma separated list, nothing else.";
+
+    // Take the list from an interrupted setup, or from the theme bank if this theme has been generated before
+    std::vector<std::string> weapons = resumeList("weapons", prompt, gameTheme, ThemeBank::Weapon);
+    bool banked = !weapons.empty();
+
+    if (!banked) {
+        assetManifest.update("weapons", "running", prompt);
+    }
+    while (!banked && retryCount < maxRetries) {
+        double temperature = 1.0;
+        std::string response = getLLMResponse(prompt, temperature, "weapons");
+
+        // Extract the content from the JSON response
+        size_t contentStart = response.find("\"content\":\"");
+        if (contentStart == std::string::npos) {
+            std::cerr << "Could not find 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+            retryCount++;
+            continue;
+        }
+        contentStart += strlen("\"content\":\"");
+
+        // Look for the end of the content, allowing for variations in the closing sequence
+        size_t contentEnd = response.find("\"}]", contentStart);
+        if (contentEnd == std::string::npos) {
+            contentEnd = response.find("\"", contentStart); // Try to find the next quote
+            if (contentEnd == std::string::npos) {
+                std::cerr << "Could not find end of 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+                retryCount++;
+                continue;
+            }
+        }
+
+        std::string content = response.substr(contentStart, contentEnd - contentStart);
+
+        weapons.clear();
+        std::stringstream ss(content);
+        std::string weapon;
+        while (std::getline(ss, weapon, ',')) {
+            // Remove leading/trailing whitespace
+            weapon.erase(0, weapon.find_first_not_of(" \t\n\r"));
+            weapon.erase(weapon.find_last_not_of(" \t\n\r") + 1);
+            weapons.push_back(weapon);
+        }
+
+        try {
+            validateLLMResponseCount(weapons, 6, "weapons");
+            themeBank.storeList(gameTheme, ThemeBank::Weapon, weapons);
+            assetManifest.update("weapons", "done", prompt, joinList(weapons));
+            // If validation succeeds, break out of the loop
+            break;
+        } catch (const std::exception& e) {
+            std::cerr << "Error validating LLM response: " << e.what() << " (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+            retryCount++;
+        }
+    }
+
+    // If max retries reached, return an empty vector
+    if (retryCount == maxRetries) {
+        std::cerr << "Max retries reached for getting weapons. Returning empty list." << std::endl;
+        assetManifest.update("weapons", "failed", prompt);
+        return {};
+    }
+
+    // Create the weapons directory
+    std::string weapons_dir = imageRoot + "weapons/";
+    if (!createDirectory(weapons_dir))
+    {
+        std::cerr << "Could not create weapons directory!" << std::endl;
+    }
+
+    for (const auto& weapon : weapons) {
+		// Generate a prompt for the weapon description
+		std::string prompt = "Describe the physical appearance of a " + weapon + ". Start with '" + weapon + ", ' and then use short, concise language punctuated with commas to describe the things that should be in the image. Also mention 'centered in frame' to make sure the entire item is pictured. For example, if the item was a baseball bat the description could be as simple as 'baseball bat, wooden, centered in frame'";
+		std::string weapon_description = getDescriptionFromLLM(prompt, gameTheme, ThemeBank::Weapon, weapon);
+		if (weapon_description.empty()) {
+			continue;
+		}
+
+        std::string filename = weapons_dir + weapon + ".png";
+        std::cout << "Weapon description: " << weapon_description << std::endl; // Print the weapon description
+        renderAssetImage(AssetKind::Weapon, weapon, weapon_description, filename);
+    }
+
+    return weapons;
+}
+
+// Function to get a list of characters from the LLM
+std::vector<std::string> getCharactersFromLLM(const std::string& gameTheme) {
+    const int maxRetries = 3;
+    int retryCount = 0;
+
+    std::string prompt = "List 6 random characters suitable for a " + gameTheme + " themed clue-like game, but not Miss Scarlet, Colonel Mustard, Mrs. White, Mr. Green, Mrs. Peacock, or Professor Plum, separated by commas. Give me only the comma separated list, nothing else.";
+
+    // Take the list from an interrupted setup, or from the theme bank if this theme has been generated before
+    std::vector<std::string> characters = resumeList("characters", prompt, gameTheme, ThemeBank::Character);
+    bool banked = !characters.empty();
+
+    if (!banked) {
+        assetManifest.update("characters", "running", prompt);
+    }
+    while (!banked && retryCount < maxRetries) {
+        double temperature = 1.0;
+        std::string response = getLLMResponse(prompt, temperature, "characters");
+
+        // Extract the content from the JSON response
+        size_t contentStart = response.find("\"content\":\"");
+        if (contentStart == std::string::npos) {
+            std::cerr << "Could not find 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+            retryCount++;
+            continue;
+        }
+        contentStart += strlen("\"content\":\"");
+
+        // Look for the end of the content, allowing for variations in the closing sequence
+        size_t contentEnd = response.find("\"}]", contentStart);
+        if (contentEnd == std::string::npos) {
+            contentEnd = response.find("\"", contentStart); // Try to find the next quote
+            if (contentEnd == std::string::npos) {
+                std::cerr << "Could not find end of 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+                retryCount++;
+                continue;
+            }
+        }
+
+        std::string content = response.substr(contentStart, contentEnd - contentStart);
+
+        characters.clear();
+        std::stringstream ss(content);
+        std::string character;
+        while (std::getline(ss, character, ',')) {
+            // Remove leading/trailing whitespace
+            character.erase(0, character.find_first_not_of(" \t\n\r"));
+            character.erase(character.find_last_not_of(" \t\n\r") + 1);
+            characters.push_back(character);
+        }
+
+        try {
+            validateLLMResponseCount(characters, 6, "characters");
+            themeBank.storeList(gameTheme, ThemeBank::Character, characters);
+            assetManifest.update("characters", "done", prompt, joinList(characters));
+            // If validation succeeds, break out of the loop
+            break;
+        } catch (const std::exception& e) {
+            std::cerr << "Error validating LLM response: " << e.what() << " (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+            retryCount++;
+        }
+    }
+
+    // If max retries reached, return an empty vector
+    if (retryCount == maxRetries) {
+        std::cerr << "Max retries reached for getting characters. Returning empty list." << std::endl;
+        assetManifest.update("characters", "failed", prompt);
+        return {};
+    }
+
+    // Call easy_diffusion.cpp for each character
+	std::string characters_dir = imageRoot + "characters/";
+	if (!createDirectory(characters_dir))
+    {
+        std::cerr << "Could not create characters directory!" << std::endl;
+    }
+
+    for (const auto &character : characters)
+    {
+        // Generate a prompt for the character description
+        std::string prompt = "Describe the physical appearance of " + character + ". Describe them in short concise language as if you were describing them to a painter.  Such as  'A woman, sunglasses, a hat, brown coat.'  Only output your description and nothing else, no preamble or further explanation.";
+        std::string character_description = getDescriptionFromLLM(prompt, gameTheme, ThemeBank::Character, character);
+        if (character_description.empty()) {
+            continue;
+        }
+
+        std::string filename = characters_dir + character + ".png";
+        std::cout << "Character description: " << character_description << std::endl; // Print the character description
+        renderAssetImage(AssetKind::Character, character, character_description, filename);
+    }
+
+    return characters;
+}
+
+// Function to get an overall theme for the game from the LLM
+std::string getGameThemeFromLLM() {
+    const int maxRetries = 3;
+    int retryCount = 0;
+
+    while (retryCount < maxRetries) {
+        std::string prompt = "Suggest a themed place for a Clue-like game.  Do not include the word 'Mansion' as that is too similar to the original. Be creative!  Give me a one or two word answer and nothing else, no explanation or pramble, only the themed place.";
+        double temperature = 1.5;
+        std::string response = getLLMResponse(prompt, temperature, "theme");
+
+        // Extract the content from the JSON response
+        size_t contentStart = response.find("\"content\":\"");
+        if (contentStart == std::string::npos) {
+            std::cerr << "Could not find 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+            retryCount++;
+            continue;
+        }
+        contentStart += strlen("\"content\":\"");
+
+        // Look for the end of the content, allowing for variations in the closing sequence
+        size_t contentEnd = response.find("\"}]", contentStart);
+        if (contentEnd == std::string::npos) {
+            contentEnd = response.find("\"", contentStart); // Try to find the next quote
+            if (contentEnd == std::string::npos) {
+                std::cerr << "Could not find end of 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+                retryCount++;
+                continue;
+            }
+        }
+
+        std::string content = response.substr(contentStart, contentEnd - contentStart);
+
+        // Remove leading/trailing whitespace
+        content.erase(0, content.find_first_not_of(" \t\n\r"));
+        content.erase(content.find_last_not_of(" \t\n\r") + 1);
+
+        if (!content.empty()) {
+            return content; // Return the theme if found
+        } else {
+            std::cerr << "LLM returned an empty theme (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
+            retryCount++;
+        }
+    }
+
+    // If max retries reached, return a default theme
+    std::cerr << "Max retries reached for getting game theme. Using default theme." << std::endl;
+    return "Mystery";
+}
+
+// Total seconds allowed for generating all asset images (0 = unbudgeted)
+double assetBudgetSeconds = 0;
+
+// What the generation pipeline produced for one theme: its card lists and every image asked for
+struct ThemeContent {
+    std::string theme;
+    std::vector<std::string> rooms;
+    std::vector<std::string> weapons;
+    std::vector<std::string> characters;
+    std::vector<GeneratedAsset> assets;
+};
+
+// Function to run the generation pipeline for a theme: the card lists from the LLM, then a
+// description and an image for every card. Lists the LLM could not produce come back empty.
+ThemeContent generateTheme(const std::string& gameTheme) {
+    ThemeContent content;
+    content.theme = gameTheme;
+    generatedAssets.clear();
+    {
+        // A cancelled setup leaves the refinements of its previews behind
+        std::lock_guard<std::mutex> lock(refinementsMutex);
+        pendingRefinements.clear();
+    }
+    SetupCancellation cancellation;
+    assetManifest.open(imageRoot + "manifest");
+    assetManifest.begin(gameTheme);
+    renderQueue.start(renderJobs);
+    setupDashboard.start(gameTheme);
+    // However setup ends, cancelled included, wait for the renders and give the terminal back
+    struct SetupWorkers {
+        ~SetupWorkers() {
+            renderQueue.drain();
+            setupDashboard.stop();
+        }
+    } setupWorkers;
+
+    // Start the render budget clock, if one was given on the command line
+    if (assetBudgetSeconds > 0) {
+        assetBudget.start(assetBudgetSeconds, 9, 6, 6);
+    }
+
+    // Get lists of rooms, weapons, and characters from LLM
+    content.rooms = getRoomsFromLLM(gameTheme);
+    content.weapons = getWeaponsFromLLM(gameTheme);
+    content.characters = getCharactersFromLLM(gameTheme);
+
+    // Generate images for the rooms *after* getting the room names
+    generateRoomImages(content.rooms, gameTheme);
+    renderQueue.drain();
+    checkCancelled();
+    assetManifest.finish();
+    startRefinements();
+    content.assets.swap(generatedAssets);
+    return content;
+}
+
+// Theme packs: everything generated for one theme in a single file, so a game can start without
+// the LLM or the image server. A header and a table of contents of fixed-size entries (one per
+// card, locating its name, description and PNG by byte offset and length, with a hash of all
+// three) come first, then the bytes they point at. Games map the file and read names,
+// descriptions and images straight out of the mapping.
+const char themePackMagic[8] = {'C', 'L', 'U', 'E', 'P', 'A', 'C', 'K'};
+const uint32_t themePackVersion = 1;
+
+struct ThemePackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t fileBytes;
+    SnapshotSpan theme; // Bytes
+    SnapshotSpan entries; // ThemePackEntry table of contents
+};
+
+struct ThemePackEntry {
+    uint32_t type; // 0 character, 1 weapon, 2 room
+    uint32_t reserved;
+    SnapshotSpan name; // Bytes
+    SnapshotSpan description;
+    SnapshotSpan image; // PNG bytes, empty if none was rendered
+    uint64_t hash; // fnv1a64 of the name, description and image
+};
+
+static_assert(sizeof(ThemePackHeader) == 56 && sizeof(ThemePackEntry) == 64, "Theme pack records must keep their layout");
+
+// A theme pack mapped read-only
+struct ThemePack {
+    const char* base = nullptr;
+    size_t size = 0;
+    const ThemePackHeader* header = nullptr;
+    const ThemePackEntry* entries = nullptr;
+    size_t numEntries = 0;
+
+    ThemePack(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            throw std::runtime_error("Cannot open theme pack " + path + ": " + std::strerror(errno));
+        }
+        size = static_cast<size_t>(info.st_size);
+        void* mapping = size >= sizeof(ThemePackHeader) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Not a theme pack: " + path);
+        }
+        base = static_cast<const char*>(mapping);
+        header = reinterpret_cast<const ThemePackHeader*>(base);
+        std::string problem;
+        if (std::memcmp(header->magic, themePackMagic, sizeof(themePackMagic)) != 0) {
+            problem = "Not a theme pack: " + path;
+        } else if (header->version != themePackVersion) {
+            problem = "Theme pack " + path + " is version " + std::to_string(header->version) + "; this clue reads version " + std::to_string(themePackVersion) + ".";
+        } else if (header->fileBytes != size || !fits(header->theme, 1) || !fits(header->entries, sizeof(ThemePackEntry)) || header->entries.offset % 8 != 0) {
+            problem = "Corrupt theme pack: " + path;
+        } else {
+            entries = reinterpret_cast<const ThemePackEntry*>(base + header->entries.offset);
+            numEntries = header->entries.count;
+            if (numEntries > static_cast<size_t>(CardIndex::maxCards)) {
+                problem = "Theme pack " + path + " has " + std::to_string(numEntries) + " cards; a game takes at most " + std::to_string(CardIndex::maxCards) + ".";
+            }
+        }
+        for (size_t e = 0; problem.empty() && e < numEntries; ++e) {
+            if (entries[e].type > 2 || !fits(entries[e].name, 1) || !fits(entries[e].description, 1) || !fits(entries[e].image, 1)) {
+                problem = "Corrupt theme pack: " + path;
+            }
+        }
+        if (!problem.empty()) {
+            munmap(mapping, size);
+            throw std::runtime_error(problem);
+        }
+    }
+
+    ~ThemePack() {
+        munmap(const_cast<char*>(base), size);
+    }
+
+    std::string text(const SnapshotSpan& span) const {
+        return std::string(base + span.offset, span.count);
+    }
+
+    std::string theme() const {
+        return text(header->theme);
+    }
+
+    // Names of the cards of one type ("character", "weapon" or "room"), in pack order
+    std::vector<std::string> names(const std::string& type) const {
+        uint32_t wanted = type == "character" ? 0 : type == "weapon" ? 1 : 2;
+        std::vector<std::string> found;
+        for (size_t e = 0; e < numEntries; ++e) {
+            if (entries[e].type == wanted) {
+                found.push_back(text(entries[e].name));
+            }
+        }
+        return found;
+    }
+
+    // Function to find a card's image inside the mapping, without copying it; size 0 if none
+    std::pair<const unsigned char*, size_t> image(const std::string& type, const std::string& name) const {
+        uint32_t wanted = type == "character" ? 0 : type == "weapon" ? 1 : 2;
+        for (size_t e = 0; e < numEntries; ++e) {
+            const ThemePackEntry& entry = entries[e];
+            if (entry.type == wanted && entry.name.count == name.size() && std::memcmp(base + entry.name.offset, name.data(), name.size()) == 0) {
+                return std::make_pair(reinterpret_cast<const unsigned char*>(base + entry.image.offset), static_cast<size_t>(entry.image.count));
+            }
+        }
+        return std::make_pair(static_cast<const unsigned char*>(nullptr), static_cast<size_t>(0));
+    }
+
+    // Function to check every entry against its content hash; returns the first bad card's name
+    std::string firstCorruptEntry() const {
+        for (size_t e = 0; e < numEntries; ++e) {
+            if (entryHash(entries[e]) != entries[e].hash) {
+                return text(entries[e].name);
+            }
+        }
+        return "";
+    }
+
+    uint64_t entryHash(const ThemePackEntry& entry) const {
+        uint64_t hash = fnv1a64(base + entry.name.offset, entry.name.count);
+        hash = fnv1a64(base + entry.description.offset, entry.description.count, hash);
+        return fnv1a64(base + entry.image.offset, entry.image.count, hash);
+    }
+
+private:
+    bool fits(const SnapshotSpan& span, size_t itemBytes) const {
+        return span.offset <= size && span.count <= (size - span.offset) / itemBytes;
+    }
+};
+
+// Function to write a theme pack from generated content, reading each card's image from where it
+// was rendered. Writes next to the path and renames, so readers never see half a pack.
+bool writeThemePack(const ThemeContent& content, const std::string& path) {
+    struct Item {
+        uint32_t type;
+        std::string name;
+        std::string description;
+        std::string image;
+    };
+    std::vector<Item> items;
+    const std::vector<std::string>* lists[3] = {&content.characters, &content.weapons, &content.rooms};
+    const AssetKind kinds[3] = {AssetKind::Character, AssetKind::Weapon, AssetKind::Room};
+    for (uint32_t type = 0; type < 3; ++type) {
+        for (const std::string& name : *lists[type]) {
+            Item item = {type, name, "", ""};
+            for (const GeneratedAsset& asset : content.assets) {
+                if (asset.kind == kinds[type] && asset.name == name) {
+                    item.description = asset.description;
+                    std::ifstream file(asset.filename, std::ios::binary | std::ios::ate);
+                    item.image.assign(file ? static_cast<size_t>(file.tellg()) : 0, '\0');
+                    file.seekg(0);
+                    file.read(&item.image[0], item.image.size());
+                }
+            }
+            items.push_back(item);
+        }
+    }
+    if (items.size() > static_cast<size_t>(CardIndex::maxCards)) {
+        std::cerr << "The theme has " << items.size() << " cards; a game takes at most " << CardIndex::maxCards << ". No pack written." << std::endl;
+        return false;
+    }
+
+    ThemePackHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, themePackMagic, sizeof(header.magic));
+    header.version = themePackVersion;
+    header.entries = {sizeof(ThemePackHeader), items.size()};
+    std::vector<ThemePackEntry> entries(items.size());
+    std::string data;
+    uint64_t dataStart = sizeof(ThemePackHeader) + items.size() * sizeof(ThemePackEntry);
+    auto addBytes = [&data, dataStart](const std::string& bytes) -> SnapshotSpan {
+        SnapshotSpan span = {dataStart + data.size(), bytes.size()};
+        data += bytes;
+        return span;
+    };
+    header.theme = addBytes(content.theme);
+    for (size_t e = 0; e < items.size(); ++e) {
+        std::memset(&entries[e], 0, sizeof(ThemePackEntry));
+        entries[e].type = items[e].type;
+        entries[e].name = addBytes(items[e].name);
+        entries[e].description = addBytes(items[e].description);
+        entries[e].image = addBytes(items[e].image);
+        entries[e].hash = fnv1a64(items[e].image.data(), items[e].image.size(),
+                                  fnv1a64(items[e].description.data(), items[e].description.size(), fnv1a64(items[e].name.data(), items[e].name.size())));
+    }
+    header.fileBytes = dataStart + data.size();
+
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ThemePackEntry));
+    out.write(data.data(), data.size());
+    out.close();
+    if (!out || rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write theme pack " << path << std::endl;
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<ThemePack> themePack; // From --theme-pack: the game's theme, cards and images
+
+// Function to build a theme pack offline: generate everything for the theme (or one the LLM
+// picks) and bundle it into one file
+int buildThemePack(const std::string& path, std::string gameTheme) {
+    try {
+        if (gameTheme.empty()) {
+            gameTheme = getGameThemeFromLLM();
+        }
+        std::cout << "Building a theme pack for " << gameTheme << std::endl;
+        // A pack is written from the images as rendered, so it needs them at full quality, not as previews
+        progressiveImages = false;
+        ThemeContent content = generateTheme(gameTheme);
+        if (content.rooms.empty() || content.weapons.empty() || content.characters.empty()) {
+            std::cerr << "The LLM did not produce every card list; no pack written." << std::endl;
+            return 1;
+        }
+        if (!writeThemePack(content, path)) {
+            return 1;
+        }
+        ThemePack pack(path);
+        std::cout << "Wrote " << path << ": " << pack.numEntries << " cards, " << pack.size << " bytes" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// A directory of ready-made theme packs, so a game started without a theme can begin at once.
+// Packs are built under temporary names and renamed to ready-*.cluepack when complete. A game
+// claims one by renaming it to claimed-<pid>-*, which only one process can win, and refills the
+// pool from a low-priority background process. Claim and build counters live in the
+// directory's stats file.
+struct ThemePool {
+    std::string directory;
+    int target = 3; // Packs to keep ready
+
+    // Function to list the ready packs, oldest first
+    std::vector<std::string> readyPacks() const {
+        std::vector<std::string> packs;
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) {
+            return packs;
+        }
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.compare(0, 6, "ready-") == 0 && name.size() > 15 && name.compare(name.size() - 9, 9, ".cluepack") == 0) {
+                packs.push_back(name);
+            }
+        }
+        closedir(dir);
+        std::sort(packs.begin(), packs.end()); // Names start with the build time
+        return packs;
+    }
+
+    // Function to take a ready pack for this process. Returns its new path, or "" if the pool is
+    // empty; the caller maps it and may then unlink it.
+    std::string claim() {
+        for (const std::string& name : readyPacks()) {
+            std::string claimed = directory + "/claimed-" + std::to_string(getpid()) + "-" + name.substr(6);
+            if (rename((directory + "/" + name).c_str(), claimed.c_str()) == 0) {
+                addStats({{"hits", 1}});
+                return claimed;
+            }
+            // Another game renamed it first; try the next one
+        }
+        addStats({{"misses", 1}});
+        return "";
+    }
+
+    // Function to build one pack for a theme the LLM picks, publishing it only once complete
+    bool buildOne() {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::string stamp = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+        std::string work = directory + "/building-" + std::to_string(getpid()) + "-" + stamp;
+        std::string savedImageRoot = imageRoot;
+        imageRoot = work + "/"; // Keep this build's images apart from any game's
+        // Render at full quality: the pack is written from these images, and the directory is
+        // removed below, which background refinements would still be writing into
+        bool savedProgressiveImages = progressiveImages;
+        progressiveImages = false;
+        bool built = false;
+        try {
+            ThemeContent content = generateTheme(getGameThemeFromLLM());
+            built = !content.rooms.empty() && !content.weapons.empty() && !content.characters.empty() && writeThemePack(content, work + ".cluepack")
+                    && rename((work + ".cluepack").c_str(), (directory + "/ready-" + stamp + "-" + std::to_string(getpid()) + ".cluepack").c_str()) == 0;
+        } catch (const std::exception& e) {
+            std::cerr << "Theme pool build failed: " << e.what() << std::endl;
+        }
+        imageRoot = savedImageRoot;
+        progressiveImages = savedProgressiveImages;
+        std::string cleanup = "rm -rf \"" + work + "\" \"" + work + ".cluepack\"";
+        if (system(cleanup.c_str()) != 0) {
+            std::cerr << "Could not remove " << work << std::endl;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        addStats({{built ? "built" : "failed", 1}, {"build_seconds", seconds}});
+        return built;
+    }
+
+    // Function to build packs until the pool holds the target number. Only one process refills
+    // a pool at a time; returns at once if another one is.
+    void refill() {
+        createDirectory(directory);
+        int lock = ::open((directory + "/refill.lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (lock < 0 || flock(lock, LOCK_EX | LOCK_NB) != 0) {
+            if (lock >= 0) {
+                ::close(lock);
+            }
+            return;
+        }
+        while (static_cast<int>(readyPacks().size()) < target && buildOne()) {
+        }
+        ::close(lock);
+    }
+
+    // Function to refill in a detached, lowest-priority process, logging to the pool's farm.log,
+    // so the game being played is not slowed down
+    void startBackgroundRefill() {
+        if (static_cast<int>(readyPacks().size()) >= target) {
+            return;
+        }
+        std::cout.flush();
+        pid_t child = fork();
+        if (child == 0) {
+            if (fork() != 0) {
+                _exit(0); // The grandchild carries on, so nobody has to wait for it
+            }
+            setsid();
+            setpriority(PRIO_PROCESS, 0, 19);
+            int log = ::open((directory + "/farm.log").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            int devNull = ::open("/dev/null", O_RDONLY);
+            dup2(devNull, STDIN_FILENO);
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+            refill();
+            std::cout.flush();
+            _exit(0);
+        }
+        if (child > 0) {
+            waitpid(child, nullptr, 0);
+        }
+    }
+
+    // Function to add to the counters in the stats file, under a lock
+    void addStats(const std::map<std::string, double>& deltas) {
+        createDirectory(directory);
+        int fd = ::open((directory + "/stats").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return;
+        }
+        flock(fd, LOCK_EX);
+        std::map<std::string, double> stats = readStats(fd);
+        for (const auto& delta : deltas) {
+            stats[delta.first] += delta.second;
+        }
+        std::string text;
+        for (const auto& stat : stats) {
+            text += stat.first + " " + std::to_string(stat.second) + "\n";
+        }
+        if (ftruncate(fd, 0) != 0 || pwrite(fd, text.data(), text.size(), 0) != static_cast<ssize_t>(text.size())) {
+            std::cerr << "Could not update " << directory << "/stats" << std::endl;
+        }
+        ::close(fd); // Releases the lock
+    }
+
+    std::map<std::string, double> readStats(int fd) const {
+        std::map<std::string, double> stats;
+        std::string text;
+        char buffer[512];
+        ssize_t got;
+        off_t offset = 0;
+        while ((got = pread(fd, buffer, sizeof(buffer), offset)) > 0) {
+            text.append(buffer, got);
+            offset += got;
+        }
+        std::istringstream lines(text);
+        std::string key;
+        double value;
+        while (lines >> key >> value) {
+            stats[key] = value;
+        }
+        return stats;
+    }
+
+    // Function to print how full the pool is, its hit rate and how fast it refills
+    int printStats() const {
+        int fd = ::open((directory + "/stats").c_str(), O_RDONLY | O_CLOEXEC);
+        std::map<std::string, double> stats;
+        if (fd >= 0) {
+            stats = readStats(fd);
+            ::close(fd);
+        }
+        double claims = stats["hits"] + stats["misses"];
+        std::cout << "Theme pool " << directory << ": " << readyPacks().size() << " of " << target << " packs ready\n";
+        std::cout << "Claims: " << claims << ", hit rate " << (claims > 0 ? stats["hits"] / claims * 100 : 0) << "%\n";
+        std::cout << "Refill: " << stats["built"] << " packs built, " << stats["failed"] << " failed, "
+                  << (stats["built"] > 0 ? stats["build_seconds"] / stats["built"] : 0) << " s per pack, "
+                  << (stats["build_seconds"] > 0 ? stats["built"] * 3600 / stats["build_seconds"] : 0) << " packs per hour of building\n";
+        return 0;
+    }
+};
+
+std::unique_ptr<ThemePool> themePool; // From --theme-pool, for games started without a theme
+
+// Function to set up a game interactively: theme, themed cards and images, player names, then the deal
+std::unique_ptr<GameSession> initializeGame(int numPlayers) {
+    ThemeContent content;
+    if (!themePack) {
+        assetManifest.open(imageRoot + "manifest");
+        if (assetManifest.unfinished()) {
+            std::cout << "The setup of \"" << assetManifest.theme << "\" was interrupted after " << assetManifest.doneJobs() << " jobs. Leave the theme blank to resume it." << std::endl;
+        }
+
+        // Prompt the user for a game theme
+        std::cout << "Enter a game theme (or leave blank for a random theme): ";
+        std::string gameTheme;
+        std::getline(std::cin, gameTheme);
+        if (gameTheme.empty() && assetManifest.unfinished()) {
+            gameTheme = assetManifest.theme;
+        }
+
+        // A blank theme takes a ready-made one from the pool if there is one, otherwise the LLM picks one
+        std::string claimed = gameTheme.empty() && themePool ? themePool->claim() : "";
+        if (!claimed.empty()) {
+            themePack.reset(new ThemePack(claimed));
+            unlink(claimed.c_str()); // The mapping stays valid
+        } else {
+            if (gameTheme.empty()) {
+                gameTheme = getGameThemeFromLLM();
+            }
+            std::cout << "Game theme: " << gameTheme << std::endl;
+            content = generateTheme(gameTheme);
+        }
+    }
+    if (themePack) {
+        // Everything was generated when the pack was built
+        content.theme = themePack->theme();
+        content.rooms = themePack->names("room");
+        content.weapons = themePack->names("weapon");
+        content.characters = themePack->names("character");
+        std::cout << "Game theme: " << content.theme << " (from the theme pack)" << std::endl;
+    }
+    if (themePool) {
+        themePool->startBackgroundRefill(); // Top the pool up while this game is played
+    }
+    const std::string& gameTheme = content.theme;
+    const std::vector<std::string>& llmRooms = content.rooms;
+    const std::vector<std::string>& llmWeapons = content.weapons;
+    const std::vector<std::string>& llmCharacters = content.characters;
+
+    // Check if the LLM calls were successful
+    std::vector<Card> characters = defaultCharacters;
+    std::vector<Card> weapons = defaultWeapons;
+    std::vector<Card> rooms = defaultRooms;
+    if (llmRooms.empty() || llmWeapons.empty() || llmCharacters.empty()) {
+        std::cerr << "Failed to initialize game due to LLM call failure." << std::endl;
+        //throw std::runtime_error("Failed to initialize game due to LLM call failure.");
+		std::cerr << "Using default rooms, weapons, and characters." << std::endl;
+    } else {
+
+		// Create the card vectors using the LLM-generated lists. Any number of rooms works: boards
+		// for other than nine rooms are generated.
+		rooms.clear();
+		for (const auto& roomName : llmRooms) {
+			rooms.push_back({"room", roomName});
+		}
+
+		weapons.clear();
+		for (const auto& weaponName : llmWeapons) {
+			weapons.push_back({"weapon", weaponName});
+		}
+
+		characters.clear();
+		for (const auto& characterName : llmCharacters) {
+			characters.push_back({"character", characterName});
+		}
+	}
+
+
+    std::unique_ptr<GameSession> session(new GameSession(characters, weapons, rooms));
+    session->theme = gameTheme;
+	std::cout << "Number of rooms: " << rooms.size() << std::endl; // ADDED DEBUGGING
+
+    // Name the human players; the bots take the last seats
+    std::vector<std::string> names;
+    for (int i = 0; i < numPlayers - std::min(numBots, numPlayers); ++i) {
+        std::cout << "Enter name for player " << i + 1 << ": ";
+        std::string name;
+        std::getline(std::cin, name);
+        names.push_back(name);
+    }
+    // Record the game under its seed, so it can be replayed and reproduced with --seed
+    uint64_t seed = haveGameSeed ? gameSeed : (static_cast<uint64_t>(std::random_device()()) << 32 | std::random_device()());
+    std::string path = recordPath.empty() ? "games/game-" + std::to_string(seed) + ".cluerec" : recordPath;
+    session->recorder.reset(new GameRecorder());
+    if ((!recordPath.empty() || createDirectory("games")) && session->recorder->open(path)) {
+        std::cout << "Recording the game (seed " << seed << ") to " << path << std::endl;
+    } else {
+        std::cerr << "Cannot record the game to " << path << ", playing without a record." << std::endl;
+        session->recorder.reset();
+    }
+    session->deal(names, std::min(numBots, numPlayers), seed);
+    if (savePath.empty()) {
+        savePath = "games/game-" + std::to_string(seed) + ".cluesave";
+    }
+    boardRenderer.draw(*session->board, session->players); // Display initial board state
+    return session;
+}
+
+// Terminal image previews: when a player at this terminal walks into a room or is shown a card,
+// the card's image is decoded, shrunk with an area filter and drawn with half-block characters,
+// two pixels to a character cell. The escape sequences are cached per card and terminal size, so
+// showing an image again costs a single write.
+
+// An image with 8-bit RGB pixels
+struct RgbImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels; // Row-major, 3 bytes per pixel
+};
+
+// Function to decode a PNG with 8-bit samples (greyscale, RGB or palette, with or without alpha,
+// not interlaced, at most 4096 pixels a side) into RGB, dropping any alpha. Returns false, with
+// the reason, for anything else.
+bool decodePng(const unsigned char* data, size_t size, RgbImage& image, std::string& error) {
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (size < 8 || std::memcmp(data, signature, 8) != 0) {
+        error = "not a PNG";
+        return false;
+    }
+    auto bigEndian32 = [](const unsigned char* bytes) {
+        return static_cast<uint32_t>(bytes[0]) << 24 | static_cast<uint32_t>(bytes[1]) << 16 | static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+    };
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int colourType = -1;
+    std::string palette;
+    std::string compressed;
+    for (size_t at = 8; at + 12 <= size;) {
+        uint32_t length = bigEndian32(data + at);
+        if (length > size - at - 12) {
+            error = "truncated PNG";
+            return false;
+        }
+        const char* type = reinterpret_cast<const char*>(data + at + 4);
+        const unsigned char* body = data + at + 8;
+        if (std::memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+            width = bigEndian32(body);
+            height = bigEndian32(body + 4);
+            if (body[8] != 8 || body[12] != 0) {
+                error = "only 8-bit, non-interlaced PNGs are supported";
+                return false;
+            }
+            colourType = body[9];
+        } else if (std::memcmp(type, "PLTE", 4) == 0) {
+            palette.assign(reinterpret_cast<const char*>(body), length);
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            compressed.append(reinterpret_cast<const char*>(body), length);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        at += 12 + length;
+    }
+    static const int channelsOf[7] = {1, 0, 3, 1, 2, 0, 4};
+    int channels = colourType >= 0 && colourType <= 6 ? channelsOf[colourType] : 0;
+    if (channels == 0 || width == 0 || height == 0 || (colourType == 3 && (palette.size() < 3 || palette.size() % 3 != 0))) {
+        error = "unsupported PNG";
+        return false;
+    }
+    // Card images are at most 1024 pixels a side; a preview is not worth inflating anything much larger
+    if (width > 4096 || height > 4096) {
+        error = "PNG too large for a preview";
+        return false;
+    }
+
+    // Inflate the scanlines, each a filter byte and then the row's samples
+    size_t stride = static_cast<size_t>(width) * channels;
+    std::vector<uint8_t> raw((stride + 1) * height);
+    uLongf rawSize = raw.size();
+    if (uncompress(raw.data(), &rawSize, reinterpret_cast<const Bytef*>(compressed.data()), compressed.size()) != Z_OK || rawSize != raw.size()) {
+        error = "corrupt PNG data";
+        return false;
+    }
+
+    // Undo each row's filter in place, against the row above
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* row = &raw[y * (stride + 1) + 1];
+        const uint8_t* above = y > 0 ? row - (stride + 1) : nullptr;
+        switch (row[-1]) {
+            case 0: // None
+                break;
+            case 1: // Sub
+                for (size_t i = channels; i < stride; ++i) {
+                    row[i] += row[i - channels];
+                }
+                break;
+            case 2: // Up
+                for (size_t i = 0; above && i < stride; ++i) {
+                    row[i] += above[i];
+                }
+                break;
+            case 3: // Average
+                for (size_t i = 0; i < stride; ++i) {
+                    int left = i >= static_cast<size_t>(channels) ? row[i - channels] : 0;
+                    row[i] += (left + (above ? above[i] : 0)) / 2;
+                }
+                break;
+            case 4: // Paeth
+                for (size_t i = 0; i < stride; ++i) {
+                    int left = i >= static_cast<size_t>(channels) ? row[i - channels] : 0;
+                    int up = above ? above[i] : 0;
+                    int upLeft = above && i >= static_cast<size_t>(channels) ? above[i - channels] : 0;
+                    int guess = left + up - upLeft;
+                    int toLeft = std::abs(guess - left);
+                    int toUp = std::abs(guess - up);
+                    int toUpLeft = std::abs(guess - upLeft);
+                    row[i] += toLeft <= toUp && toLeft <= toUpLeft ? left : toUp <= toUpLeft ? up : upLeft;
+                }
+                break;
+            default:
+                error = "corrupt PNG filter";
+                return false;
+        }
+    }
+
+    image.width = static_cast<int>(width);
+    image.height = static_cast<int>(height);
+    image.pixels.resize(static_cast<size_t>(width) * height * 3);
+    uint8_t* out = image.pixels.data();
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* row = &raw[y * (stride + 1) + 1];
+        for (uint32_t x = 0; x < width; ++x, out += 3) {
+            const uint8_t* sample = row + static_cast<size_t>(x) * channels;
+            if (colourType == 3) {
+                size_t entry = std::min<size_t>(sample[0], palette.size() / 3 - 1) * 3;
+                std::memcpy(out, palette.data() + entry, 3);
+            } else if (channels <= 2) {
+                out[0] = out[1] = out[2] = sample[0];
+            } else {
+                std::memcpy(out, sample, 3);
+            }
+        }
+    }
+    return true;
+}
+
+// Function to add a row of bytes to 16-bit column sums, 16 bytes at a time with SSE2 when
+// vectorized (and built for it). 257 rows of 255 still fit in 16 bits.
+void addRowToSums(const uint8_t* row, size_t bytes, uint16_t* sums, bool vectorized) {
+    size_t i = 0;
+#ifdef __SSE2__
+    if (vectorized) {
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i bytes16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            __m128i* sum = reinterpret_cast<__m128i*>(sums + i);
+            _mm_storeu_si128(sum, _mm_add_epi16(_mm_loadu_si128(sum), _mm_unpacklo_epi8(bytes16, zero)));
+            _mm_storeu_si128(sum + 1, _mm_add_epi16(_mm_loadu_si128(sum + 1), _mm_unpackhi_epi8(bytes16, zero)));
+        }
+    }
+#endif
+    for (; i < bytes; ++i) {
+        sums[i] += row[i];
+    }
+}
+
+// Function to shrink an image with an area filter: each output pixel is the mean of the block of
+// source pixels it covers. Summing the block's rows touches every source byte, so that part is
+// vectorized, in 16-bit lanes flushed to 32-bit totals every 257 rows; the columns of each block
+// are then added up per output pixel.
+void downscaleArea(const RgbImage& source, int width, int height, RgbImage& out, bool vectorized = true) {
+    const int rowsPerFlush = 257;
+    out.width = width;
+    out.height = height;
+    out.pixels.resize(static_cast<size_t>(width) * height * 3);
+    size_t rowBytes = static_cast<size_t>(source.width) * 3;
+    std::vector<uint16_t> partial(rowBytes);
+    std::vector<uint32_t> totals(rowBytes);
+    uint16_t* partialSums = partial.data();
+    uint32_t* sums = totals.data();
+    const uint8_t* pixels = source.pixels.data();
+    uint8_t* pixel = out.pixels.data();
+    for (int oy = 0; oy < height; ++oy) {
+        int y0 = static_cast<int>(static_cast<long long>(oy) * source.height / height);
+        int y1 = std::max(y0 + 1, static_cast<int>(static_cast<long long>(oy + 1) * source.height / height));
+        std::memset(sums, 0, rowBytes * sizeof(uint32_t));
+        for (int chunk = y0; chunk < y1; chunk += rowsPerFlush) {
+            std::memset(partialSums, 0, rowBytes * sizeof(uint16_t));
+            for (int y = chunk; y < std::min(y1, chunk + rowsPerFlush); ++y) {
+                addRowToSums(pixels + y * rowBytes, rowBytes, partialSums, vectorized);
+            }
+            for (size_t i = 0; i < rowBytes; ++i) {
+                sums[i] += partialSums[i];
+            }
+        }
+        for (int ox = 0; ox < width; ++ox, pixel += 3) {
+            int x0 = static_cast<int>(static_cast<long long>(ox) * source.width / width);
+            int x1 = std::max(x0 + 1, static_cast<int>(static_cast<long long>(ox + 1) * source.width / width));
+            uint32_t total[3] = {0, 0, 0};
+            for (const uint32_t* sum = sums + x0 * 3, *end = sums + x1 * 3; sum < end; sum += 3) {
+                total[0] += sum[0];
+                total[1] += sum[1];
+                total[2] += sum[2];
+            }
+            uint32_t count = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+            for (int channel = 0; channel < 3; ++channel) {
+                pixel[channel] = static_cast<uint8_t>((total[channel] + count / 2) / count);
+            }
+        }
+    }
+}
+
+// Function to append the escape sequence for a foreground (38) or background (48) colour: 24-bit,
+// or the nearest colour of the 6x6x6 cube of 256-colour terminals
+void appendColour(std::string& text, int layer, const uint8_t* rgb, bool trueColour) {
+    text += "\x1b[" + std::to_string(layer);
+    if (trueColour) {
+        text += ";2;" + std::to_string(rgb[0]) + ";" + std::to_string(rgb[1]) + ";" + std::to_string(rgb[2]) + "m";
+    } else {
+        text += ";5;" + std::to_string(16 + 36 * ((rgb[0] * 5 + 127) / 255) + 6 * ((rgb[1] * 5 + 127) / 255) + (rgb[2] * 5 + 127) / 255) + "m";
+    }
+}
+
+// Function to draw an image two pixel rows per line with upper half blocks: the upper pixel is
+// the foreground colour and the lower one the background. Colours are only sent when they change.
+std::string halfBlockText(const RgbImage& image, bool trueColour) {
+    std::string text;
+    text.reserve(static_cast<size_t>(image.width) * image.height * 20);
+    for (int y = 0; y < image.height; y += 2) {
+        const uint8_t* upper = &image.pixels[static_cast<size_t>(y) * image.width * 3];
+        const uint8_t* lower = y + 1 < image.height ? upper + image.width * 3 : upper;
+        for (int x = 0; x < image.width; ++x) {
+            if (x == 0 || std::memcmp(upper + 3 * x, upper + 3 * (x - 1), 3) != 0) {
+                appendColour(text, 38, upper + 3 * x, trueColour);
+            }
+            if (x == 0 || std::memcmp(lower + 3 * x, lower + 3 * (x - 1), 3) != 0) {
+                appendColour(text, 48, lower + 3 * x, trueColour);
+            }
+            text += "▀";
+        }
+        text += "\x1b[0m\n";
+    }
+    return text;
+}
+
+// Function to pick a preview size in character cells that keeps an image's shape (a cell is about
+// twice as tall as wide, and holds two pixels), within at most maxColumns by maxLines
+void previewSize(int imageWidth, int imageHeight, int maxColumns, int maxLines, int& columns, int& lines) {
+    columns = std::max(1, maxColumns);
+    lines = std::max(1, static_cast<int>((static_cast<long long>(columns) * imageHeight / imageWidth + 1) / 2));
+    if (lines > maxLines) {
+        lines = std::max(1, maxLines);
+        columns = std::max(1, static_cast<int>(static_cast<long long>(lines) * 2 * imageWidth / imageHeight));
+    }
+}
+
+class ImagePreview {
+public:
+    bool enabled = true; // Cleared by --no-image-preview
+
+    // Function to show a card's image below the game text, if this is a terminal and it has one
+    void show(const Card& card) {
+        const char* term = getenv("TERM");
+        struct winsize size;
+        if (!enabled || !isatty(STDOUT_FILENO) || (term != nullptr && std::string(term) == "dumb") || ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0) {
+            return;
+        }
+        const std::string& text = preview(card.type, card.name, size.ws_col, size.ws_row);
+        if (!text.empty()) {
+            std::cout << text << std::flush;
+        }
+    }
+
+    // Function to get a card's preview for a terminal of this size, "" if it has no usable image
+    const std::string& preview(const std::string& type, const std::string& name, int termCols, int termRows) {
+        // The image comes from the theme pack, or from the file rendered for this game
+        std::pair<const unsigned char*, size_t> bytes(nullptr, 0);
+        std::string file;
+        std::string key = type + "\t" + name + "\t" + std::to_string(termCols) + "x" + std::to_string(termRows);
+        if (themePack) {
+            bytes = themePack->image(type, name);
+        } else {
+            file = assetPath({type, name});
+            struct stat info;
+            if (stat(file.c_str(), &info) != 0) {
+                return cache[key];
+            }
+            // A progressive render replaces its file, which then needs a new preview
+            key += "\t" + std::to_string(info.st_mtim.tv_sec) + "." + std::to_string(info.st_mtim.tv_nsec) + "\t" + std::to_string(info.st_size);
+        }
+        auto cached = cache.find(key);
+        if (cached != cache.end()) {
+            return cached->second;
+        }
+
+        std::string& text = cache[key];
+        std::string contents;
+        if (!file.empty()) {
+            std::ifstream input(file, std::ios::binary | std::ios::ate);
+            contents.resize(std::max<std::streamoff>(0, input.tellg()));
+            input.seekg(0);
+            input.read(&contents[0], contents.size());
+            bytes = std::make_pair(reinterpret_cast<const unsigned char*>(contents.data()), contents.size());
+        }
+        RgbImage image;
+        std::string error;
+        if (bytes.second == 0 || !decodePng(bytes.first, bytes.second, image, error)) {
+            return text; // Remembered as having no preview
+        }
+        // Leave room for the board pinned above the game text
+        int columns;
+        int lines;
+        previewSize(image.width, image.height, std::min(std::min(termCols - 1, 64), image.width), std::max(4, termRows / 3), columns, lines);
+        RgbImage small;
+        downscaleArea(image, columns, lines * 2, small);
+        const char* colourTerm = getenv("COLORTERM");
+        bool trueColour = colourTerm != nullptr && (std::string(colourTerm) == "truecolor" || std::string(colourTerm) == "24bit");
+        text = halfBlockText(small, trueColour);
+        return text;
+    }
+
+private:
+    std::map<std::string, std::string> cache; // Escape sequences by card, terminal size and file version
+};
+
+ImagePreview imagePreview;
+
+// Function to run a session on the terminal: print what it says, feed it the current player's
+// lines or let bots play, and redraw the board after each turn
+void playGame(GameSession& session) {
+    long long drawnTurns = 0;
+    std::mt19937_64 seeds(session.seed ^ 0x9e3779b97f4a7c15ULL ^ session.turnsPlayed); // Bots decide the same way for the same seed
+    std::string saveBuffer;
+    session.collectPreviews = true;
+    // Function to print what the session said, then the images of the cards it showed a person
+    auto printOutput = [&session]() {
+        std::cout << session.takeOutput() << std::flush;
+        for (int card : session.takePreviews()) {
+            imagePreview.show(session.cards.cards[card]);
+        }
+    };
+    while (!session.over()) {
+        printOutput();
+        if (session.awaitingInput()) {
+            std::string line;
+            if (!std::getline(std::cin, line)) {
+                return;
+            }
+            session.handleInput(line);
+        } else {
+            session.playBotTurn(solutionSolver, accusationThreshold, seeds());
+        }
+        if (session.turnsPlayed != drawnTurns) {
+            printOutput();
+            boardRenderer.draw(*session.board, session.players); // Redraw whatever changed this turn
+            drawnTurns = session.turnsPlayed;
+            if (!savePath.empty()) {
+                saveGameSnapshot(session, savePath, saveBuffer); // So the game can be resumed from here
+            }
+        }
+    }
+    printOutput();
+}
+
+// Function to print the state of a recorded game at the start of a turn (the last by default)
+// and what happened during that turn
+int showReplay(const std::string& path, long long turn) {
+    try {
+        GameReplay replay(path);
+        turn = turn < 0 ? replay.turns() : std::min(turn, replay.turns());
+        GameSession& session = replay.seek(turn);
+        std::cout << "Game record " << path << ": seed " << session.seed << ", " << session.players.size() << " players, "
+                  << replay.turns() << " turns in " << replay.size << " bytes" << std::endl;
+        boardRenderer.draw(*session.board, session.players);
+        std::cout << "Turn " << turn << (session.over() ? " (game over)" : ", " + session.players[session.current].name + " to play") << std::endl;
+        for (const Player& player : session.players) {
+            std::cout << "  " << player.name << " (" << player.character << (player.isBot ? ", bot" : "") << (player.eliminated ? ", out" : "")
+                      << ") at row " << player.row << ", column " << player.col << " holding " << session.describeCards(player.handMask) << std::endl;
+        }
+        if (turn < replay.turns()) {
+            for (const GameEvent& event : replay.eventsOf(turn)) {
+                const std::string& name = session.players[event.player].name;
+                uint64_t triple = CardIndex::maskOf(event.cards[0]) | CardIndex::maskOf(event.cards[1]) | CardIndex::maskOf(event.cards[2]);
+                if (event.kind == GameEvent::Move) {
+                    std::cout << "  " << name << " moves to row " << event.row << ", column " << event.col << std::endl;
+                } else if (event.kind == GameEvent::Suggestion) {
+                    std::cout << "  " << name << " suggests " << session.describeCards(triple) << "; "
+                              << (event.shown < 0 ? "nobody disproves it" : session.players[event.disprover].name + " shows " + session.cards.cards[event.shown].name) << std::endl;
+                } else if (event.kind == GameEvent::Accusation) {
+                    std::cout << "  " << name << " accuses " << session.describeCards(triple) << (triple == session.solutionMask ? " and is right" : " and is wrong") << std::endl;
+                }
+            }
+        }
+        std::cout << "Solution: " << session.describeCards(session.solutionMask) << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Multiplayer over TCP, served by one thread around epoll. Players are seated at tables in the
+// order they JOIN; a table's game starts once its human seats are full, with bots (--bots) in the
+// remaining seats, played by the server itself. Clients send one command per line:
+//   JOIN name | WATCH table | MOVE row col | SUGGEST character,weapon,room
+//   ACCUSE character,weapon,room | PASS | NOTES | STATS | QUIT
+// and get back OK/ERR replies, the game text meant for them as MSG lines, the board and seating
+// once as a snapshot, and afterwards only what changed: POS, OUT and TURN lines, then OVER.
+struct ClueServer {
+    static const size_t maxLineBytes = 4096;
+    static const size_t maxPendingBytes = 1 << 20; // Clients that fall this far behind are dropped
+
+    struct Connection {
+        int fd = -1;
+        std::string in; // Bytes received that do not make a full line yet
+        std::string out; // Bytes the socket has not taken yet
+        int table = -1; // Table joined or watched, -1 in the lobby
+        int seat = -1; // Seat at that table, -1 for spectators
+        bool writing = false; // Whether EPOLLOUT is armed
+        bool closing = false; // Close once out is flushed
+    };
+
+    struct Table {
+        std::unique_ptr<GameSession> session; // Null until the human seats are full
+        std::vector<int> seats; // Connection of each human seat, -1 once it left
+        std::vector<std::string> names; // Name of each human seat
+        std::vector<int> watchers; // Connections of spectators
+        std::vector<std::pair<int, int>> shownPositions; // Player positions as last sent
+        std::vector<bool> shownOut; // Eliminations as last sent
+        long long shownTurn = -1; // Turns played when TURN was last sent, so a seat's next turn is sent too
+    };
+
+    int humansPerTable = 2;
+    int botsPerTable = 0;
+    double risk = 0.9;
+    SolutionSolver solver; // Bots decide on the loop's thread, so they sample little and alone
+    int epollFd = -1;
+    int listenFd = -1;
+    std::map<int, Connection> connections; // By socket
+    std::map<int, Table> tables; // By table number
+    int nextTable = 0;
+    int openTable = -1; // Table still taking players
+    std::vector<int> dirty; // Connections with output queued this round
+    std::mt19937_64 seeds{std::random_device()()};
+    long long gamesStarted = 0;
+    long long gamesFinished = 0;
+    long long commandsHandled = 0;
+
+    // Function to listen on the port and serve until the process is stopped
+    int run(int port) {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int yes = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 1024) < 0) {
+            std::cerr << "Cannot listen on port " << port << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        watch(listenFd, EPOLLIN);
+        std::cerr << "Serving clue on port " << port << ": " << humansPerTable << " players and " << botsPerTable << " bots per table." << std::endl;
+
+        epoll_event events[256];
+        while (true) {
+            int ready = epoll_wait(epollFd, events, 256, -1);
+            if (ready < 0 && errno != EINTR) {
+                std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+                return 1;
+            }
+            for (int e = 0; e < ready; ++e) {
+                int fd = events[e].data.fd;
+                if (fd == listenFd) {
+                    acceptAll();
+                    continue;
+                }
+                auto it = connections.find(fd);
+                if (it == connections.end()) {
+                    continue; // Closed earlier this round
+                }
+                if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    readFrom(it->second);
+                }
+                if ((events[e].events & EPOLLOUT) && connections.count(fd)) {
+                    flush(connections[fd]);
+                }
+            }
+            flushDirty();
+        }
+    }
+
+private:
+    void watch(int fd, uint32_t events) {
+        epoll_event event;
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    // Function to accept every pending connection and greet it
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return; // EAGAIN, or out of descriptors until someone leaves
+            }
+            int yes = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+            watch(fd, EPOLLIN);
+            Connection& connection = connections[fd];
+            connection.fd = fd;
+            send(connection, "HELLO clue 1\n");
+        }
+    }
+
+    // Function to read what the socket has and handle each complete line
+    void readFrom(Connection& connection) {
+        int fd = connection.fd;
+        char buffer[4096];
+        bool hungUp = false;
+        while (true) {
+            ssize_t got = read(fd, buffer, sizeof(buffer));
+            if (got > 0) {
+                connection.in.append(buffer, got);
+                continue;
+            }
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            hungUp = got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+        size_t start = 0;
+        size_t end;
+        while ((end = connection.in.find('\n', start)) != std::string::npos) {
+            std::string line = connection.in.substr(start, end - start);
+            start = end + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            handleLine(connection, line);
+            if (!connections.count(fd)) {
+                return; // The command closed it
+            }
+        }
+        connection.in.erase(0, start);
+        if (hungUp && connection.out.empty()) {
+            close(connection);
+        } else if (hungUp) {
+            connection.closing = true; // Close once the replies are out
+        } else if (connection.in.size() > maxLineBytes) {
+            send(connection, "ERR line too long\n");
+            connection.closing = true;
+        }
+    }
+
+    // Function to handle one command from a client
+    void handleLine(Connection& connection, const std::string& line) {
+        commandsHandled++;
+        std::istringstream words(line);
+        std::string command;
+        words >> command;
+        std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+        std::string rest;
+        std::getline(words >> std::ws, rest);
+
+        if (command.empty()) {
+            return;
+        } else if (command == "JOIN") {
+            join(connection, rest.empty() ? "Player-" + std::to_string(connection.fd) : rest);
+        } else if (command == "WATCH") {
+            auto it = tables.find(std::atoi(rest.c_str()));
+            if (it == tables.end() || !it->second.session) {
+                send(connection, "ERR no game at that table\n");
+                return;
+            }
+            leave(connection);
+            connection.table = it->first;
+            it->second.watchers.push_back(connection.fd);
+            send(connection, "WATCHING " + std::to_string(it->first) + "\n");
+            sendSnapshot(connection, it->second);
+        } else if (command == "STATS") {
+            send(connection, "STATS connections " + std::to_string(connections.size()) + " tables " + std::to_string(tables.size()) + " started " + std::to_string(gamesStarted) + " finished " + std::to_string(gamesFinished) + " commands " + std::to_string(commandsHandled) + "\n");
+        } else if (command == "QUIT") {
+            send(connection, "BYE\n");
+            connection.closing = true;
+        } else if (command == "NOTES") {
+            GameSession* session = sessionOf(connection);
+            if (!session) {
+                send(connection, "ERR not playing\n");
+                return;
+            }
+            std::ostringstream notes;
+            session->checklists[connection.seat].display(session->players, notes);
+            sendText(connection, notes.str());
+        } else if (command == "MOVE" || command == "SUGGEST" || command == "ACCUSE" || command == "PASS") {
+            GameSession* session = sessionOf(connection);
+            if (!session || session->current != connection.seat || !session->awaitingInput()) {
+                send(connection, "ERR not your turn\n");
+                return;
+            }
+            // Each command is one whole turn of the session's line-at-a-time menu
+            std::vector<std::string> inputs;
+            if (command == "MOVE") {
+                std::istringstream cell(rest);
+                std::string row, col;
+                cell >> row >> col;
+                inputs = {"1", row, col};
+            } else if (command == "PASS") {
+                inputs = {"5"};
+            } else {
+                inputs = {command == "SUGGEST" ? "2" : "3"};
+                std::istringstream names(rest);
+                std::string name;
+                while (std::getline(names, name, ',')) {
+                    size_t first = name.find_first_not_of(' ');
+                    size_t last = name.find_last_not_of(' ');
+                    inputs.push_back(first == std::string::npos ? "" : name.substr(first, last - first + 1));
+                }
+                if (inputs.size() != 4) {
+                    send(connection, "ERR name a character, weapon and room separated by commas\n");
+                    return;
+                }
+            }
+            for (const std::string& input : inputs) {
+                session->handleInput(input);
+            }
+            send(connection, "OK\n");
+            advance(connection.table);
+        } else {
+            send(connection, "ERR unknown command\n");
+        }
+    }
+
+    GameSession* sessionOf(const Connection& connection) {
+        if (connection.table < 0 || connection.seat < 0) {
+            return nullptr;
+        }
+        Table& table = tables[connection.table];
+        return table.session ? table.session.get() : nullptr;
+    }
+
+    // Function to seat a client at the open table, starting its game when the table is full
+    void join(Connection& connection, const std::string& name) {
+        leave(connection);
+        if (openTable < 0) {
+            openTable = nextTable++;
+            tables[openTable];
+        }
+        Table& table = tables[openTable];
+        connection.table = openTable;
+        connection.seat = static_cast<int>(table.seats.size());
+        table.seats.push_back(connection.fd);
+        table.names.push_back(name);
+        send(connection, "SEAT " + std::to_string(openTable) + " " + std::to_string(connection.seat) + "\n");
+        if (static_cast<int>(table.seats.size()) < humansPerTable) {
+            return;
+        }
+        int number = openTable;
+        openTable = -1;
+        table.session.reset(new GameSession(defaultCharacters, defaultWeapons, defaultRooms));
+        table.session->deal(table.names, botsPerTable, seeds());
+        gamesStarted++;
+        for (int fd : table.seats) {
+            sendSnapshot(connections[fd], table);
+        }
+        table.shownPositions.clear();
+        for (const Player& player : table.session->players) {
+            table.shownPositions.push_back(std::make_pair(player.row, player.col));
+        }
+        table.shownOut.assign(table.session->players.size(), false);
+        table.shownTurn = table.session->turnsPlayed;
+        advance(number);
+    }
+
+    // Function to take a client out of its table. A seated player who leaves a game in progress
+    // is replaced by a bot; one who leaves a table still filling up gives up the seat.
+    void leave(Connection& connection) {
+        if (connection.table < 0) {
+            return;
+        }
+        int number = connection.table;
+        Table& table = tables[number];
+        if (connection.seat < 0) {
+            table.watchers.erase(std::remove(table.watchers.begin(), table.watchers.end(), connection.fd), table.watchers.end());
+        } else if (!table.session) {
+            table.seats.erase(table.seats.begin() + connection.seat);
+            table.names.erase(table.names.begin() + connection.seat);
+            for (size_t s = connection.seat; s < table.seats.size(); ++s) {
+                connections[table.seats[s]].seat = static_cast<int>(s);
+                send(connections[table.seats[s]], "SEAT " + std::to_string(number) + " " + std::to_string(s) + "\n");
+            }
+        } else {
+            table.seats[connection.seat] = -1;
+            table.session->players[connection.seat].isBot = true;
+        }
+        connection.table = -1;
+        connection.seat = -1;
+        bool empty = table.watchers.empty() && std::count(table.seats.begin(), table.seats.end(), -1) == static_cast<long>(table.seats.size());
+        if (empty) {
+            if (openTable == number) {
+                openTable = -1;
+            }
+            tables.erase(number);
+        } else if (table.session) {
+            advance(number);
+        }
+    }
+
+    // Function to let the bots play until a person has to move, then send everyone what changed
+    void advance(int number) {
+        Table& table = tables[number];
+        GameSession& session = *table.session;
+        while (!session.over() && !session.awaitingInput()) {
+            session.playBotTurn(solver, risk, seeds());
+        }
+
+        // The game's text, to whoever may see each piece
+        for (const GameSession::Message& message : session.takeMessages()) {
+            if (message.prompt) {
+                continue; // Commands carry whole turns, so clients are never asked for a line
+            }
+            if (message.to >= 0) {
+                if (message.to < static_cast<int>(table.seats.size()) && table.seats[message.to] >= 0) {
+                    sendText(connections[table.seats[message.to]], message.text);
+                }
+                continue;
+            }
+            for (size_t s = 0; s < table.seats.size(); ++s) {
+                if (table.seats[s] >= 0 && static_cast<int>(s) != message.except) {
+                    sendText(connections[table.seats[s]], message.text);
+                }
+            }
+            for (int fd : table.watchers) {
+                sendText(connections[fd], message.text);
+            }
+        }
+
+        // Then the state changes since the last round
+        std::string changes;
+        for (size_t p = 0; p < session.players.size(); ++p) {
+            const Player& player = session.players[p];
+            if (table.shownPositions[p] != std::make_pair(player.row, player.col)) {
+                table.shownPositions[p] = std::make_pair(player.row, player.col);
+                changes += "POS " + std::to_string(p) + " " + std::to_string(player.row) + " " + std::to_string(player.col) + "\n";
+            }
+            if (table.shownOut[p] != player.eliminated) {
+                table.shownOut[p] = player.eliminated;
+                changes += "OUT " + std::to_string(p) + "\n";
+            }
+        }
+        if (session.over()) {
+            changes += "OVER " + std::to_string(session.winnerIndex) + "\n";
+        } else if (table.shownTurn != session.turnsPlayed) {
+            table.shownTurn = session.turnsPlayed;
+            changes += "TURN " + std::to_string(session.current) + "\n";
+        }
+        for (int fd : table.seats) {
+            if (fd >= 0) {
+                send(connections[fd], changes);
+            }
+        }
+        for (int fd : table.watchers) {
+            send(connections[fd], changes);
+        }
+
+        // A finished game sends everyone back to the lobby
+        if (session.over()) {
+            gamesFinished++;
+            for (int fd : table.seats) {
+                if (fd >= 0) {
+                    connections[fd].table = -1;
+                    connections[fd].seat = -1;
+                }
+            }
+            for (int fd : table.watchers) {
+                connections[fd].table = -1;
+                connections[fd].seat = -1;
+            }
+            tables.erase(number);
+        }
+    }
+
+    // Function to send the whole board, card list, seating and turn, for a client that is new to the game
+    void sendSnapshot(Connection& connection, const Table& table) {
+        const GameSession& session = *table.session;
+        const Board& board = *session.board;
+        std::string text = "BOARD " + std::to_string(board.rows) + " " + std::to_string(board.cols) + "\n";
+        // One character per cell: ' ' empty, '.' hallway, and a letter per room name
+        for (size_t id = 1; id < board.names.size(); ++id) {
+            text += "ROOM " + std::string(1, roomLetter(id)) + " " + board.names[id] + "\n";
+        }
+        for (int r = 0; r < board.rows; ++r) {
+            text += "ROW ";
+            for (int c = 0; c < board.cols; ++c) {
+                const GridCell& cell = board.at(r, c);
+                text += cell.type == CellType::Empty ? ' ' : cell.type == CellType::Hallway ? '.' : roomLetter(cell.nameId);
+            }
+            text += "\n";
+        }
+        for (const Card& card : session.cards.cards) {
+            text += "CARD " + card.type + " " + card.name + "\n";
+        }
+        for (size_t p = 0; p < session.players.size(); ++p) {
+            const Player& player = session.players[p];
+            text += "PLAYER " + std::to_string(p) + " " + (player.isBot ? "bot" : "human") + " " + player.name + "," + player.character + "\n";
+            text += "POS " + std::to_string(p) + " " + std::to_string(player.row) + " " + std::to_string(player.col) + "\n";
+            if (player.eliminated) {
+                text += "OUT " + std::to_string(p) + "\n";
+            }
+        }
+        if (connection.seat >= 0) {
+            text += "HAND " + session.describeCards(session.players[connection.seat].handMask) + "\n";
+        }
+        text += "TURN " + std::to_string(session.current) + "\n";
+        send(connection, text);
+    }
+
+    static char roomLetter(size_t nameId) {
+        static const char letters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+        return nameId >= 1 && nameId <= 52 ? letters[nameId - 1] : '?';
+    }
+
+    // Function to queue game text as MSG lines, skipping blank ones
+    void sendText(Connection& connection, const std::string& text) {
+        std::string lines;
+        std::istringstream stream(text);
+        std::string line;
+        while (std::getline(stream, line)) {
+            if (!line.empty()) {
+                lines += "MSG " + line + "\n";
+            }
+        }
+        send(connection, lines);
+    }
+
+    // Function to queue bytes for a client; they go out in one write at the end of the round
+    void send(Connection& connection, const std::string& bytes) {
+        if (bytes.empty()) {
+            return;
+        }
+        if (connection.out.empty()) {
+            dirty.push_back(connection.fd);
+        }
+        connection.out += bytes;
+    }
+
+    void flushDirty() {
+        std::vector<int> pending;
+        pending.swap(dirty);
+        for (int fd : pending) {
+            auto it = connections.find(fd);
+            if (it != connections.end()) {
+                flush(it->second);
+            }
+        }
+    }
+
+    // Function to write as much queued output as the socket takes, waiting for EPOLLOUT for the rest
+    void flush(Connection& connection) {
+        while (!connection.out.empty()) {
+            ssize_t sent = ::send(connection.fd, connection.out.data(), connection.out.size(), MSG_NOSIGNAL);
+            if (sent > 0) {
+                connection.out.erase(0, sent);
+            } else if (sent < 0 && errno == EINTR) {
+                continue;
+            } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                close(connection);
+                return;
+            }
+        }
+        if (connection.out.size() > maxPendingBytes || (connection.out.empty() && connection.closing)) {
+            close(connection);
+            return;
+        }
+        bool wantWrite = !connection.out.empty();
+        if (wantWrite != connection.writing) {
+            connection.writing = wantWrite;
+            epoll_event event;
+            event.events = wantWrite ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            event.data.fd = connection.fd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        }
+    }
+
+    void close(Connection& connection) {
+        int fd = connection.fd;
+        leave(connection);
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    }
+};
+
+// The board layout before it was packed: rows of cells holding their type and name as strings.
+// Only kept so the benchmark can compare against it.
+struct LegacyGridCell {
+    std::string type; // "empty", "hallway", or "room"
+    std::string name;
+};
+
+// Function to time move validation over a list of (row, col, destRow, destCol) moves, in moves per second
+template <typename IsValidMove>
+double timeMoveValidation(const std::vector<int>& moves, int passes, IsValidMove isValidMove, long long& validCount) {
+    validCount = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        for (size_t m = 0; m < moves.size(); m += 4) {
+            validCount += isValidMove(moves[m], moves[m + 1], moves[m + 2], moves[m + 3]);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return moves.size() / 4 * static_cast<double>(passes) / seconds;
+}
+
+// Function to benchmark move validation throughput and board memory, packed grid vs legacy grid
+int benchmarkBoard() {
+    Board packed(defaultRooms);
+
+    // Mirror the packed board into the legacy representation
+    std::vector<std::vector<LegacyGridCell>> legacy(packed.rows, std::vector<LegacyGridCell>(packed.cols));
+    for (int i = 0; i < packed.rows; ++i) {
+        for (int j = 0; j < packed.cols; ++j) {
+            const GridCell& cell = packed.at(i, j);
+            legacy[i][j].type = cell.type == CellType::Room ? "room" : (cell.type == CellType::Hallway ? "hallway" : "empty");
+            legacy[i][j].name = packed.nameOf(cell);
+        }
+    }
+    auto legacyIsValidMove = [&](int startRow, int startCol, int destRow, int destCol) {
+        if (destRow < 0 || destRow >= packed.rows || destCol < 0 || destCol >= packed.cols) {
+            return false;
+        }
+        std::string startType = legacy[startRow][startCol].type;
+        std::string destType = legacy[destRow][destCol].type;
+        if (destType == "empty") {
+            return false;
+        }
+        if (abs(startRow - destRow) + abs(startCol - destCol) != 1) {
+            return false;
+        }
+        if (startType == destType) {
+            if (startType == "room") {
+                return legacy[startRow][startCol].name == legacy[destRow][destCol].name;
+            } else if (startType == "hallway") {
+                return true;
+            }
+        }
+        return (startType == "room" && destType == "hallway") || (startType == "hallway" && destType == "room");
+    };
+
+    // Random single-step moves from random cells, like the ones players enter
+    const int numMoves = 1 << 16;
+    const int passes = 100;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> rowDist(0, packed.rows - 1);
+    std::uniform_int_distribution<int> colDist(0, packed.cols - 1);
+    std::uniform_int_distribution<int> stepDist(0, 3);
+    const int steps[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    std::vector<int> moves;
+    moves.reserve(numMoves * 4);
+    for (int m = 0; m < numMoves; ++m) {
+        int row = rowDist(rng);
+        int col = colDist(rng);
+        int step = stepDist(rng);
+        moves.insert(moves.end(), {row, col, row + steps[step][0], col + steps[step][1]});
+    }
+
+    long long legacyValid = 0;
+    long long packedValid = 0;
+    double legacyRate = timeMoveValidation(moves, passes, legacyIsValidMove, legacyValid);
+    double packedRate = timeMoveValidation(moves, passes, [&](int sr, int sc, int dr, int dc) { return packed.isValidMove(sr, sc, dr, dc); }, packedValid);
+
+    size_t legacyBytes = sizeof(legacy) + legacy.capacity() * sizeof(std::vector<LegacyGridCell>);
+    for (const auto& row : legacy) {
+        legacyBytes += row.capacity() * sizeof(LegacyGridCell);
+        for (const LegacyGridCell& cell : row) {
+            legacyBytes += (cell.type.capacity() > 15 ? cell.type.capacity() + 1 : 0) + (cell.name.capacity() > 15 ? cell.name.capacity() + 1 : 0);
+        }
+    }
+
+    std::cout << "Board " << packed.rows << "x" << packed.cols << ", " << numMoves * passes << " move validations\n";
+    std::cout << "Legacy grid: " << static_cast<long long>(legacyRate) << " moves/s, " << legacyBytes << " bytes (" << legacyValid << " valid)\n";
+    std::cout << "Packed grid: " << static_cast<long long>(packedRate) << " moves/s, " << packed.memoryUsage() << " bytes (" << packedValid << " valid)\n";
+    if (legacyValid != packedValid) {
+        std::cerr << "Mismatch between legacy and packed move validation!" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Function to benchmark building the path tables and answering distance, next-hop and reachability queries
+int benchmarkPaths(const Board& board) {
+    const BoardPaths& paths = board.paths;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BoardPaths rebuilt;
+    rebuilt.build(board.rows, board.cols, board.cells);
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> nodeDist(0, paths.numNodes - 1);
+    const int numQueries = 1 << 20;
+    std::vector<int> queries(numQueries * 2);
+    for (int& node : queries) {
+        node = nodeDist(rng);
+    }
+    // Warm the rows of large boards so the timings below measure lookups, not searches
+    for (int q = 0; q < numQueries && q < 64; ++q) {
+        paths.rowFrom(queries[2 * q]);
+    }
+    int distinctSources = paths.numNodes > BoardPaths::denseNodeLimit ? 64 : numQueries;
+
+    uint64_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < numQueries; ++q) {
+        checksum += paths.distance(queries[2 * (q % distinctSources)], queries[2 * q + 1]);
+        checksum += paths.nextHop(queries[2 * (q % distinctSources)], queries[2 * q + 1]);
+    }
+    double lookupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < numQueries; ++q) {
+        auto reachable = paths.reachableWithin(queries[2 * (q % distinctSources)], q % 12);
+        checksum += reachable.second - reachable.first;
+    }
+    double reachSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Every path must be as long as its distance and made of valid single steps
+    for (int q = 0; q < 256; ++q) {
+        int from = queries[2 * (q % distinctSources)];
+        int to = queries[2 * q + 1];
+        std::vector<int> nodes = paths.path(from, to);
+        if (paths.distance(from, to) != BoardPaths::unreachable && nodes.size() != paths.distance(from, to)) {
+            std::cerr << "Path length does not match distance!" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Board " << board.rows << "x" << board.cols << ": " << paths.numNodes << " nodes, " << paths.adjTargets.size() << " edges\n";
+    std::cout << "Build: " << buildMs << " ms, tables " << paths.memoryUsage() << " bytes\n";
+    std::cout << "Distance + next hop: " << static_cast<long long>(numQueries / lookupSeconds) << " queries/s\n";
+    std::cout << "Reachable within k: " << static_cast<long long>(numQueries / reachSeconds) << " queries/s (checksum " << checksum << ")\n";
+    return 0;
+}
+
+// Function to benchmark procedural layout generation over a ladder of board sizes
+int benchmarkLayout() {
+    struct LayoutCase { int rows; int cols; int numRooms; };
+    const LayoutCase ladder[] = {{25, 25, 9}, {100, 100, 36}, {1000, 1000, 400}, {2000, 2000, 1600}};
+    for (const LayoutCase& layout : ladder) {
+        std::vector<std::string> roomNames;
+        for (int i = 0; i < layout.numRooms; ++i) {
+            roomNames.push_back("Room-" + std::to_string(i + 1));
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Board generated(layout.rows, layout.cols, roomNames, 42);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        bool connected = generated.isConnected();
+        double floodMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!connected) {
+            std::cerr << "Generated layout is not connected!" << std::endl;
+            return 1;
+        }
+
+        // Route every player start towards a random room, one step at a time
+        const BoardPaths& paths = generated.paths;
+        std::vector<int> roomNodes;
+        for (int node = 0; node < paths.numNodes; ++node) {
+            if (paths.isRoom(node)) {
+                roomNodes.push_back(node);
+            }
+        }
+        std::mt19937 rng(7);
+        const int numRoutes = 64;
+        long long steps = 0;
+        start = std::chrono::steady_clock::now();
+        for (int q = 0; q < numRoutes; ++q) {
+            std::pair<int, int> from = generated.startPosition(q % 6);
+            int target = roomNodes[rng() % roomNodes.size()];
+            std::vector<int> nodes = paths.path(paths.nodeAt(from.first, from.second), target);
+            if (nodes.empty() && paths.nodeAt(from.first, from.second) != target) {
+                std::cerr << "Room " << target << " is unreachable!" << std::endl;
+                return 1;
+            }
+            steps += nodes.size();
+        }
+        double routeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Board " << layout.rows << "x" << layout.cols << " with " << layout.numRooms << " rooms: "
+                  << paths.numNodes << " nodes, " << paths.adjTargets.size() << " edges\n";
+        std::cout << "  Generate + path tables: " << buildMs << " ms, flood fill: " << floodMs << " ms, "
+                  << numRoutes << " routes (" << steps << " steps): " << routeMs << " ms\n";
+    }
+    return 0;
+}
+
+// The board drawing before the framebuffer renderer: every player checked for every cell, one stream write per piece.
+// Only kept so the benchmark can compare against it.
+void legacyDisplayBoard(const Board& board, const std::vector<Player>& players, std::ostream& out) {
+    const int cellWidth = 10;
+    out << "\nCurrent Board State:\n";
+    for (int i = 0; i < board.rows; ++i) {
+        for (int j = 0; j < board.cols; ++j) {
+            bool playerPresent = false;
+            for (size_t k = 0; k < players.size(); ++k) {
+                if (players[k].row == i && players[k].col == j) {
+                    out << "[" << (char)('A' + k) << std::string(cellWidth - 2, ' ') << "]";
+                    playerPresent = true;
+                    break;
+                }
+            }
+            if (!playerPresent) {
+                const GridCell& cell = board.at(i, j);
+                if (cell.type == CellType::Empty) {
+                    out << " . ";
+                } else if (cell.type == CellType::Hallway) {
+                    out << "[   ]";
+                } else {
+                    std::string roomName = board.nameOf(cell);
+                    if (roomName.length() > cellWidth - 2) {
+                        roomName = roomName.substr(0, cellWidth - 2);
+                    }
+                    int padding = (cellWidth - 2 - roomName.length()) / 2;
+                    std::string paddedRoomName = roomName;
+                    paddedRoomName.insert(0, padding, ' ');
+                    paddedRoomName.resize(cellWidth - 2, ' ');
+                    out << "[" << paddedRoomName << "]";
+                }
+            }
+            out << std::string(cellWidth - 2, ' ');
+        }
+        out << "\n";
+    }
+}
+
+// Function to benchmark drawing frames while six players walk the board: legacy full redraw vs framebuffer diffs
+int benchmarkRender() {
+    std::vector<std::string> roomNames;
+    for (int i = 0; i < 36; ++i) {
+        roomNames.push_back("Room-" + std::to_string(i + 1));
+    }
+    Board classic(defaultRooms);
+    Board large(100, 100, roomNames, 42);
+    const Board* boards[] = {&classic, &large};
+    for (const Board* current : boards) {
+        // Script the walk up front: one player steps along a shortest path per frame
+        const BoardPaths& paths = current->paths;
+        std::vector<Player> walkers(6);
+        for (size_t k = 0; k < walkers.size(); ++k) {
+            std::pair<int, int> start = current->startPosition(static_cast<int>(k));
+            walkers[k].row = start.first;
+            walkers[k].col = start.second;
+        }
+        std::mt19937 rng(7);
+        const int numFrames = 2000;
+        std::vector<std::vector<Player>> script;
+        for (int f = 0; f < numFrames; ++f) {
+            Player& mover = walkers[f % walkers.size()];
+            int target = static_cast<int>(rng() % paths.numNodes);
+            int hop = paths.nextHop(current->paths.nodeAt(mover.row, mover.col), target);
+            if (hop >= 0) {
+                int cell = paths.nodeCell[hop];
+                mover.row = cell / current->cols;
+                mover.col = cell % current->cols;
             }
+            script.push_back(walkers);
+        }
+
+        std::ostringstream sink;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (const std::vector<Player>& frame : script) {
+            legacyDisplayBoard(*current, frame, sink);
+        }
+        double legacySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double legacyBytes = static_cast<double>(sink.str().size()) / numFrames;
+
+        BoardRenderer renderer;
+        size_t diffBytes = 0;
+        int screenRows = current->rows + 40;
+        int screenCols = current->cols * BoardRenderer::cellWidth;
+        size_t firstBytes = renderer.update(*current, script[0], screenRows, screenCols).size();
+        start = std::chrono::steady_clock::now();
+        for (const std::vector<Player>& frame : script) {
+            diffBytes += renderer.update(*current, frame, screenRows, screenCols).size();
         }
+        double diffSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Board " << current->rows << "x" << current->cols << ", " << numFrames << " frames\n";
+        std::cout << "  Legacy full redraw: " << legacySeconds * 1e6 / numFrames << " us/frame, " << legacyBytes << " bytes/frame\n";
+        std::cout << "  Framebuffer: first frame " << firstBytes << " bytes, then " << diffSeconds * 1e6 / numFrames << " us/frame, "
+                  << static_cast<double>(diffBytes) / numFrames << " bytes/frame\n";
+    }
+    return 0;
+}
 
-        std::string character_description = response.substr(contentStart, contentEnd - contentStart);
+// Function to benchmark suggestion disproval: string hands searched per player vs 64-bit hand masks
+int benchmarkDisprove() {
+    CardIndex index;
+    index.build(defaultCharacters, defaultWeapons, defaultRooms);
+    int numCharacters = static_cast<int>(defaultCharacters.size());
+    int numWeapons = static_cast<int>(defaultWeapons.size());
+    int numRooms = static_cast<int>(defaultRooms.size());
+
+    // Deal everything but a solution to six players
+    const int numPlayers = 6;
+    std::mt19937 rng(7);
+    std::vector<int> deck;
+    for (int id = 0; id < static_cast<int>(index.cards.size()); ++id) {
+        deck.push_back(id);
+    }
+    std::shuffle(deck.begin(), deck.end(), rng);
+    std::vector<std::vector<std::string>> hands(numPlayers);
+    std::vector<uint64_t> masks(numPlayers, 0);
+    for (size_t i = 3; i < deck.size(); ++i) {
+        hands[i % numPlayers].push_back(index.cards[deck[i]].name);
+        masks[i % numPlayers] |= CardIndex::maskOf(deck[i]);
+    }
 
-        // Remove quotes and newlines from the character description
-        character_description.erase(std::remove(character_description.begin(), character_description.end(), '\"'), character_description.end());
-        character_description.erase(std::remove(character_description.begin(), character_description.end(), '\n'), character_description.end());
-        character_description.erase(std::remove(character_description.begin(), character_description.end(), '\\'), character_description.end());
+    const int numSuggestions = 1 << 22;
+    std::vector<int> suggestions(numSuggestions * 4); // Suggester, character, weapon, room IDs
+    for (int s = 0; s < numSuggestions; ++s) {
+        suggestions[4 * s] = static_cast<int>(rng() % numPlayers);
+        suggestions[4 * s + 1] = static_cast<int>(rng() % numCharacters);
+        suggestions[4 * s + 2] = numCharacters + static_cast<int>(rng() % numWeapons);
+        suggestions[4 * s + 3] = numCharacters + numWeapons + static_cast<int>(rng() % numRooms);
+    }
 
-        std::string filename = characters_dir + character + ".png";
-        // Escape the quotes in the character description
-        std::string escaped_character_description = character_description;
-        size_t pos = 0;
-        while ((pos = escaped_character_description.find("\"", pos)) != std::string::npos)
-        {
-            escaped_character_description.replace(pos, 1, "\\\"");
-            pos += 2;
+    long long stringChecksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int s = 0; s < numSuggestions; ++s) {
+        const std::string* names[3] = {&index.cards[suggestions[4 * s + 1]].name, &index.cards[suggestions[4 * s + 2]].name, &index.cards[suggestions[4 * s + 3]].name};
+        for (int offset = 1; offset < numPlayers; ++offset) {
+            int p = (suggestions[4 * s] + offset) % numPlayers;
+            bool found = false;
+            for (const std::string* name : names) {
+                if (std::find(hands[p].begin(), hands[p].end(), *name) != hands[p].end()) {
+                    stringChecksum += p;
+                    found = true;
+                    break;
+                }
+            }
+            if (found) {
+                break;
+            }
         }
-        std::string command = "./easy_diffusion \"" + escaped_character_description + "\" \"25\" \"512x512\" \"" + filename + "\"";
-        std::cout << "Generating image for " << character << "..." << std::endl;
-        std::cout << "Command: " << command << std::endl; // Print the command
-        std::cout << "Character description: " << character_description << std::endl; // Print the character description
-        std::string output = exec(command.c_str());
-		if (output.empty()) {
-			std::cerr << "Command failed: " << command << std::endl;
-		}
-        std::cout << output << std::endl;
     }
+    double stringSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long long maskChecksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < numSuggestions; ++s) {
+        uint64_t suggestion = CardIndex::maskOf(suggestions[4 * s + 1]) | CardIndex::maskOf(suggestions[4 * s + 2]) | CardIndex::maskOf(suggestions[4 * s + 3]);
+        int disprover;
+        if (disproveSuggestion(masks.data(), numPlayers, suggestions[4 * s], suggestion, disprover) >= 0) {
+            maskChecksum += disprover;
+        }
+    }
+    double maskSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    return characters;
+    if (stringChecksum != maskChecksum) {
+        std::cerr << "Disprovers differ between the string and mask versions!" << std::endl;
+        return 1;
+    }
+    std::cout << numSuggestions << " suggestions, " << numPlayers << " players, " << index.cards.size() << " cards\n";
+    std::cout << "String hands: " << static_cast<long long>(numSuggestions / stringSeconds) << " suggestions/s\n";
+    std::cout << "Hand masks:   " << static_cast<long long>(numSuggestions / maskSeconds) << " suggestions/s (checksum " << maskChecksum << ")\n";
+    return 0;
 }
 
-// Function to get an overall theme for the game from the LLM
-std::string getGameThemeFromLLM() {
-    const int maxRetries = 3;
-    int retryCount = 0;
-
-    while (retryCount < maxRetries) {
-        std::string prompt = "Suggest a themed place for a Clue-like game.  Do not include the word 'Mansion' as that is too similar to the original. Be creative!  Give me a one or two word answer and nothing else, no explanation or pramble, only the themed place.";
-        double temperature = 1.5;
-        std::string response = getLLMResponse(prompt, temperature);
+// Function to benchmark deduction: random games where every checklist observes every suggestion
+// and recomputes its envelope odds after each turn
+int benchmarkDeduce() {
+    CardIndex index;
+    index.build(defaultCharacters, defaultWeapons, defaultRooms);
+    int numCharacters = static_cast<int>(defaultCharacters.size());
+    int numWeapons = static_cast<int>(defaultWeapons.size());
+    int numRooms = static_cast<int>(defaultRooms.size());
+    const int numGames = 20;
+    const int maxTurns = 60;
+    std::mt19937 rng(7);
+    for (int numPlayers = 3; numPlayers <= 6; ++numPlayers) {
+        long long turns = 0;
+        long long solvedTurns = 0;
+        int solvedGames = 0;
+        double seconds = 0;
+        for (int game = 0; game < numGames; ++game) {
+            // One card of each category in the envelope, the rest dealt round the table
+            int solution[3] = {static_cast<int>(rng() % numCharacters), numCharacters + static_cast<int>(rng() % numWeapons), numCharacters + numWeapons + static_cast<int>(rng() % numRooms)};
+            uint64_t envelope = CardIndex::maskOf(solution[0]) | CardIndex::maskOf(solution[1]) | CardIndex::maskOf(solution[2]);
+            std::vector<int> deck;
+            for (int id = 0; id < static_cast<int>(index.cards.size()); ++id) {
+                if (!(envelope & CardIndex::maskOf(id))) {
+                    deck.push_back(id);
+                }
+            }
+            std::shuffle(deck.begin(), deck.end(), rng);
+            std::vector<uint64_t> hands(numPlayers, 0);
+            std::vector<int> handSizes(numPlayers, 0);
+            for (size_t i = 0; i < deck.size(); ++i) {
+                hands[i % numPlayers] |= CardIndex::maskOf(deck[i]);
+                handSizes[i % numPlayers]++;
+            }
+            std::vector<Checklist> notes;
+            for (int p = 0; p < numPlayers; ++p) {
+                notes.emplace_back(index, p, hands[p], handSizes);
+            }
 
-        // Extract the content from the JSON response
-        size_t contentStart = response.find("\"content\":\"");
-        if (contentStart == std::string::npos) {
-            std::cerr << "Could not find 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-            retryCount++;
-            continue;
+            for (int turn = 0; turn < maxTurns; ++turn) {
+                int suggester = turn % numPlayers;
+                uint64_t suggestion = CardIndex::maskOf(static_cast<int>(rng() % numCharacters)) | CardIndex::maskOf(numCharacters + static_cast<int>(rng() % numWeapons)) | CardIndex::maskOf(numCharacters + numWeapons + static_cast<int>(rng() % numRooms));
+                int disprover;
+                int shown = disproveSuggestion(hands.data(), numPlayers, suggester, suggestion, disprover);
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                bool solved = false;
+                for (int p = 0; p < numPlayers; ++p) {
+                    notes[p].observeSuggestion(suggester, suggestion, disprover, p == suggester ? shown : -1);
+                    const std::vector<double>& odds = notes[p].solutionProbabilities();
+                    if (!notes[p].deduction.consistent || odds[solution[0]] == 0 || odds[solution[1]] == 0 || odds[solution[2]] == 0) {
+                        std::cerr << "Deduction ruled out the real solution!" << std::endl;
+                        return 1;
+                    }
+                    solved |= (notes[p].deduction.has[numPlayers] & envelope) == envelope;
+                }
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                turns++;
+                if (solved) {
+                    solvedGames++;
+                    solvedTurns += turn + 1;
+                    break;
+                }
+            }
         }
-        contentStart += strlen("\"content\":\"");
+        std::cout << numPlayers << " players: " << seconds * 1e6 / turns << " us per turn for all checklists, "
+                  << solvedGames << "/" << numGames << " games deduced";
+        if (solvedGames > 0) {
+            std::cout << " after " << static_cast<double>(solvedTurns) / solvedGames << " turns on average";
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
 
-        // Look for the end of the content, allowing for variations in the closing sequence
-        size_t contentEnd = response.find("\"}]", contentStart);
-        if (contentEnd == std::string::npos) {
-            contentEnd = response.find("\"", contentStart); // Try to find the next quote
-            if (contentEnd == std::string::npos) {
-                std::cerr << "Could not find end of 'content' in LLM response (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-                retryCount++;
-                continue;
+// Function to benchmark bot decisions: solver latency on mid-game notes for 2 to 6 players,
+// exact enumeration against multi-threaded sampling against single-threaded sampling
+int benchmarkAi() {
+    CardIndex index;
+    index.build(defaultCharacters, defaultWeapons, defaultRooms);
+    int numCharacters = static_cast<int>(defaultCharacters.size());
+    int numWeapons = static_cast<int>(defaultWeapons.size());
+    int numRooms = static_cast<int>(defaultRooms.size());
+    const int numPositions = 8;
+    std::mt19937 rng(11);
+    SolutionSolver exact;
+    exact.exactLimit = 1e12;
+    SolutionSolver sampled;
+    sampled.exactLimit = 0;
+    SolutionSolver sampledSingle = sampled;
+    sampledSingle.threads = 1;
+    SolutionSolver automatic;
+    std::cout << "Sampling with " << sampled.threads << " threads, " << sampled.samples << " deals per decision\n";
+    for (int numPlayers = 2; numPlayers <= 6; ++numPlayers) {
+        double seconds[4] = {0, 0, 0, 0};
+        double maxError = 0;
+        int exactDecisions = 0;
+        for (int position = 0; position < numPositions; ++position) {
+            // Deal a game and play some random suggestions to reach a mid-game position for player 0
+            uint64_t envelope = CardIndex::maskOf(static_cast<int>(rng() % numCharacters)) | CardIndex::maskOf(numCharacters + static_cast<int>(rng() % numWeapons)) | CardIndex::maskOf(numCharacters + numWeapons + static_cast<int>(rng() % numRooms));
+            std::vector<int> deck;
+            for (int id = 0; id < static_cast<int>(index.cards.size()); ++id) {
+                if (!(envelope & CardIndex::maskOf(id))) {
+                    deck.push_back(id);
+                }
+            }
+            std::shuffle(deck.begin(), deck.end(), rng);
+            std::vector<uint64_t> hands(numPlayers, 0);
+            std::vector<int> handSizes(numPlayers, 0);
+            for (size_t i = 0; i < deck.size(); ++i) {
+                hands[i % numPlayers] |= CardIndex::maskOf(deck[i]);
+                handSizes[i % numPlayers]++;
+            }
+            Checklist notes(index, 0, hands[0], handSizes);
+            int numTurns = 2 + position;
+            for (int turn = 0; turn < numTurns; ++turn) {
+                int suggester = turn % numPlayers;
+                uint64_t suggestion = CardIndex::maskOf(static_cast<int>(rng() % numCharacters)) | CardIndex::maskOf(numCharacters + static_cast<int>(rng() % numWeapons)) | CardIndex::maskOf(numCharacters + numWeapons + static_cast<int>(rng() % numRooms));
+                int disprover;
+                int shown = disproveSuggestion(hands.data(), numPlayers, suggester, suggestion, disprover);
+                notes.observeSuggestion(suggester, suggestion, disprover, suggester == 0 ? shown : -1);
+            }
+
+            const SolutionSolver* solvers[4] = {&automatic, &sampled, &sampledSingle, &exact};
+            SolverResult results[4];
+            for (int k = 0; k < 4; ++k) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                results[k] = solvers[k]->solve(notes, 5);
+                seconds[k] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            exactDecisions += results[0].exact;
+            if (results[3].envelopeOdds[__builtin_ctzll(envelope)] == 0) {
+                std::cerr << "The solver ruled out the real solution!" << std::endl;
+                return 1;
+            }
+            for (size_t card = 0; card < results[3].envelopeOdds.size(); ++card) {
+                maxError = std::max(maxError, std::abs(results[1].envelopeOdds[card] - results[3].envelopeOdds[card]));
             }
         }
+        std::cout << numPlayers << " players: decision " << seconds[0] * 1e3 / numPositions << " ms (" << exactDecisions << "/" << numPositions << " exact), "
+                  << "exact " << seconds[3] * 1e3 / numPositions << " ms, sampled " << seconds[1] * 1e3 / numPositions << " ms, "
+                  << "sampled on one thread " << seconds[2] * 1e3 / numPositions << " ms, max sampling error " << maxError << "\n";
+    }
+    return 0;
+}
 
-        std::string content = response.substr(contentStart, contentEnd - contentStart);
+// Headless games between bots, for balancing and throughput testing. Each game owns its state;
+// the board, card index and rules are shared read-only between the worker threads.
+struct SimulationSetup {
+    const Board* board;
+    const CardIndex* cards;
+    std::vector<int> roomCards; // Room card of each board node
+    SolutionSolver solver; // One thread per decision: the games themselves fill the cores
+    int numPlayers = 4;
+    double risk = 0.9;
+    int maxTurns = 400;
+};
 
-        // Remove leading/trailing whitespace
-        content.erase(0, content.find_first_not_of(" \t\n\r"));
-        content.erase(content.find_last_not_of(" \t\n\r") + 1);
+// Totals over many simulated games
+struct SimulationStats {
+    long long games = 0;
+    long long solved = 0; // Won by a correct accusation
+    long long wonByDefault = 0; // Everyone else accused wrongly
+    long long unfinished = 0; // Hit maxTurns, or everyone accused wrongly
+    long long wrongAccusations = 0;
+    long long suggestions = 0;
+    long long turns = 0;
+    long long steals = 0; // Games a worker took from another worker's queue
+    std::vector<long long> winsBySeat;
+    std::vector<long long> gamesByLength; // Games by number of turns
+    std::vector<long long> turnsByMicros; // Turns by decision time, in power-of-two microsecond buckets
+
+    void merge(const SimulationStats& other) {
+        games += other.games;
+        solved += other.solved;
+        wonByDefault += other.wonByDefault;
+        unfinished += other.unfinished;
+        wrongAccusations += other.wrongAccusations;
+        suggestions += other.suggestions;
+        turns += other.turns;
+        steals += other.steals;
+        addInto(winsBySeat, other.winsBySeat);
+        addInto(gamesByLength, other.gamesByLength);
+        addInto(turnsByMicros, other.turnsByMicros);
+    }
 
-        if (!content.empty()) {
-            return content; // Return the theme if found
-        } else {
-            std::cerr << "LLM returned an empty theme (retry " << retryCount + 1 << "/" << maxRetries << ")." << std::endl;
-            retryCount++;
+    static void addInto(std::vector<long long>& into, const std::vector<long long>& from) {
+        if (into.size() < from.size()) {
+            into.resize(from.size(), 0);
+        }
+        for (size_t i = 0; i < from.size(); ++i) {
+            into[i] += from[i];
         }
     }
+};
 
-    // If max retries reached, return a default theme
-    std::cerr << "Max retries reached for getting game theme. Using default theme." << std::endl;
-    return "Mystery";
+// Per-thread arena for simulated games: every buffer is sized by the thread's first game and
+// reused by the rest, so steady-state games do not touch the heap
+struct SimWorkspace {
+    std::vector<int> deck;
+    std::vector<uint64_t> hands;
+    std::vector<int> handSizes;
+    std::vector<int> rows;
+    std::vector<int> cols;
+    std::vector<uint8_t> eliminated;
+    std::vector<Checklist> notes;
+    std::vector<SolverResult> posteriors; // Each seat's last posterior, reused while its notes are unchanged
+    std::vector<long long> posteriorRevisions;
+    SolverScratch scratch;
+    SimulationStats stats;
+
+    SimWorkspace(const SimulationSetup& setup) {
+        int numPlayers = setup.numPlayers;
+        deck.reserve(setup.cards->cards.size());
+        hands.resize(numPlayers);
+        handSizes.resize(numPlayers);
+        rows.resize(numPlayers);
+        cols.resize(numPlayers);
+        eliminated.resize(numPlayers);
+        posteriors.resize(numPlayers);
+        posteriorRevisions.resize(numPlayers);
+        for (int p = 0; p < numPlayers; ++p) {
+            notes.emplace_back(*setup.cards, p, 0, handSizes);
+        }
+        stats.winsBySeat.assign(numPlayers, 0);
+        stats.gamesByLength.assign(setup.maxTurns + 1, 0);
+        stats.turnsByMicros.assign(32, 0);
+    }
+};
+
+// Function to pick the nth set bit of a card mask
+inline int nthCard(uint64_t cards, int n) {
+    for (; n > 0; --n) {
+        cards &= cards - 1;
+    }
+    return __builtin_ctzll(cards);
 }
 
-void initializeGame(int numPlayers) {
-    // Prompt the user for a game theme
-    std::cout << "Enter a game theme (or leave blank for a random theme): ";
-    std::string gameTheme;
-    std::getline(std::cin, gameTheme);
+// Function to play one complete bot game, deterministic for its seed, and add it to the workspace's stats
+void playSimulatedGame(const SimulationSetup& setup, uint64_t seed, SimWorkspace& ws) {
+    std::mt19937_64 rng(seed);
+    const Deduction& layout = ws.notes[0].deduction;
+    int numPlayers = setup.numPlayers;
 
-    // If the user entered a theme, use it. Otherwise, get the theme from the LLM.
-    if (gameTheme.empty()) {
-        gameTheme = getGameThemeFromLLM();
+    // Envelope first, then deal the rest round the table
+    uint64_t solution = 0;
+    for (uint64_t category : layout.categories) {
+        solution |= CardIndex::maskOf(nthCard(category, static_cast<int>(rng() % __builtin_popcountll(category))));
+    }
+    ws.deck.clear();
+    for (uint64_t rest = layout.allCards & ~solution; rest; rest &= rest - 1) {
+        ws.deck.push_back(__builtin_ctzll(rest));
+    }
+    for (size_t i = ws.deck.size(); i > 1; --i) {
+        std::swap(ws.deck[i - 1], ws.deck[rng() % i]);
+    }
+    std::fill(ws.hands.begin(), ws.hands.end(), 0);
+    std::fill(ws.handSizes.begin(), ws.handSizes.end(), 0);
+    for (size_t i = 0; i < ws.deck.size(); ++i) {
+        ws.hands[i % numPlayers] |= CardIndex::maskOf(ws.deck[i]);
+        ws.handSizes[i % numPlayers]++;
+    }
+    for (int p = 0; p < numPlayers; ++p) {
+        ws.notes[p].reset(p, ws.hands[p], ws.handSizes);
+        std::pair<int, int> start = setup.board->startPosition(p);
+        ws.rows[p] = start.first;
+        ws.cols[p] = start.second;
+        ws.eliminated[p] = 0;
+        ws.posteriorRevisions[p] = -1;
     }
-    std::cout << "Game theme: " << gameTheme << std::endl;
-
-    // Get lists of rooms, weapons, and characters from LLM
-    std::vector<std::string> llmRooms = getRoomsFromLLM(gameTheme);
-    std::vector<std::string> llmWeapons = getWeaponsFromLLM(gameTheme);
-    std::vector<std::string> llmCharacters = getCharactersFromLLM(gameTheme);
 
-    // Generate images for the rooms *after* getting the room names
-    generateRoomImages(llmRooms, gameTheme);
+    SimulationStats& stats = ws.stats;
+    int winner = -1;
+    int active = numPlayers;
+    int turn = 0;
+    for (; turn < setup.maxTurns && winner < 0 && active > 0; ++turn) {
+        int seat = turn % numPlayers;
+        if (ws.eliminated[seat]) {
+            continue;
+        }
+        if (active == 1 && numPlayers > 1) {
+            winner = seat;
+            stats.wonByDefault++;
+            break;
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        uint64_t decisionSeed = rng();
+        if (ws.posteriorRevisions[seat] != ws.notes[seat].revision) {
+            ws.posteriors[seat] = setup.solver.solve(ws.notes[seat], decisionSeed, ws.scratch);
+            ws.posteriorRevisions[seat] = ws.notes[seat].revision;
+        }
+        const SolverResult& posterior = ws.posteriors[seat];
+        BotMove move = chooseBotMove(*setup.board, setup.roomCards, ws.notes[seat].deduction, posterior, ws.rows[seat], ws.cols[seat], setup.risk);
+        if (move.accusation) {
+            if (move.accusation == solution) {
+                winner = seat;
+                stats.solved++;
+            } else {
+                stats.wrongAccusations++;
+                ws.eliminated[seat] = 1;
+                active--;
+                for (Checklist& notes : ws.notes) {
+                    notes.ruleOutSolution(move.accusation);
+                }
+            }
+        } else {
+            ws.rows[seat] = move.row;
+            ws.cols[seat] = move.col;
+            if (move.suggestion) {
+                int disprover;
+                int shown = disproveSuggestion(ws.hands.data(), numPlayers, seat, move.suggestion, disprover);
+                for (int p = 0; p < numPlayers; ++p) {
+                    ws.notes[p].observeSuggestion(seat, move.suggestion, disprover, p == seat ? shown : -1);
+                }
+                stats.suggestions++;
+            }
+        }
+        long long micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        stats.turnsByMicros[std::min(31, micros > 0 ? 64 - __builtin_clzll(static_cast<uint64_t>(micros)) : 0)]++;
+        stats.turns++;
+    }
 
-    // Check if the LLM calls were successful
-    if (llmRooms.empty() || llmWeapons.empty() || llmCharacters.empty()) {
-        std::cerr << "Failed to initialize game due to LLM call failure." << std::endl;
-        //throw std::runtime_error("Failed to initialize game due to LLM call failure.");
-		std::cerr << "Using default rooms, weapons, and characters." << std::endl;
+    stats.games++;
+    stats.gamesByLength[std::min(turn, setup.maxTurns)]++;
+    if (winner >= 0) {
+        stats.winsBySeat[winner]++;
     } else {
+        stats.unfinished++;
+    }
+}
 
-		// Check if enough rooms were retrieved
-		if (llmRooms.size() < 9) {
-			std::cerr << "Not enough rooms retrieved from LLM. Game cannot start." << std::endl;
-			//throw std::runtime_error("Not enough rooms retrieved from LLM.");
-			std::cerr << "Using default rooms, weapons, and characters." << std::endl;
-		} else {
-
-			// Create the card vectors using the LLM-generated lists
-			rooms.clear();
-			for (const auto& roomName : llmRooms) {
-				rooms.push_back({"room", roomName});
-			}
-		}
+// Work-stealing scheduler for simulated games: each worker starts with its own deque of game
+// numbers, pops from its back, and when it runs dry steals from the front of another deque
+struct GameQueues {
+    struct Queue {
+        std::mutex mutex;
+        std::deque<long long> games;
+    };
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    GameQueues(long long numGames, int numWorkers) {
+        for (int w = 0; w < numWorkers; ++w) {
+            queues.emplace_back(new Queue());
+        }
+        // Contiguous blocks, so an uneven mix of long and short games shows up as stealing
+        for (long long g = 0; g < numGames; ++g) {
+            queues[g * numWorkers / numGames]->games.push_back(g);
+        }
+    }
 
-		weapons.clear();
-		for (const auto& weaponName : llmWeapons) {
-			weapons.push_back({"weapon", weaponName});
-		}
+    // Function to get the next game for a worker; returns false when every queue is empty
+    bool next(int worker, long long& game, long long& steals) {
+        {
+            Queue& own = *queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.games.empty()) {
+                game = own.games.back();
+                own.games.pop_back();
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            Queue& victim = *queues[(worker + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.games.empty()) {
+                game = victim.games.front();
+                victim.games.pop_front();
+                steals++;
+                return true;
+            }
+        }
+        return false;
+    }
+};
 
-		characters.clear();
-		for (const auto& characterName : llmCharacters) {
-			characters.push_back({"character", characterName});
-		}
-	}
+// Function to print the value below which the given fraction of a histogram's weight lies
+long long histogramPercentile(const std::vector<long long>& histogram, double fraction, bool powerOfTwoBuckets) {
+    long long total = 0;
+    for (long long count : histogram) {
+        total += count;
+    }
+    long long seen = 0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        seen += histogram[i];
+        if (total > 0 && seen >= fraction * total) {
+            return powerOfTwoBuckets ? (1LL << i) : static_cast<long long>(i);
+        }
+    }
+    return 0;
+}
 
+// Function to play numGames bot games on numThreads threads and report throughput and outcomes
+int runSimulation(long long numGames, int numThreads, int numPlayers, double risk, long long samples) {
+    if (numGames <= 0 || numThreads <= 0 || numPlayers < 2 || numPlayers > 6) {
+        std::cerr << "--simulate needs a positive game count and thread count, and 2-6 players." << std::endl;
+        return 1;
+    }
+    CardIndex cards;
+    cards.build(defaultCharacters, defaultWeapons, defaultRooms);
+    std::shared_ptr<const Board> simBoard = boardCache().get(defaultRooms);
+    SimulationSetup setup;
+    setup.board = simBoard.get();
+    setup.cards = &cards;
+    setup.roomCards = roomCardsByNode(*simBoard, cards);
+    setup.solver.threads = 1;
+    setup.solver.samples = samples;
+    setup.solver.exactLimit = 2e5;
+    setup.numPlayers = numPlayers;
+    setup.risk = risk;
+
+    GameQueues queues(numGames, numThreads);
+    std::vector<std::unique_ptr<SimWorkspace>> workspaces;
+    for (int w = 0; w < numThreads; ++w) {
+        workspaces.emplace_back(new SimWorkspace(setup));
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int w = 0; w < numThreads; ++w) {
+        workers.emplace_back([&, w]() {
+            SimWorkspace& ws = *workspaces[w];
+            long long game;
+            while (queues.next(w, game, ws.stats.steals)) {
+                playSimulatedGame(setup, 0x5EEDULL * 1000003 + game, ws);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    // Create the deck of cards
-    std::vector<Card> deck;
-    deck.insert(deck.end(), characters.begin(), characters.end());
-    deck.insert(deck.end(), weapons.begin(), weapons.end());
-    deck.insert(deck.end(), rooms.begin(), rooms.end());
+    SimulationStats total;
+    for (const auto& ws : workspaces) {
+        total.merge(ws->stats);
+    }
+    std::cout << total.games << " games, " << numPlayers << " bots, " << numThreads << " threads, " << samples << " samples per sampled decision\n";
+    std::cout << "Throughput: " << total.games / seconds << " games/s, " << total.turns / seconds << " turns/s (" << seconds << " s, "
+              << total.steals << " games stolen)\n";
+    std::cout << "Game length in turns: mean " << static_cast<double>(total.turns) / total.games
+              << ", p50 " << histogramPercentile(total.gamesByLength, 0.5, false)
+              << ", p90 " << histogramPercentile(total.gamesByLength, 0.9, false)
+              << ", p99 " << histogramPercentile(total.gamesByLength, 0.99, false) << "\n";
+    std::cout << "Decision time per turn: p50 < " << histogramPercentile(total.turnsByMicros, 0.5, true)
+              << " us, p99 < " << histogramPercentile(total.turnsByMicros, 0.99, true) << " us\n";
+    std::cout << "Outcomes: " << total.solved << " solved, " << total.wonByDefault << " won by default, " << total.unfinished << " unfinished; "
+              << total.wrongAccusations << " wrong accusations, " << static_cast<double>(total.suggestions) / total.games << " suggestions per game\n";
+    std::cout << "Wins by seat:";
+    for (int seat = 0; seat < numPlayers; ++seat) {
+        std::cout << " " << seat + 1 << ": " << 100.0 * total.winsBySeat[seat] / total.games << "%";
+    }
+    std::cout << "\n";
+    return 0;
+}
 
-    // Shuffle the deck (you'll need <algorithm> for std::random_shuffle or std::shuffle)
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(deck.begin(), deck.end(), g);
+// Function to read this process's resident memory in bytes (0 if unavailable)
+size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    if (!(statm >> pages >> resident)) {
+        return 0;
+    }
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
 
-    // Select the solution (one character, one weapon, one room)
-    Card solutionCharacter = deck[0];
-    Card solutionWeapon = deck[1];
-    Card solutionRoom = deck[2];
+// Function to benchmark hosting many sessions in one process: memory per session and scripted
+// player input handled per second on one core, with every session interleaved
+int benchmarkSessions() {
+    const int numSessions = 20000;
+    const int numRounds = 40;
+    size_t residentBefore = residentBytes();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<GameSession>> sessions;
+    sessions.reserve(numSessions);
+    for (int i = 0; i < numSessions; ++i) {
+        sessions.emplace_back(new GameSession(defaultCharacters, defaultWeapons, defaultRooms));
+        sessions.back()->deal({"Ann", "Bob", "Cat", "Dan"}, 0, i);
+        sessions.back()->takeOutput();
+    }
+    double createSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t residentAfter = residentBytes();
+    size_t ownedBytes = 0;
+    for (const auto& session : sessions) {
+        ownedBytes += session->memoryUsage();
+    }
 
-    deck.erase(deck.begin(), deck.begin() + 3); // Remove solution cards from the deck
+    // Each player in turn moves, suggests, checks their notes or passes, one line at a time
+    std::mt19937 rng(7);
+    long long events = 0;
+    size_t outputBytes = 0;
+    const int steps[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < numRounds; ++round) {
+        for (auto& session : sessions) {
+            if (session->over()) {
+                continue;
+            }
+            const Player& player = session->players[session->current];
+            std::vector<std::string> lines;
+            int action = static_cast<int>(rng() % 10);
+            if (action < 6) {
+                const int* step = steps[rng() % 4];
+                lines = {"1", std::to_string(player.row + step[0]), std::to_string(player.col + step[1])};
+            } else if (action < 8) {
+                lines = {"2", defaultCharacters[rng() % defaultCharacters.size()].name, defaultWeapons[rng() % defaultWeapons.size()].name, defaultRooms[rng() % defaultRooms.size()].name};
+            } else if (action < 9) {
+                lines = {"4"};
+            } else {
+                lines = {"5"};
+            }
+            for (const std::string& line : lines) {
+                session->handleInput(line);
+                events++;
+            }
+            outputBytes += session->takeOutput().size();
+        }
+    }
+    double playSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    // Create players
-    players.clear();
-    checklists.clear();
-    for (int i = 0; i < numPlayers; ++i) {
-        Player newPlayer;
-        std::cout << "Enter name for player " << i + 1 << ": ";
-        std::cin >> newPlayer.name;
+    std::cout << numSessions << " sessions of 4 players sharing " << boardCache().boards.size() << " board(s)\n";
+    std::cout << "Setup: " << createSeconds * 1e6 / numSessions << " us per session, ~" << ownedBytes / numSessions << " bytes owned per session, "
+              << (residentAfter > residentBefore ? (residentAfter - residentBefore) / numSessions : 0) << " bytes resident per session\n";
+    std::cout << "Play: " << events << " input lines in " << playSeconds << " s on one thread = " << static_cast<long long>(events / playSeconds)
+              << " lines/s per core (" << outputBytes / std::max(1LL, events) << " bytes of output per line)\n";
+    return 0;
+}
 
-        // Check if characters is empty before accessing it
-        if (!characters.empty()) {
-            newPlayer.character = characters[i % characters.size()].name; // Assign characters in order for now
+// Function to benchmark game records: recording a long game, replaying it from the start,
+// seeking with and without snapshots, and scanning the mapped record for bulk statistics
+int benchmarkReplay() {
+    const int numTurns = 6000;
+    std::string path = "/tmp/clue-bench-" + std::to_string(getpid()) + ".cluerec";
+
+    // A long game of six people who move, suggest and pass but never accuse
+    GameSession game(defaultCharacters, defaultWeapons, defaultRooms);
+    game.recorder.reset(new GameRecorder());
+    if (!game.recorder->open(path)) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return 1;
+    }
+    game.deal({"Ann", "Bob", "Cat", "Dan", "Eve", "Fay"}, 0, 42);
+    std::mt19937 rng(7);
+    const int steps[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (game.turnsPlayed < numTurns) {
+        const Player& player = game.players[game.current];
+        std::vector<std::string> lines;
+        int action = static_cast<int>(rng() % 10);
+        if (action < 6) {
+            const int* step = steps[rng() % 4];
+            lines = {"1", std::to_string(player.row + step[0]), std::to_string(player.col + step[1])};
+        } else if (action < 9) {
+            lines = {"2", defaultCharacters[rng() % defaultCharacters.size()].name, defaultWeapons[rng() % defaultWeapons.size()].name, defaultRooms[rng() % defaultRooms.size()].name};
         } else {
-            std::cerr << "Error: No characters available." << std::endl;
-            throw std::runtime_error("No characters available.");
+            lines = {"5"};
         }
-
-        // Assign initial locations (starting rooms) - use the first 3 rooms
-        if (llmRooms.size() >= 3) {
-            newPlayer.row = 0;
-            newPlayer.col = i;
-            //newPlayer.location = "Hall-" + llmRooms[i % 3]; // Assign to a hallway
-        } else {
-            newPlayer.row = 0;
-            newPlayer.col = 0;
-            //newPlayer.location = "Hall"; // Default if not enough rooms
+        for (const std::string& line : lines) {
+            game.handleInput(line);
         }
-        
-        players.push_back(newPlayer);
-        checklists.emplace_back(characters, weapons, rooms); // Initialize checklist for each player
+        game.takeOutput();
     }
-
-	std::cout << "Number of rooms: " << rooms.size() << std::endl; // ADDED DEBUGGING
-
-    // Deal the remaining cards to the players
-    int playerIndex = 0;
-    for (Card& card : deck) {
-        players[playerIndex].hand.push_back(card.name);
-		checklists[playerIndex].markKnown(card.name);
-        playerIndex = (playerIndex + 1) % numPlayers;
+    double recordSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    game.recorder->close();
+    GameSession::TurnState finalState = game.saveState();
+
+    GameReplay replay(path, 32);
+    start = std::chrono::steady_clock::now();
+    GameSession& replayed = replay.seek(replay.turns());
+    double fullSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bool matches = replay.turns() == numTurns;
+    for (size_t p = 0; p < finalState.players.size(); ++p) {
+        matches = matches && replayed.players[p].row == finalState.players[p].row && replayed.players[p].col == finalState.players[p].col
+                  && replayed.checklists[p].deduction.has == finalState.checklists[p].deduction.has && replayed.checklists[p].deduction.hasNot == finalState.checklists[p].deduction.hasNot;
     }
 
-    board.displayBoard(players); // Display initial board state
+    // Random seeks, with snapshots every 32 turns and from the start of the game
+    const int numSeeks = 200;
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < numSeeks; ++s) {
+        replay.seek(rng() % (numTurns + 1));
+    }
+    double seekSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / numSeeks;
+    GameReplay unindexed(path, numTurns + 1);
+    const int numSlowSeeks = 5;
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < numSlowSeeks; ++s) {
+        unindexed.seek(0);
+        unindexed.seek(numTurns / 2 + rng() % (numTurns / 2));
+    }
+    double slowSeekSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / numSlowSeeks;
+
+    // Bulk analysis: decode every event straight from the mapping, without replaying
+    long long events = 0;
+    long long disproved = 0;
+    const int scans = 50;
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < scans; ++pass) {
+        RecordReader reader(replay.data + replay.turnOffsets[0], replay.data + replay.size);
+        GameEvent event;
+        while (reader.next(event)) {
+            events++;
+            disproved += event.kind == GameEvent::Suggestion && event.shown >= 0;
+        }
+    }
+    double scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    unlink(path.c_str());
+
+    size_t eventBytes = replay.size - replay.turnOffsets[0];
+    std::cout << "Record: " << numTurns << " turns, " << events / scans << " events in " << replay.size << " bytes (" << replay.turnOffsets[0] << " header, "
+              << static_cast<double>(eventBytes) / (events / scans) << " bytes per event); playing and recording took " << recordSeconds << " s\n";
+    std::cout << "Replay from the start: " << fullSeconds * 1e3 << " ms (" << static_cast<long long>(numTurns / fullSeconds) << " turns/s), final state "
+              << (matches ? "matches" : "DOES NOT MATCH") << " the live game\n";
+    std::cout << "Seek to a random turn: " << seekSeconds * 1e6 << " us with snapshots every 32 turns (" << replay.snapshots.size() << " snapshots), "
+              << slowSeekSeconds * 1e6 << " us replaying from the start\n";
+    std::cout << "Scan of the mapped record: " << static_cast<long long>(events / scanSeconds) << " events/s (" << disproved / scans << " suggestions disproved)\n";
+    return matches ? 0 : 1;
 }
 
-// Function to get the player's move
-void getPlayerMove(Player& player, int playerIndex) {
-    std::cout << "\n" << player.name << ", what would you like to do?\n";
-    std::cout << "1. Move\n";
-    std::cout << "2. Make a suggestion\n";
-    std::cout << "3. Make an accusation\n";
-    std::cout << "4. Show Checklist\n";
-    std::cout << "5. End turn\n";
-
-    int choice;
-    std::cin >> choice;
-    std::cin.ignore(); // Consume the newline character
+// Function to benchmark saving and loading a game in progress, as done after every turn
+int benchmarkSnapshot() {
+    std::string path = "/tmp/clue-bench-" + std::to_string(getpid()) + ".cluesave";
+    GameSession game(defaultCharacters, defaultWeapons, defaultRooms);
+    game.theme = "Benchmark";
+    game.deal({"Ann", "Bob", "Cat", "Dan", "Eve", "Fay"}, 0, 42);
+    std::mt19937 rng(7);
+    std::string buffer;
+    const int numTurns = 600;
+    long long saves = 0;
+    double saveSeconds = 0;
+    double loadSeconds = 0;
+    bool matches = true;
+    while (game.turnsPlayed < numTurns) {
+        const Player& player = game.players[game.current];
+        if (rng() % 2) {
+            game.handleInput("1");
+            game.handleInput(std::to_string(player.row + 1));
+            game.handleInput(std::to_string(player.col));
+        } else {
+            game.handleInput("2");
+            game.handleInput(defaultCharacters[rng() % defaultCharacters.size()].name);
+            game.handleInput(defaultWeapons[rng() % defaultWeapons.size()].name);
+            game.handleInput(defaultRooms[rng() % defaultRooms.size()].name);
+        }
+        game.takeOutput();
 
-    switch (choice) {
-        case 1: { // Move
-            std::cout << "Enter the row you want to move to: ";
-            int newRow;
-            std::cin >> newRow;
-            std::cout << "Enter the column you want to move to: ";
-            int newCol;
-            std::cin >> newCol;
-
-            if (board.isValidMove(player.row, player.col, newRow, newCol)) {
-                player.row = newRow;
-                player.col = newCol;
-                std::cout << "You moved to row " << newRow << ", column " << newCol << std::endl;
-            } else {
-                std::cout << "Invalid move.\n";
+        // Save after every turn, and load every 20th save back
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!saveGameSnapshot(game, path, buffer)) {
+            return 1;
+        }
+        saveSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (saves++ % 20 == 0) {
+            start = std::chrono::steady_clock::now();
+            std::unique_ptr<GameSession> loaded = loadGameSnapshot(path);
+            loadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for (size_t p = 0; p < game.players.size(); ++p) {
+                matches = matches && loaded->players[p].row == game.players[p].row && loaded->checklists[p].deduction.has == game.checklists[p].deduction.has
+                          && loaded->checklists[p].deduction.clauses == game.checklists[p].deduction.clauses;
             }
-            break;
         }
-        case 2: { // Suggestion
-            std::cout << "Make a suggestion (Character, Weapon, Room):\n";
-            std::string character, weapon, room;
+    }
+    unlink(path.c_str());
+    std::cout << "Save after each of " << saves << " turns: " << saveSeconds / saves * 1e6 << " us per save, " << buffer.size() << " bytes at the end\n";
+    std::cout << "Load: " << loadSeconds / ((saves + 19) / 20) * 1e6 << " us per load, state " << (matches ? "matches" : "DOES NOT MATCH") << " the live game\n";
+    return matches ? 0 : 1;
+}
 
-            std::cout << "Character: ";
-            std::getline(std::cin, character);
-            std::cout << "Weapon: ";
-            std::getline(std::cin, weapon);
-            std::cout << "Room: ";
-            std::getline(std::cin, room);
+// Function to encode an RGB image as a PNG without row filters, for benchmark inputs
+std::string encodePng(const RgbImage& image) {
+    std::string raw;
+    size_t rowBytes = static_cast<size_t>(image.width) * 3;
+    for (int y = 0; y < image.height; ++y) {
+        raw += '\0';
+        raw.append(reinterpret_cast<const char*>(&image.pixels[y * rowBytes]), rowBytes);
+    }
+    std::string compressed(compressBound(raw.size()), '\0');
+    uLongf compressedSize = compressed.size();
+    compress2(reinterpret_cast<Bytef*>(&compressed[0]), &compressedSize, reinterpret_cast<const Bytef*>(raw.data()), raw.size(), 6);
+    compressed.resize(compressedSize);
+    std::string png("\x89PNG\r\n\x1a\n", 8);
+    auto appendChunk = [&png](const char* type, const std::string& body) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            png += static_cast<char>(body.size() >> shift & 0xff);
+        }
+        std::string typed = std::string(type, 4) + body;
+        png += typed;
+        uLong crc = crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(typed.data()), typed.size());
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            png += static_cast<char>(crc >> shift & 0xff);
+        }
+    };
+    std::string header;
+    for (uint32_t value : {static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height)}) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            header += static_cast<char>(value >> shift & 0xff);
+        }
+    }
+    header += std::string("\x08\x02\x00\x00\x00", 5); // 8-bit RGB, not interlaced
+    appendChunk("IHDR", header);
+    appendChunk("IDAT", compressed);
+    appendChunk("IEND", "");
+    return png;
+}
 
-            std::cout << "You suggested it was " << character << " with the " << weapon << " in the " << room << std::endl;
-            // TODO: Implement disproving the suggestion
-            break;
+// Function to benchmark image previews at 512x512 and 1024x1024: PNG decoding, shrinking with and
+// without SSE2, drawing with half blocks, and showing a preview again from the cache
+int benchmarkPreview() {
+    std::string directory = "/tmp/clue-bench-" + std::to_string(getpid()) + "/";
+    std::string savedImageRoot = imageRoot;
+    imageRoot = directory;
+    mkdir(directory.c_str(), 0755);
+    mkdir((directory + "rooms/").c_str(), 0755);
+    const int termCols = 160;
+    const int termRows = 48;
+    bool same = true;
+    std::mt19937_64 rng(11);
+    for (int side : {512, 1024}) {
+        // A smooth scene with some noise, which compresses about like a render
+        RgbImage source;
+        source.width = source.height = side;
+        source.pixels.resize(static_cast<size_t>(side) * side * 3);
+        for (int y = 0; y < side; ++y) {
+            for (int x = 0; x < side; ++x) {
+                uint8_t* pixel = &source.pixels[(static_cast<size_t>(y) * side + x) * 3];
+                pixel[0] = static_cast<uint8_t>(x * 255 / side + rng() % 16);
+                pixel[1] = static_cast<uint8_t>(y * 255 / side + rng() % 16);
+                pixel[2] = static_cast<uint8_t>((x ^ y) & 0x7f);
+            }
         }
-        case 3: { // Accusation
-            std::cout << "Accusation not implemented yet.\n";
-            break;
+        std::string png = encodePng(source);
+        std::string name = "Bench " + std::to_string(side);
+        std::ofstream(directory + "rooms/" + name + ".png", std::ios::binary) << png;
+
+        const int decodes = 20;
+        RgbImage decoded;
+        std::string error;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < decodes; ++i) {
+            if (!decodePng(reinterpret_cast<const unsigned char*>(png.data()), png.size(), decoded, error)) {
+                std::cerr << "Decode failed: " << error << std::endl;
+                return 1;
+            }
         }
-        case 4: { // Show Checklist
-            checklists[playerIndex].display(characters, weapons, rooms);
-            break;
+        double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / decodes;
+        same = same && decoded.pixels == source.pixels;
+
+        int columns;
+        int lines;
+        previewSize(side, side, std::min(termCols - 1, 64), std::max(4, termRows / 3), columns, lines);
+        const int resizes = 50;
+        double resizeSeconds[2];
+        RgbImage small[2];
+        for (int vectorized = 0; vectorized < 2; ++vectorized) {
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < resizes; ++i) {
+                downscaleArea(decoded, columns, lines * 2, small[vectorized], vectorized != 0);
+            }
+            resizeSeconds[vectorized] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / resizes;
         }
-        case 5: { // End turn
-            std::cout << "Ending turn.\n";
-            break;
+        same = same && small[0].pixels == small[1].pixels;
+
+        start = std::chrono::steady_clock::now();
+        std::string text;
+        for (int i = 0; i < resizes; ++i) {
+            text = halfBlockText(small[1], true);
         }
-        default: {
-            std::cout << "Invalid choice.\n";
-            break;
+        double drawSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / resizes;
+
+        // What the game does: the first showing builds the preview, later ones find it cached
+        ImagePreview previews;
+        start = std::chrono::steady_clock::now();
+        size_t bytes = previews.preview("room", name, termCols, termRows).size();
+        double firstSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const int repeats = 10000;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; ++i) {
+            bytes = previews.preview("room", name, termCols, termRows).size();
         }
+        double repeatSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+        std::cout << side << "x" << side << " PNG (" << png.size() / 1024 << " KB) to " << columns << "x" << lines << " cells:\n";
+        std::cout << "  Decode: " << decodeSeconds * 1e3 << " ms\n";
+#ifdef __SSE2__
+        std::cout << "  Area downscale: " << resizeSeconds[0] * 1e3 << " ms scalar, " << resizeSeconds[1] * 1e3 << " ms SSE2 (" << resizeSeconds[0] / resizeSeconds[1] << "x)\n";
+#else
+        std::cout << "  Area downscale: " << resizeSeconds[0] * 1e3 << " ms (built without SSE2)\n";
+#endif
+        std::cout << "  Half-block text: " << drawSeconds * 1e6 << " us, " << text.size() << " bytes\n";
+        std::cout << "  Preview: " << firstSeconds * 1e3 << " ms the first time, " << repeatSeconds * 1e6 << " us from the cache (" << bytes << " bytes)\n";
     }
+    std::cout << "Decoded and downscaled pixels " << (same ? "match" : "DO NOT MATCH") << " the reference\n";
+    imageRoot = savedImageRoot;
+    std::string cleanup = "rm -rf \"" + directory + "\"";
+    return system(cleanup.c_str()) == 0 && same ? 0 : 1;
 }
 
-void playGame() {
-    bool gameWon = false;
-    while (!gameWon) {
-        for (size_t i = 0; i < players.size(); ++i) {
-            if (!players[i].eliminated) {
-                std::cout << "\n" << players[i].name << "'s turn (" << players[i].character << "):\n";
-                std::cout << "Current location: Row " << players[i].row << ", Column " << players[i].col << "\n";
+// Function to benchmark theme packs: writing one with 21 cards and their images, then mapping it
+// and reading every image as a game start does, and checking the content hashes
+int benchmarkThemePack() {
+    std::string directory = "/tmp/clue-bench-" + std::to_string(getpid());
+    mkdir(directory.c_str(), 0755);
+    ThemeContent content;
+    content.theme = "Benchmark Manor";
+    std::mt19937_64 rng(7);
+    const size_t imageBytes = 400 * 1024; // About a 512x512 PNG
+    for (int type = 0; type < 3; ++type) {
+        std::vector<std::string>& list = type == 0 ? content.characters : type == 1 ? content.weapons : content.rooms;
+        for (int i = 0; i < (type == 2 ? 9 : 6); ++i) {
+            std::string name = std::string(type == 0 ? "Character " : type == 1 ? "Weapon " : "Room ") + std::to_string(i + 1);
+            std::string filename = directory + "/" + std::to_string(type) + "-" + std::to_string(i) + ".png";
+            std::string image(imageBytes, '\0');
+            for (char& byte : image) {
+                byte = static_cast<char>(rng());
+            }
+            std::ofstream(filename, std::ios::binary).write(image.data(), image.size());
+            list.push_back(name);
+            content.assets.push_back({type == 0 ? AssetKind::Character : type == 1 ? AssetKind::Weapon : AssetKind::Room, name, "A description of " + name, filename});
+        }
+    }
+    std::string path = directory + "/bench.cluepack";
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!writeThemePack(content, path)) {
+        return 1;
+    }
+    double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // What a game start does: map the pack, list the cards and find every image
+    const int opens = 200;
+    size_t imageTotal = 0;
+    start = std::chrono::steady_clock::now();
+    for (int o = 0; o < opens; ++o) {
+        ThemePack pack(path);
+        for (const char* type : {"character", "weapon", "room"}) {
+            for (const std::string& name : pack.names(type)) {
+                imageTotal += pack.image(type, name).second;
+            }
+        }
+    }
+    double openSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / opens;
+
+    ThemePack pack(path);
+    start = std::chrono::steady_clock::now();
+    std::string corrupt = pack.firstCorruptEntry();
+    double verifySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Pack: " << pack.numEntries << " cards in " << pack.size << " bytes, written in " << writeSeconds * 1e3 << " ms\n";
+    std::cout << "Start from the pack (map, list cards, find " << imageTotal / opens / imageBytes << " images): " << openSeconds * 1e6 << " us\n";
+    std::cout << "Hash check of every entry: " << verifySeconds * 1e3 << " ms (" << pack.size / verifySeconds / 1e6 << " MB/s), "
+              << (corrupt.empty() ? "all entries intact" : "corrupt entry " + corrupt) << "\n";
+    std::string cleanup = "rm -rf \"" + directory + "\"";
+    return system(cleanup.c_str()) == 0 && corrupt.empty() ? 0 : 1;
+}
 
-                // Display player's hand (for debugging)
-                std::cout << "Your hand: ";
-                for (const std::string& card : players[i].hand) {
-                    std::cout << card << ", ";
+// Function to benchmark the theme bank: filling one with thousands of themes, reading it back
+// as a game start does, and timing exact, prefix and misspelt theme lookups
+int benchmarkThemeBank() {
+    std::string directory = "/tmp/clue-bench-" + std::to_string(getpid());
+    static const char* adjectives[] = {"haunted", "sunken", "frozen", "neon", "victorian", "orbital", "desert", "clockwork", "jungle", "royal"};
+    static const char* places[] = {"mansion", "submarine", "station", "carnival", "library", "monastery", "casino", "lighthouse", "museum", "circus"};
+    static const char* eras[] = {"", " in 1920", " of the future", " at midnight", " under the sea", " on mars", " in winter", " of pirates", " in tokyo", " of wizards",
+                                 " at war", " for spies", " in the alps", " of ghosts", " in space", " by the river", " of kings", " in ruins", " of robots", " on ice"};
+    ThemeBank writer;
+    writer.directory = directory;
+    int themes = 0;
+    int records = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const char* adjective : adjectives) {
+        for (const char* place : places) {
+            for (const char* era : eras) {
+                std::string theme = std::string(adjective) + " " + place + era;
+                for (int type = 0; type < 3; ++type) {
+                    std::vector<std::string> cards;
+                    for (int i = 0; i < (type == ThemeBank::Room ? 9 : 6); ++i) {
+                        cards.push_back(std::string(place) + " card " + std::to_string(type) + "-" + std::to_string(i));
+                        writer.storeDescription(theme, static_cast<ThemeBank::CardType>(type), cards.back(), cards.back() + ", " + adjective + ", centered in frame");
+                    }
+                    writer.storeList(theme, static_cast<ThemeBank::CardType>(type), cards);
+                    records += 1 + static_cast<int>(cards.size());
                 }
-                std::cout << std::endl;
-
-                getPlayerMove(players[i], i); // Get the player's move
+                themes++;
+            }
+        }
+    }
+    double storeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // What a game start does: read and index the log, then look up its theme
+    ThemeBank reader;
+    reader.directory = directory;
+    reader.verbose = false;
+    start = std::chrono::steady_clock::now();
+    size_t loaded = reader.themeCount();
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Stored " << records << " records for " << themes << " themes in " << storeSeconds * 1e3 << " ms ("
+              << storeSeconds / records * 1e6 << " us per record)\n";
+    std::cout << "Read and indexed " << loaded << " themes in " << loadSeconds * 1e3 << " ms\n";
+    int result = reader.printStats();
+    start = std::chrono::steady_clock::now();
+    const int starts = 1000;
+    size_t cards = 0;
+    for (int s = 0; s < starts; ++s) {
+        std::string theme = std::string(adjectives[s % 10]) + " " + places[s / 10 % 10];
+        for (int type = 0; type < 3; ++type) {
+            for (const std::string& card : reader.list(theme, static_cast<ThemeBank::CardType>(type))) {
+                cards += !reader.description(theme, static_cast<ThemeBank::CardType>(type), card).empty();
             }
-            board.displayBoard(players); // Display board state after each turn
         }
+    }
+    double serveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / starts;
+    std::cout << "Serving a game's 3 lists and " << cards / starts << " descriptions: " << serveSeconds * 1e6 << " us\n";
+    std::string cleanup = "rm -rf \"" + directory + "\"";
+    return system(cleanup.c_str()) == 0 && loaded == static_cast<size_t>(themes) ? result : 1;
+}
 
-        // Check for a winner (if only one player is not eliminated)
-        int activePlayers = 0;
-        for (const Player& player : players) {
-            if (!player.eliminated) {
-                activePlayers++;
+// Function to run a named benchmark
+int runBenchmark(const std::string& name) {
+    if (name == "board") {
+        return benchmarkBoard();
+    }
+    if (name == "paths") {
+        return benchmarkPaths(Board(defaultRooms));
+    }
+    if (name == "layout") {
+        return benchmarkLayout();
+    }
+    if (name == "render") {
+        return benchmarkRender();
+    }
+    if (name == "disprove") {
+        return benchmarkDisprove();
+    }
+    if (name == "deduce") {
+        return benchmarkDeduce();
+    }
+    if (name == "ai") {
+        return benchmarkAi();
+    }
+    if (name == "sessions") {
+        return benchmarkSessions();
+    }
+    if (name == "replay") {
+        return benchmarkReplay();
+    }
+    if (name == "snapshot") {
+        return benchmarkSnapshot();
+    }
+    if (name == "themepack") {
+        return benchmarkThemePack();
+    }
+    if (name == "themebank") {
+        return benchmarkThemeBank();
+    }
+    if (name == "preview") {
+        return benchmarkPreview();
+    }
+    std::cerr << "Unknown benchmark: " << name << std::endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    long long simulateGames = 0;
+    int simulateThreads = std::max(1u, std::thread::hardware_concurrency());
+    int simulatePlayers = 4;
+    long long simulateSamples = 4000; // Bots in bulk games sample less than interactive ones
+    int servePort = 0;
+    std::string replayPath;
+    std::string resumePath;
+    std::string buildPackPath;
+    bool runThemeFarm = false;
+    bool showPoolStats = false;
+    bool showBankStats = false;
+    std::string packTheme;
+    long long replayTurn = -1;
+
+    // Parse command line options
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--asset-budget" && i + 1 < argc) {
+            try {
+                assetBudgetSeconds = std::stod(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Invalid --asset-budget, rendering without a budget." << std::endl;
+            }
+        } else if (arg == "--bench" && i + 1 < argc) {
+            return runBenchmark(argv[++i]);
+        } else if (arg == "--render-timeout" && i + 1 < argc) {
+            renderTimeoutSeconds = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--progressive-images") {
+            progressiveImages = true;
+        } else if (arg == "--render-jobs" && i + 1 < argc) {
+            renderJobs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--no-dashboard") {
+            setupDashboard.enabled = false;
+        } else if (arg == "--no-image-preview") {
+            imagePreview.enabled = false;
+        } else if (arg == "--simulate" && i + 1 < argc) {
+            simulateGames = std::atoll(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            gameSeed = std::strtoull(argv[++i], nullptr, 10);
+            haveGameSeed = true;
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--theme-pack" && i + 1 < argc) {
+            try {
+                themePack.reset(new ThemePack(argv[++i]));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        } else if (arg == "--build-theme-pack" && i + 1 < argc) {
+            buildPackPath = argv[++i];
+        } else if (arg == "--theme-pool" && i + 1 < argc) {
+            if (!themePool) {
+                themePool.reset(new ThemePool());
+            }
+            themePool->directory = argv[++i];
+        } else if (arg == "--pool-size" && i + 1 < argc) {
+            if (!themePool) {
+                themePool.reset(new ThemePool());
+            }
+            themePool->target = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--theme-farm") {
+            runThemeFarm = true;
+        } else if (arg == "--pool-stats") {
+            showPoolStats = true;
+        } else if (arg == "--llm-config" && i + 1 < argc) {
+            try {
+                llmRouter.load(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        } else if (arg == "--llm-log" && i + 1 < argc) {
+            llmRouter.logPath = argv[++i];
+        } else if (arg == "--llm-stats") {
+            atexit([]() { llmRouter.printStats(std::cerr); });
+        } else if (arg == "--theme-bank" && i + 1 < argc) {
+            themeBank.directory = argv[++i];
+        } else if (arg == "--no-theme-bank") {
+            themeBank.enabled = false;
+        } else if (arg == "--bank-stats") {
+            showBankStats = true;
+        } else if (arg == "--theme" && i + 1 < argc) {
+            packTheme = argv[++i];
+        } else if (arg == "--save" && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (arg == "--resume" && i + 1 < argc) {
+            resumePath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--turn" && i + 1 < argc) {
+            replayTurn = std::max(0LL, std::atoll(argv[++i]));
+        } else if (arg == "--serve" && i + 1 < argc) {
+            servePort = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            simulateThreads = std::atoi(argv[++i]);
+        } else if (arg == "--players" && i + 1 < argc) {
+            simulatePlayers = std::atoi(argv[++i]);
+        } else if (arg == "--samples" && i + 1 < argc) {
+            solutionSolver.samples = std::max(1LL, std::atoll(argv[++i]));
+            simulateSamples = solutionSolver.samples;
+        } else if (arg == "--bots" && i + 1 < argc) {
+            numBots = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--risk" && i + 1 < argc) {
+            try {
+                accusationThreshold = std::stod(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Invalid --risk, bots keep accusing at " << accusationThreshold << "." << std::endl;
             }
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (simulateGames > 0) {
+        return runSimulation(simulateGames, simulateThreads, simulatePlayers, accusationThreshold, simulateSamples);
+    }
+    if (!replayPath.empty()) {
+        return showReplay(replayPath, replayTurn);
+    }
+    if (!buildPackPath.empty()) {
+        return buildThemePack(buildPackPath, packTheme);
+    }
+    if (showBankStats) {
+        return themeBank.printStats();
+    }
+    if ((runThemeFarm || showPoolStats || themePool) && (!themePool || themePool->directory.empty())) {
+        std::cerr << "--theme-farm, --pool-stats and --pool-size need --theme-pool DIR." << std::endl;
+        return 1;
+    }
+    if (showPoolStats) {
+        return themePool->printStats();
+    }
+    if (runThemeFarm) {
+        // Keep the pool full for as long as this runs, checking every half minute
+        setpriority(PRIO_PROCESS, 0, 19);
+        while (true) {
+            themePool->refill();
+            std::this_thread::sleep_for(std::chrono::seconds(30));
         }
-        if (activePlayers <= 1) {
-            gameWon = true;
-            std::cout << "Game over!\n";
-            // Determine the winner (or declare a tie)
+    }
+    if (!resumePath.empty()) {
+        // Pick up a saved game where it stopped, without the theme and asset setup
+        try {
+            std::unique_ptr<GameSession> session = loadGameSnapshot(resumePath);
+            if (savePath.empty()) {
+                savePath = resumePath;
+            }
+            std::cout << "Resuming " << (session->theme.empty() ? "the game" : "the " + session->theme + " game") << " at turn " << session->turnsPlayed << "." << std::endl;
+            boardRenderer.draw(*session->board, session->players);
+            playGame(*session);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
         }
+        return 0;
+    }
+    if (servePort > 0) {
+        ClueServer server;
+        server.botsPerTable = std::min(numBots, std::max(0, simulatePlayers - 1));
+        server.humansPerTable = std::max(1, simulatePlayers - server.botsPerTable);
+        server.risk = accusationThreshold;
+        server.solver.threads = 1;
+        server.solver.samples = simulateSamples;
+        return server.run(servePort);
     }
-}
 
-int main() {
     // Get the game theme from the LLM
 
     int numPlayers;
@@ -989,8 +7926,8 @@ int main() {
     std::cin.ignore(); // Consume the newline character
 
     try {
-        initializeGame(numPlayers);
-        playGame();
+        std::unique_ptr<GameSession> session = initializeGame(numPlayers);
+        playGame(*session);
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1; // Exit the program with an error code
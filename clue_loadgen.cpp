@@ -0,0 +1,246 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// Load generator for `clue --serve`: opens many connections to the server from one thread, has each
+// join a table and play random but legal-looking turns as fast as the server answers, and reports
+// throughput and turn latency. Every finished game is followed by a JOIN for the next one.
+
+// One simulated player
+struct Client {
+    int fd = -1;
+    std::string in; // Bytes received that do not make a full line yet
+    std::string out; // Bytes the socket has not taken yet
+    int seat = -1;
+    int row = 0;
+    int col = 0;
+    std::vector<std::string> cards[3]; // Characters, weapons and rooms in play
+    std::chrono::steady_clock::time_point sentAt; // When the last turn was sent
+    bool waiting = false; // Whether a turn is in flight
+};
+
+struct LoadStats {
+    long long turns = 0;
+    long long gamesFinished = 0;
+    long long errors = 0;
+    long long bytesReceived = 0;
+    std::vector<long long> latencyMicros; // Turn sent to next TURN or OVER seen by the sender
+};
+
+// Function to queue a command and try to send it at once
+void sendLine(Client& client, const std::string& line) {
+    client.out += line + "\n";
+    ssize_t sent = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+    if (sent > 0) {
+        client.out.erase(0, sent);
+    }
+}
+
+// Function to play one random turn: mostly moves, some suggestions, rare accusations
+void playTurn(Client& client, std::mt19937_64& rng) {
+    int roll = static_cast<int>(rng() % 100);
+    bool haveCards = !client.cards[0].empty() && !client.cards[1].empty() && !client.cards[2].empty();
+    if (roll < 60 || !haveCards) {
+        static const int steps[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        const int* step = steps[rng() % 4];
+        sendLine(client, "MOVE " + std::to_string(client.row + step[0]) + " " + std::to_string(client.col + step[1]));
+    } else if (roll < 90) {
+        sendLine(client, "SUGGEST " + client.cards[0][rng() % client.cards[0].size()] + "," + client.cards[1][rng() % client.cards[1].size()] + "," + client.cards[2][rng() % client.cards[2].size()]);
+    } else if (roll < 97) {
+        sendLine(client, "PASS");
+    } else {
+        sendLine(client, "ACCUSE " + client.cards[0][rng() % client.cards[0].size()] + "," + client.cards[1][rng() % client.cards[1].size()] + "," + client.cards[2][rng() % client.cards[2].size()]);
+    }
+    client.sentAt = std::chrono::steady_clock::now();
+    client.waiting = true;
+}
+
+// Function to record the latency of the client's turn in flight, if any
+void finishTurn(Client& client, LoadStats& stats) {
+    if (client.waiting) {
+        client.waiting = false;
+        stats.turns++;
+        stats.latencyMicros.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - client.sentAt).count());
+    }
+}
+
+// Function to react to one line from the server
+void handleLine(Client& client, const std::string& line, std::mt19937_64& rng, LoadStats& stats) {
+    std::istringstream words(line);
+    std::string kind;
+    words >> kind;
+    if (kind == "SEAT") {
+        int table;
+        words >> table >> client.seat;
+    } else if (kind == "BOARD") {
+        for (std::vector<std::string>& group : client.cards) {
+            group.clear();
+        }
+    } else if (kind == "CARD") {
+        std::string type, name;
+        words >> type;
+        std::getline(words >> std::ws, name);
+        int category = type == "character" ? 0 : type == "weapon" ? 1 : 2;
+        client.cards[category].push_back(name);
+    } else if (kind == "POS") {
+        int seat, row, col;
+        words >> seat >> row >> col;
+        if (seat == client.seat) {
+            client.row = row;
+            client.col = col;
+        }
+    } else if (kind == "TURN") {
+        int seat;
+        words >> seat;
+        finishTurn(client, stats);
+        if (seat == client.seat) {
+            playTurn(client, rng);
+        }
+    } else if (kind == "OVER") {
+        finishTurn(client, stats);
+        stats.gamesFinished++;
+        client.seat = -1;
+        sendLine(client, "JOIN load-" + std::to_string(client.fd));
+    } else if (kind == "ERR") {
+        stats.errors++;
+    }
+}
+
+// Function to connect a non-blocking socket to the server
+int connectTo(const sockaddr_in& address) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Function to read a percentile from sorted latencies
+long long percentile(const std::vector<long long>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+int main(int argc, char* argv[]) {
+    std::string host = "127.0.0.1";
+    int port = 5555;
+    int numClients = 200;
+    double seconds = 10;
+
+    // Parse command line options
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--host" && i + 1 < argc) {
+            host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = std::atoi(argv[++i]);
+        } else if (arg == "--clients" && i + 1 < argc) {
+            numClients = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Usage: clue_loadgen [--host ADDRESS] [--port PORT] [--clients N] [--seconds S]" << std::endl;
+            return 1;
+        }
+    }
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "Invalid host address: " << host << std::endl;
+        return 1;
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Client> clients(numClients);
+    std::vector<int> clientOfFd;
+    for (int c = 0; c < numClients; ++c) {
+        int fd = connectTo(address);
+        if (fd < 0) {
+            std::cerr << "Cannot connect client " << c << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        clients[c].fd = fd;
+        if (fd >= static_cast<int>(clientOfFd.size())) {
+            clientOfFd.resize(fd + 1, -1);
+        }
+        clientOfFd[fd] = c;
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        clients[c].out = "JOIN load-" + std::to_string(fd) + "\n"; // Sent once the connection is up
+    }
+
+    std::mt19937_64 rng(12345);
+    LoadStats stats;
+    int connected = numClients;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point deadline = start + std::chrono::microseconds(static_cast<long long>(seconds * 1e6));
+    epoll_event events[256];
+    char buffer[16384];
+    while (connected > 0 && std::chrono::steady_clock::now() < deadline) {
+        int ready = epoll_wait(epollFd, events, 256, 100);
+        for (int e = 0; e < ready; ++e) {
+            Client& client = clients[clientOfFd[events[e].data.fd]];
+            if (!client.out.empty()) {
+                ssize_t sent = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+                if (sent > 0) {
+                    client.out.erase(0, sent);
+                }
+            }
+            while (true) {
+                ssize_t got = read(client.fd, buffer, sizeof(buffer));
+                if (got > 0) {
+                    stats.bytesReceived += got;
+                    client.in.append(buffer, got);
+                    continue;
+                }
+                if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+                    close(client.fd);
+                    connected--;
+                }
+                break;
+            }
+            size_t lineStart = 0;
+            size_t lineEnd;
+            while ((lineEnd = client.in.find('\n', lineStart)) != std::string::npos) {
+                handleLine(client, client.in.substr(lineStart, lineEnd - lineStart), rng, stats);
+                lineStart = lineEnd + 1;
+            }
+            client.in.erase(0, lineStart);
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(stats.latencyMicros.begin(), stats.latencyMicros.end());
+    std::cout << numClients << " clients (" << connected << " still connected) for " << elapsed << " s" << std::endl;
+    std::cout << "Turns: " << stats.turns << " (" << static_cast<long long>(stats.turns / elapsed) << " per second)" << std::endl;
+    std::cout << "Games finished: " << stats.gamesFinished << " (counted once per player)" << std::endl;
+    std::cout << "Turn latency: p50 " << percentile(stats.latencyMicros, 0.5) << " us, p99 " << percentile(stats.latencyMicros, 0.99) << " us, max " << percentile(stats.latencyMicros, 1.0) << " us" << std::endl;
+    std::cout << "Received: " << stats.bytesReceived / 1024 << " KB, errors: " << stats.errors << std::endl;
+    return connected == numClients ? 0 : 1;
+}
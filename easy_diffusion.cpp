@@ -12,12 +12,30 @@
 #include <future>
 #include <chrono>
 #include <array> // Include array
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <cstring>
+#include <csignal>
 #include <sys/stat.h> // For creating directories
+#include <sys/file.h> // For flock
+#include <sys/ioctl.h> // For reflink copies
+#include <sys/resource.h> // For lowering the priority of refinement renders
+#include <fcntl.h>
+#include <unistd.h>
 #include <libgen.h> // For dirname
+#include <linux/fs.h> // For FICLONE
+#include <openssl/sha.h> // For cache keys
 
 #include <cpprest/http_client.h>
 #include <cpprest/filestream.h>
 #include <cpprest/json.h>
+#include <boost/asio/ip/tcp.hpp> // Socket type behind cpprest's native handle
 
 using namespace std;
 using namespace web;
@@ -25,13 +43,25 @@ using namespace web::http;
 using namespace web::http::client;
 using namespace web::json;
 
-// Define the server address as a constant
+// Define the server address as a constant; renders can be spread over several servers instead
+// with --servers or EASY_DIFFUSION_SERVERS (comma-separated)
 const string SERVER_ADDRESS = "http://localhost:9000";
-const string LLM_SERVER_ADDRESS = "http://localhost:9090/v1"; // Define LLM server address
+const string LLM_SERVER_ADDRESS = "http://localhost:9090/v1"; // Define LLM server address, used without an LLM config
+const string DEFAULT_LLM_MODEL = "llama-3.2-3b-it-q8_0";
+
+// Define where the LLM backend list is read from (overridable with EASY_DIFFUSION_LLM_CONFIG)
+const string DEFAULT_LLM_CONFIG = "llm_backends.conf";
 
 // Define the default stable diffusion model
 const string DEFAULT_STABLE_DIFFUSION_MODEL = "absolutereality_v181";
 
+// Define the render cache location and size limit (overridable with EASY_DIFFUSION_CACHE_DIR and EASY_DIFFUSION_CACHE_MAX_MB)
+const string DEFAULT_RENDER_CACHE_DIR = ".render_cache";
+const unsigned long long DEFAULT_RENDER_CACHE_MAX_BYTES = 1024ULL * 1024 * 1024;
+
+// Define where progressive renders record their latencies (overridable with EASY_DIFFUSION_LATENCY_LOG)
+const string DEFAULT_LATENCY_LOG = "render_latency.jsonl";
+
 // Helper function to execute shell commands and return the output
 string exec(const char* cmd) {
     std::array<char, 128> buffer; // Use std::array to resolve ambiguity
@@ -62,13 +92,86 @@ unsigned int generate_seed() {
     return seed;
 }
 
+// Registry of one long-lived http_client per host. cpprest pools keep-alive connections per
+// client, so sharing them keeps connections warm across /render, /ping, /image/stream and the
+// LLM endpoint, and across every render made by this process.
+struct HttpClientRegistry {
+    struct HostClient {
+        unique_ptr<http_client> client;
+        atomic<unsigned long> requests{0};
+        atomic<unsigned long> connections_opened{0};
+    };
+
+    mutex registry_mutex;
+    map<string, shared_ptr<HostClient>> hosts;
+
+    // Send a request to an absolute URL through the shared client for its host
+    http_response send(const string& url, http_request request) {
+        size_t path_start = path_start_of(url);
+        string base = url.substr(0, path_start);
+        string resource = path_start == string::npos ? "/" : url.substr(path_start);
+
+        request.set_request_uri(U(resource));
+        return client_for(base)->client->request(request).get();
+    }
+
+    // Set the request timeout for a URL's host; takes effect if no request has gone to it yet
+    void set_timeout(const string& url, chrono::milliseconds timeout) {
+        lock_guard<mutex> lock(registry_mutex);
+        timeouts[url.substr(0, path_start_of(url))] = timeout;
+    }
+
+    // Print the request and connection-open counts per host
+    void print_stats(ostream& out) {
+        lock_guard<mutex> lock(registry_mutex);
+        for (const auto& host : hosts) {
+            out << "Connections: " << host.first << " | Requests: " << host.second->requests << " | Opened: " << host.second->connections_opened << endl;
+        }
+    }
+
+private:
+    map<string, chrono::milliseconds> timeouts;
+
+    static size_t path_start_of(const string& url) {
+        size_t scheme_end = url.find("://");
+        return url.find('/', scheme_end == string::npos ? 0 : scheme_end + 3);
+    }
+
+    shared_ptr<HostClient> client_for(const string& base) {
+        lock_guard<mutex> lock(registry_mutex);
+        shared_ptr<HostClient>& host = hosts[base];
+        if (!host) {
+            host = make_shared<HostClient>();
+            HostClient* counters = host.get();
+            bool plain_http = base.compare(0, 7, "http://") == 0;
+            http_client_config config;
+            if (timeouts.count(base)) {
+                config.set_timeout(timeouts[base]);
+            }
+            // cpprest hands us the connection's socket before each request; a socket that is not
+            // open yet is a fresh connection, an open one is being reused
+            config.set_nativehandle_options([counters, plain_http](native_handle handle) {
+                counters->requests++;
+                if (plain_http && !static_cast<boost::asio::ip::tcp::socket*>(handle)->is_open()) {
+                    counters->connections_opened++;
+                }
+            });
+            host->client.reset(new http_client(U(base), config));
+        }
+        return host;
+    }
+};
+
+// Function to get the process-wide client registry
+HttpClientRegistry& http_clients() {
+    static HttpClientRegistry registry;
+    return registry;
+}
+
 // Function to fetch data from a URL
 string fetch_url(const string& url) {
     try {
-        http_client client(U(url));
-        http_request request(methods::GET);
-        pplx::task<http_response> responseTask = client.request(request);
-        http_response response = responseTask.get();
+        http_response response = http_clients().send(url, http_request(methods::GET));
 
         if (response.status_code() == status_codes::OK) {
             pplx::task<string> bodyTask = response.extract_string();
@@ -83,51 +186,197 @@ string fetch_url(const string& url) {
     }
 }
 
-// Function to interact with the LLM server
-string call_llm(const string& system_prompt, const string& user_prompt, double temperature) {
-    try {
-        http_client client(U(LLM_SERVER_ADDRESS + "/chat/completions"));
-        http_request request(methods::POST);
-        request.headers().add("Content-Type", "application/json");
-
-        // Construct the JSON payload
-        json::value payload;
-        payload["model"] = json::value::string("llama-3.2-3b-it-q8_0");
-        payload["messages"] = json::value::array();
-        payload["messages"][0] = json::value::object();
-        payload["messages"][0]["role"] = json::value::string("system");
-        payload["messages"][0]["content"] = json::value::string(system_prompt);
-        payload["messages"][1] = json::value::object();
-        payload["messages"][1]["role"] = json::value::string("user");
-        payload["messages"][1]["content"] = json::value::string(user_prompt);
-        payload["temperature"] = json::value::number(temperature);
-
-        request.set_body(payload.serialize());
-
-        pplx::task<http_response> responseTask = client.request(request);
-        http_response response = responseTask.get();
+// LLM backends from the config file clue also reads: "backend URL [MODEL]" lines plus settings.
+// Each request goes to the backend with the fewest requests in flight and fails over to the next
+// one. A backend that fails failure_threshold times in a row has its circuit opened and is
+// skipped for open_seconds, then gets one trial request. Requests time out after timeout seconds.
+struct LlmBackends {
+    struct Backend {
+        string base; // Up to the /chat/completions path
+        string model;
+        int outstanding = 0;
+        int consecutive_failures = 0;
+        bool open = false;
+        chrono::steady_clock::time_point open_until;
+        unsigned long requests = 0;
+        unsigned long failures = 0;
+        double total_ms = 0; // Over successful requests
+    };
+
+    mutex backends_mutex;
+    vector<Backend> backends;
+    double timeout_seconds = 120;
+    int failure_threshold = 3;
+    double open_seconds = 30;
+
+    LlmBackends() {
+        const char* config_override = getenv("EASY_DIFFUSION_LLM_CONFIG");
+        string config_path = config_override ? config_override : DEFAULT_LLM_CONFIG;
+        ifstream config(config_path);
+        string line;
+        while (getline(config, line)) {
+            istringstream words(line.substr(0, line.find('#')));
+            string key;
+            if (!(words >> key)) {
+                continue;
+            }
+            if (key == "backend") {
+                Backend backend;
+                string word;
+                while (words >> word) {
+                    if (word.compare(0, 7, "health=") == 0) {
+                        continue; // Only clue runs health checks
+                    } else if (backend.base.empty()) {
+                        backend.base = word;
+                    } else {
+                        backend.model = word;
+                    }
+                }
+                const string chat_path = "/chat/completions";
+                if (backend.base.size() >= chat_path.size() && backend.base.compare(backend.base.size() - chat_path.size(), chat_path.size(), chat_path) == 0) {
+                    backend.base.erase(backend.base.size() - chat_path.size());
+                }
+                if (!backend.base.empty()) {
+                    backends.push_back(backend);
+                }
+                continue;
+            }
+            double value = 0;
+            words >> value;
+            if (key == "timeout" && value > 0) {
+                timeout_seconds = value;
+            } else if (key == "failure_threshold" && value >= 1) {
+                failure_threshold = static_cast<int>(value);
+            } else if (key == "open_seconds") {
+                open_seconds = value;
+            }
+        }
+        if (backends.empty()) {
+            Backend backend;
+            backend.base = LLM_SERVER_ADDRESS;
+            backends.push_back(backend);
+        }
+        for (Backend& backend : backends) {
+            if (backend.model.empty()) {
+                backend.model = DEFAULT_LLM_MODEL;
+            }
+            http_clients().set_timeout(backend.base, chrono::milliseconds(static_cast<long long>(timeout_seconds * 1000)));
+        }
+    }
 
-        if (response.status_code() == status_codes::OK) {
-            pplx::task<string> bodyTask = response.extract_string();
-            string body = bodyTask.get();
+    // Pick the least busy backend not tried yet whose circuit lets a request through, or -1
+    int pick(const vector<bool>& tried) {
+        lock_guard<mutex> lock(backends_mutex);
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        int best = -1;
+        for (size_t b = 0; b < backends.size(); ++b) {
+            Backend& backend = backends[b];
+            bool blocked = backend.open && (now < backend.open_until || backend.outstanding > 0); // Cooling down, or trial in flight
+            if (tried[b] || blocked) {
+                continue;
+            }
+            if (best < 0 || backend.outstanding < backends[best].outstanding) {
+                best = static_cast<int>(b);
+            }
+        }
+        if (best >= 0) {
+            backends[best].outstanding++;
+        }
+        return best;
+    }
+
+    void finish(int chosen, bool ok, double ms) {
+        lock_guard<mutex> lock(backends_mutex);
+        Backend& backend = backends[chosen];
+        backend.outstanding--;
+        backend.requests++;
+        if (ok) {
+            backend.consecutive_failures = 0;
+            backend.open = false;
+            backend.total_ms += ms;
+        } else {
+            backend.failures++;
+            if (backend.open || ++backend.consecutive_failures >= failure_threshold) {
+                backend.open = true;
+                backend.open_until = chrono::steady_clock::now() + chrono::milliseconds(static_cast<long long>(open_seconds * 1000));
+                cerr << "LLM backend " << backend.base << " circuit opened for " << open_seconds << " s." << endl;
+            }
+        }
+    }
+
+    // Print the requests, failures, circuit and mean latency per backend
+    void print_stats(ostream& out) {
+        lock_guard<mutex> lock(backends_mutex);
+        for (const Backend& backend : backends) {
+            unsigned long successes = backend.requests - backend.failures;
+            out << "LLM backend: " << backend.base << " | Requests: " << backend.requests << " | Failed: " << backend.failures
+                << " | Circuit: " << (backend.open ? "open" : "closed") << " | Mean latency: " << (successes > 0 ? backend.total_ms / successes : 0) << " ms" << endl;
+        }
+    }
+};
+
+// Function to get the process-wide LLM backend list
+LlmBackends& llm_backends() {
+    static LlmBackends backends;
+    return backends;
+}
 
-            // Parse the JSON response
-            json::value json_response = json::value::parse(U(body));
-            if (json_response.has_field(U("choices")) && json_response["choices"].is_array() && json_response["choices"].as_array().size() > 0 && json_response["choices"][0].has_field(U("message")) && json_response["choices"][0]["message"].has_field(U("content"))) {
-                return json_response["choices"][0]["message"]["content"].as_string();
+// Function to interact with the LLM server
+string call_llm(const string& system_prompt, const string& user_prompt, double temperature) {
+    LlmBackends& pool = llm_backends();
+    vector<bool> tried(pool.backends.size(), false);
+    int chosen;
+    while ((chosen = pool.pick(tried)) >= 0) {
+        tried[chosen] = true;
+        const LlmBackends::Backend& backend = pool.backends[chosen];
+        chrono::steady_clock::time_point sent = chrono::steady_clock::now();
+        bool ok = false;
+        string content;
+        try {
+            http_request request(methods::POST);
+            request.headers().add("Content-Type", "application/json");
+
+            // Construct the JSON payload
+            json::value payload;
+            payload["model"] = json::value::string(backend.model);
+            payload["messages"] = json::value::array();
+            payload["messages"][0] = json::value::object();
+            payload["messages"][0]["role"] = json::value::string("system");
+            payload["messages"][0]["content"] = json::value::string(system_prompt);
+            payload["messages"][1] = json::value::object();
+            payload["messages"][1]["role"] = json::value::string("user");
+            payload["messages"][1]["content"] = json::value::string(user_prompt);
+            payload["temperature"] = json::value::number(temperature);
+
+            request.set_body(payload.serialize());
+
+            http_response response = http_clients().send(backend.base + "/chat/completions", request);
+
+            if (response.status_code() == status_codes::OK) {
+                ok = true; // The backend answered; a reply without content is not its fault
+                pplx::task<string> bodyTask = response.extract_string();
+                string body = bodyTask.get();
+
+                // Parse the JSON response
+                json::value json_response = json::value::parse(U(body));
+                if (json_response.has_field(U("choices")) && json_response["choices"].is_array() && json_response["choices"].as_array().size() > 0 && json_response["choices"][0].has_field(U("message")) && json_response["choices"][0]["message"].has_field(U("content"))) {
+                    content = json_response["choices"][0]["message"]["content"].as_string();
+                } else {
+                    cerr << "Error: Could not extract content from LLM response." << endl;
+                    cerr << "Response body: " << body << endl; // Print the response body for debugging
+                }
             } else {
-                cerr << "Error: Could not extract content from LLM response." << endl;
-                cerr << "Response body: " << body << endl; // Print the response body for debugging
-                return "";
+                cerr << "Error: LLM server " << backend.base << " returned status code " << response.status_code() << endl;
             }
-        } else {
-            cerr << "Error: LLM server returned status code " << response.status_code() << endl;
-            return "";
+        } catch (const std::exception& e) {
+            cerr << "Error communicating with LLM server " << backend.base << ": " << e.what() << endl;
+        }
+        pool.finish(chosen, ok, chrono::duration<double, milli>(chrono::steady_clock::now() - sent).count());
+        if (ok) {
+            return content;
         }
-    } catch (const std::exception& e) {
-        cerr << "Error communicating with LLM server: " << e.what() << endl;
-        return "";
     }
+    cerr << "Error: No LLM backend could take the request." << endl;
     return "";
 }
 
@@ -283,100 +532,277 @@ bool createDirectory(const string& path) {
     }
 }
 
-int main(int argc, char* argv[]) {
-    srand(time(0)); // Seed the random number generator
+// Function to get the directory part of a path
+string parent_directory(const string& path) {
+    vector<char> path_cstr(path.begin(), path.end());
+    path_cstr.push_back('\0');
+    return dirname(path_cstr.data());
+}
 
-    int tag_nums = 10;
-    unsigned int seed = generate_seed();
-    string prompt;
-    string neg_prompt = "";
-    string char_line;
-    vector<string> top_tags;
+// Function to hash a string into a hex SHA-256 digest
+string sha256_hex(const string& data) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), digest);
+    stringstream hex_stream;
+    for (unsigned char byte : digest) {
+        hex_stream << hex << setw(2) << setfill('0') << static_cast<int>(byte);
+    }
+    return hex_stream.str();
+}
 
-    // Define LoRAs and their strengths
-    vector<string> loras = {"64x3-05:1.0"};
-    vector<string> lora_models;
-    vector<string> lora_alphas;
+// Function to place src at dst, preferring a hard link, then a reflink, then a plain copy.
+// dst is replaced with a rename so readers never see a partially written file.
+bool link_or_copy_file(const string& src, const string& dst) {
+    string temp_path = dst + ".tmp." + to_string(getpid());
+    unlink(temp_path.c_str());
+
+    bool placed = link(src.c_str(), temp_path.c_str()) == 0;
+#ifdef FICLONE
+    if (!placed) {
+        int src_fd = open(src.c_str(), O_RDONLY);
+        if (src_fd >= 0) {
+            int dst_fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (dst_fd >= 0) {
+                placed = ioctl(dst_fd, FICLONE, src_fd) == 0;
+                close(dst_fd);
+                if (!placed) {
+                    unlink(temp_path.c_str());
+                }
+            }
+            close(src_fd);
+        }
+    }
+#endif
+    if (!placed) {
+        ifstream in(src, ios::binary);
+        ofstream out(temp_path, ios::binary | ios::trunc);
+        if (in && out) {
+            out << in.rdbuf();
+            out.close();
+            placed = !out.fail();
+        }
+    }
 
-    for (const string& lora : loras) {
-        size_t pos = lora.find(':');
-        if (pos != string::npos) {
-            lora_models.push_back(lora.substr(0, pos));
-            lora_alphas.push_back(lora.substr(pos + 1));
-        } else {
-            lora_models.push_back(lora);
-            lora_alphas.push_back("1.0");
+    if (!placed || rename(temp_path.c_str(), dst.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Content-addressed store of finished renders, bounded in size with LRU eviction.
+// Each entry is <dir>/<key>.png and the index file holds one "key bytes last_used_ms" line per entry.
+struct RenderCache {
+    struct Entry {
+        unsigned long long bytes;
+        long long last_used;
+    };
+
+    string dir;
+    unsigned long long max_bytes;
+
+    RenderCache(const string& dir, unsigned long long max_bytes) : dir(dir), max_bytes(max_bytes) {}
+
+    static RenderCache from_environment() {
+        string dir = DEFAULT_RENDER_CACHE_DIR;
+        unsigned long long max_bytes = DEFAULT_RENDER_CACHE_MAX_BYTES;
+        if (const char* env_dir = getenv("EASY_DIFFUSION_CACHE_DIR")) {
+            dir = env_dir;
         }
+        if (const char* env_max = getenv("EASY_DIFFUSION_CACHE_MAX_MB")) {
+            try {
+                max_bytes = stoull(env_max) * 1024 * 1024;
+            } catch (const std::exception& e) {
+                cerr << "Error: Invalid EASY_DIFFUSION_CACHE_MAX_MB. Using default of " << (max_bytes >> 20) << " MB." << endl;
+            }
+        }
+        return RenderCache(dir, max_bytes);
     }
 
-    // Get prompt from command line or user input
-    if (argc > 1) {
-        prompt = argv[1];
-    } else {
-        cout << "Enter prompt: ";
-        getline(cin, prompt);
+    string object_path(const string& key) const {
+        return dir + "/" + key + ".png";
     }
 
-    // Get num_inference_steps from command line or use default value
-    int num_inference_steps = 60;
-    if (argc > 2) {
-        try {
-            num_inference_steps = stoi(argv[2]);
-        } catch (const invalid_argument& e) {
-            cerr << "Error: Invalid argument for num_inference_steps. Using default value of " << num_inference_steps << "." << endl;
-        } catch (const out_of_range& e) {
-            cerr << "Error: Out of range for num_inference_steps. Using default value of " << num_inference_steps << "." << endl;
+    // Serve a cached render into output_path. Returns false on a miss.
+    bool fetch(const string& key, const string& output_path) {
+        int lock_fd = lock_index();
+        if (lock_fd < 0) {
+            return false;
+        }
+        map<string, Entry> index = read_index();
+        auto it = index.find(key);
+        bool hit = it != index.end() && link_or_copy_file(object_path(key), output_path);
+        if (hit) {
+            it->second.last_used = now_ms();
+            write_index(index);
+        } else if (it != index.end()) {
+            // The object went missing underneath us, forget it
+            index.erase(it);
+            write_index(index);
         }
+        close(lock_fd);
+        return hit;
     }
 
-    // Get width and height from command line or use default value
-    int width = 192;
-    int height = 256;
-    if (argc > 3) {
-        string resolution = argv[3];
-        size_t x_pos = resolution.find('x');
-        if (x_pos != string::npos) {
-            try {
-                width = stoi(resolution.substr(0, x_pos));
-                height = stoi(resolution.substr(x_pos + 1));
-            } catch (const invalid_argument& e) {
-                cerr << "Error: Invalid argument for resolution. Using default values of " << width << "x" << height << "." << endl;
-            } catch (const out_of_range& e) {
-                cerr << "Error: Out of range for resolution. Using default values of " << width << "x" << height << "." << endl;
+    // Add a finished render to the cache and evict least recently used entries over the size limit.
+    void store(const string& key, const string& image_path) {
+        int lock_fd = lock_index();
+        if (lock_fd < 0) {
+            return;
+        }
+        map<string, Entry> index = read_index();
+        struct stat info;
+        if (link_or_copy_file(image_path, object_path(key)) && stat(object_path(key).c_str(), &info) == 0) {
+            index[key] = {static_cast<unsigned long long>(info.st_size), now_ms()};
+        }
+
+        unsigned long long total_bytes = 0;
+        vector<pair<long long, string>> by_age;
+        for (const auto& entry : index) {
+            total_bytes += entry.second.bytes;
+            by_age.push_back(make_pair(entry.second.last_used, entry.first));
+        }
+        sort(by_age.begin(), by_age.end());
+        for (const auto& victim : by_age) {
+            if (total_bytes <= max_bytes) {
+                break;
             }
-        } else {
-            cerr << "Error: Invalid resolution format. Using default values of " << width << "x" << height << "." << endl;
+            if (victim.second == key) {
+                continue;
+            }
+            unlink(object_path(victim.second).c_str());
+            total_bytes -= index[victim.second].bytes;
+            index.erase(victim.second);
         }
+
+        write_index(index);
+        close(lock_fd);
     }
 
-    // Get output filename from command line or use default value
+private:
+    static long long now_ms() {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Take an exclusive lock shared by every easy_diffusion process using this cache
+    int lock_index() const {
+        struct stat info;
+        if (!(stat(dir.c_str(), &info) == 0 && (info.st_mode & S_IFDIR)) && system(("mkdir -p \"" + dir + "\"").c_str()) != 0) {
+            cerr << "Error: Could not create render cache directory " << dir << endl;
+            return -1;
+        }
+        int fd = open((dir + "/index.lock").c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+
+    map<string, Entry> read_index() const {
+        map<string, Entry> index;
+        ifstream index_file(dir + "/index");
+        string key;
+        Entry entry;
+        while (index_file >> key >> entry.bytes >> entry.last_used) {
+            index[key] = entry;
+        }
+        return index;
+    }
+
+    void write_index(const map<string, Entry>& index) const {
+        string temp_path = dir + "/index.tmp";
+        ofstream index_file(temp_path, ios::trunc);
+        for (const auto& entry : index) {
+            index_file << entry.first << " " << entry.second.bytes << " " << entry.second.last_used << "\n";
+        }
+        index_file.close();
+        if (index_file.fail() || rename(temp_path.c_str(), (dir + "/index").c_str()) != 0) {
+            cerr << "Error: Could not write render cache index in " << dir << endl;
+        }
+    }
+};
+
+// Parameters of a single render request
+struct RenderJob {
+    string prompt;
+    string neg_prompt = "";
+    int num_inference_steps = 60;
+    int width = 192;
+    int height = 256;
+    unsigned int seed = 0;
+    bool random_seed = true;
+    string model = DEFAULT_STABLE_DIFFUSION_MODEL;
+    vector<string> loras = {"64x3-05:1.0"}; // LoRAs and their strengths
     string output_filename = "output.png";
-    if (argc > 4) {
-        output_filename = argv[4];
+    bool progressive = false; // Render a quick preview first, then refine it at full quality
+    double timeout_seconds = 0; // Give up on the render (and stop it on its server) after this long; 0 waits forever
+};
+
+// Set by SIGINT or SIGTERM; in-flight renders are stopped on their servers and nothing new is submitted
+volatile sig_atomic_t stop_requested = 0;
+
+// Function to handle SIGINT and SIGTERM: ask once to stop cleanly, exit at once if asked again
+void request_stop(int) {
+    if (stop_requested) {
+        _exit(130);
     }
+    stop_requested = 1;
+}
 
-    char_line = "";
-    top_tags.clear();
+// Function to parse a "widthxheight" resolution, keeping the current values on error
+void parse_resolution(const string& resolution, int& width, int& height) {
+    size_t x_pos = resolution.find('x');
+    if (x_pos != string::npos) {
+        try {
+            int parsed_width = stoi(resolution.substr(0, x_pos));
+            int parsed_height = stoi(resolution.substr(x_pos + 1));
+            width = parsed_width;
+            height = parsed_height;
+        } catch (const invalid_argument& e) {
+            cerr << "Error: Invalid argument for resolution. Using default values of " << width << "x" << height << "." << endl;
+        } catch (const out_of_range& e) {
+            cerr << "Error: Out of range for resolution. Using default values of " << width << "x" << height << "." << endl;
+        }
+    } else {
+        cerr << "Error: Invalid resolution format. Using default values of " << width << "x" << height << "." << endl;
+    }
+}
 
-    string clip = "false";
+// Function to build the /render payload without the session fields, which only route the request.
+// Everything in it determines the image, so it doubles as the render cache key.
+string build_render_params(const RenderJob& job) {
+    vector<string> lora_models;
+    vector<string> lora_alphas;
+
+    for (const string& lora : job.loras) {
+        size_t pos = lora.find(':');
+        if (pos != string::npos) {
+            lora_models.push_back(lora.substr(0, pos));
+            lora_alphas.push_back(lora.substr(pos + 1));
+        } else {
+            lora_models.push_back(lora);
+            lora_alphas.push_back("1.0");
+        }
+    }
 
-    cout << "Prompt: " << prompt << " | Negative: " << neg_prompt << " | Inference Steps: " << num_inference_steps << " | Width: " << width << " | Height: " << height << " | Output Filename: " << output_filename << endl;
+    string clip = "false";
 
     // Construct JSON payload manually
     stringstream payload_stream;
     payload_stream << "{"
-                   << "\"prompt\":\"" << prompt << "\","
-                   << "\"seed\":" << seed << ","
-                   << "\"used_random_seed\":true,"
-                   << "\"negative_prompt\":\"" << neg_prompt << "\","
+                   << "\"prompt\":\"" << job.prompt << "\","
+                   << "\"seed\":" << job.seed << ","
+                   << "\"used_random_seed\":" << (job.random_seed ? "true" : "false") << ","
+                   << "\"negative_prompt\":\"" << job.neg_prompt << "\","
                    << "\"num_outputs\":1,"
-                   << "\"num_inference_steps\":" << num_inference_steps << ","
+                   << "\"num_inference_steps\":" << job.num_inference_steps << ","
                    << "\"guidance_scale\":7.5,"
-                   << "\"width\":" << width << ","
-                   << "\"height\":" << height << ","
+                   << "\"width\":" << job.width << ","
+                   << "\"height\":" << job.height << ","
                    << "\"vram_usage_level\":\"balanced\","
                    << "\"sampler_name\":\"dpmpp_3m_sde\","
-                   << "\"use_stable_diffusion_model\":\"" << DEFAULT_STABLE_DIFFUSION_MODEL << "\","
+                   << "\"use_stable_diffusion_model\":\"" << job.model << "\","
                    << "\"clip_skip\":" << clip << ","
                    << "\"use_vae_model\":\"\","
                    << "\"stream_progress_updates\":true,"
@@ -387,7 +813,7 @@ int main(int argc, char* argv[]) {
                    << "\"output_quality\":75,"
                    << "\"output_lossless\":false,"
                    << "\"metadata_output_format\":\"embed,json\","
-                   << "\"original_prompt\":\"" << prompt << "\","
+                   << "\"original_prompt\":\"" << job.prompt << "\","
                    << "\"active_tags\":[],"
                    << "\"inactive_tags\":[],"
                    << "\"save_to_disk_path\":\"~/Pictures/stable-diffusion/output/\","
@@ -408,169 +834,1109 @@ int main(int argc, char* argv[]) {
     }
     payload_stream << "],"
                    << "\"enable_vae_tiling\":false,"
-                   << "\"scheduler_name\":\"automatic\","
-                   << "\"session_id\":\"1337\""
-                   << "}";
+                   << "\"scheduler_name\":\"automatic\"";
+    return payload_stream.str();
+}
 
-    string payload = payload_stream.str();
+// One stable diffusion server renders can be sent to
+struct RenderServer {
+    string base;
+    int assigned = 0; // Jobs of this process submitted to it and not finished
+    double assigned_units = 0; // Their size, in steps times megapixels
+    int reported_queue = 0; // Tasks its last /ping showed: 1 while it reports "Rendering", else 0
+    bool down = false; // Its last /ping or a submission to it failed
+    chrono::steady_clock::time_point checked; // When it was last pinged
+    double ms_per_unit = 0; // Average render time per step-megapixel, 0 until a render finishes
+    unsigned long jobs = 0;
+    unsigned long failures = 0; // Jobs lost to the server failing
+};
+
+// Spreads renders over the stable diffusion servers. Each job goes to the server with the soonest
+// expected completion: this process's jobs already there, other clients' tasks from its /ping,
+// then the job itself, all at the server's measured speed. A /ping without a session only tells
+// whether the server is rendering, not how deep its queue is, so other clients count for at most
+// one task per server. Every job gets its own session, so
+// concurrent renders do not share one. A server that stops answering is marked down, pinged
+// again after a while, and the jobs it lost are submitted to another server.
+struct RenderDispatcher {
+    mutex servers_mutex;
+    vector<RenderServer> servers;
+    atomic<unsigned long> sessions{0};
+    chrono::seconds ping_max_age{2};
+    chrono::seconds down_retry{30};
+
+    RenderDispatcher() {
+        const char* server_list = getenv("EASY_DIFFUSION_SERVERS");
+        stringstream bases(server_list ? server_list : "");
+        string base;
+        while (getline(bases, base, ',')) {
+            base.erase(0, base.find_first_not_of(" \t"));
+            base.erase(base.find_last_not_of(" /\t") + 1);
+            if (!base.empty()) {
+                servers.push_back(RenderServer());
+                servers.back().base = base;
+            }
+        }
+        if (servers.empty()) {
+            servers.push_back(RenderServer());
+            servers.back().base = SERVER_ADDRESS;
+        }
+    }
 
-    // Send request
-    try {
-        http_client client(U(SERVER_ADDRESS + "/render"));
-        http_request request(methods::POST);
-        request.headers().add("Accept", "*/*");
-        request.headers().add("Accept-Language", "en-US,en;q=0.9");
-        request.headers().add("Cache-Control", "no-cache");
-        request.headers().add("Connection", "keep-alive");
-        request.headers().add("Content-Type", "application/json");
-        request.headers().add("Origin", U(SERVER_ADDRESS));
-        request.headers().add("Pragma", "no-cache");
-        request.headers().add("Referer", U(SERVER_ADDRESS + "/"));
-        request.headers().add("User-Agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/132.0.0.0 Safari/537.36");
-        request.set_body(payload);
-
-        pplx::task<http_response> responseTask = client.request(request);
-        http_response response = responseTask.get();
+    // A session ID no other job of any process shares
+    string new_session_id() {
+        return "ed-" + to_string(getpid()) + "-" + to_string(chrono::steady_clock::now().time_since_epoch().count() % 1000000007) + "-" + to_string(sessions++);
+    }
 
-        if (response.status_code() == status_codes::OK) {
-            pplx::task<string> bodyTask = response.extract_string();
-            string body = bodyTask.get();
+    // Pick the server that should finish a job soonest among those not excluded, and count the
+    // job against it. Returns -1 if every server is excluded or down.
+    int pick(const RenderJob& job, const vector<bool>& excluded) {
+        refresh_queues();
+        double units = job_units(job);
+        lock_guard<mutex> lock(servers_mutex);
+        double known_rate = 0;
+        int known = 0;
+        for (const RenderServer& server : servers) {
+            if (server.ms_per_unit > 0) {
+                known_rate += server.ms_per_unit;
+                known++;
+            }
+        }
+        double default_rate = known > 0 ? known_rate / known : 1.0; // Untried servers are assumed average
+        int best = -1;
+        double best_ms = 0;
+        for (size_t s = 0; s < servers.size(); ++s) {
+            const RenderServer& server = servers[s];
+            if (excluded[s] || server.down) {
+                continue;
+            }
+            double rate = server.ms_per_unit > 0 ? server.ms_per_unit : default_rate;
+            double others = max(0, server.reported_queue - server.assigned) * units; // Other clients' tasks, assumed this size
+            double expected_ms = (server.assigned_units + others + units) * rate;
+            if (best < 0 || expected_ms < best_ms) {
+                best = static_cast<int>(s);
+                best_ms = expected_ms;
+            }
+        }
+        if (best >= 0) {
+            servers[best].assigned++;
+            servers[best].assigned_units += units;
+            servers[best].jobs++;
+        }
+        return best;
+    }
+
+    // Account for a job leaving a server: its render time if it rendered, or the server's failure
+    void finish(int s, const RenderJob& job, double render_ms, bool server_failed) {
+        double units = job_units(job);
+        lock_guard<mutex> lock(servers_mutex);
+        RenderServer& server = servers[s];
+        server.assigned--;
+        server.assigned_units -= units;
+        if (server_failed) {
+            server.failures++;
+            server.down = true;
+            server.checked = chrono::steady_clock::now();
+        } else if (render_ms > 0) {
+            double rate = render_ms / units;
+            server.ms_per_unit = server.ms_per_unit == 0 ? rate : server.ms_per_unit * 0.7 + rate * 0.3;
+        }
+    }
+
+    string base(int s) {
+        lock_guard<mutex> lock(servers_mutex);
+        return servers[s].base;
+    }
+
+    // Print the jobs, failures, queue and speed per server
+    void print_stats(ostream& out) {
+        lock_guard<mutex> lock(servers_mutex);
+        for (const RenderServer& server : servers) {
+            out << "Render server: " << server.base << " | Jobs: " << server.jobs << " | Lost to failures: " << server.failures
+                << " | Queue at last ping: " << server.reported_queue << " | " << (server.down ? "Down" : "Up")
+                << " | ms per step-megapixel: " << server.ms_per_unit << endl;
+        }
+    }
 
-            string task = extract_task_id(body);
+private:
+    static double job_units(const RenderJob& job) {
+        return max(1, job.num_inference_steps) * max(0.01, job.width * static_cast<double>(job.height) / 1e6);
+    }
 
-            // Monitor task status
+    // Ping servers whose queue depth is stale, and down servers once their retry time is up
+    void refresh_queues() {
+        vector<string> due;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> lock(servers_mutex);
+            for (RenderServer& server : servers) {
+                if (now - server.checked >= (server.down ? down_retry : ping_max_age)) {
+                    server.checked = now; // Other threads leave it to this one
+                    due.push_back(server.base);
+                }
+            }
+        }
+        for (const string& base : due) {
+            // The sessionless /ping lists no tasks; its "status" is "Rendering" while a task runs
+            string ping = fetch_url(base + "/ping");
             string status;
-            string image_data;
-            do {
-                string status_url = SERVER_ADDRESS + "/ping?session_id=1337";
-                string status_response = fetch_url(status_url);
-                if (!status_response.empty()) {
-                    status = extract_task_status(status_response, task);
-                    if (status.empty()) {
-                        status = "unknown";
-                    }
-                } else {
-                    status = "error";
+            size_t key = ping.find("\"status\"");
+            size_t open = key == string::npos ? string::npos : ping.find('"', ping.find(':', key));
+            size_t close = open == string::npos ? string::npos : ping.find('"', open + 1);
+            if (close != string::npos) {
+                status = ping.substr(open + 1, close - open - 1);
+            }
+            int queue = status == "Rendering" ? 1 : 0;
+            lock_guard<mutex> lock(servers_mutex);
+            for (RenderServer& server : servers) {
+                if (server.base == base) {
+                    server.down = ping.empty();
+                    server.reported_queue = queue;
+                    server.checked = chrono::steady_clock::now();
+                }
+            }
+        }
+    }
+};
+
+// Function to get the process-wide render dispatcher
+RenderDispatcher& render_servers() {
+    static RenderDispatcher dispatcher;
+    return dispatcher;
+}
+
+// Function to submit a render request to a server and return the task ID, or an empty string on failure
+string submit_render(const string& server, const string& payload) {
+    http_request request(methods::POST);
+    request.headers().add("Accept", "*/*");
+    request.headers().add("Accept-Language", "en-US,en;q=0.9");
+    request.headers().add("Cache-Control", "no-cache");
+    request.headers().add("Connection", "keep-alive");
+    request.headers().add("Content-Type", "application/json");
+    request.headers().add("Origin", U(server));
+    request.headers().add("Pragma", "no-cache");
+    request.headers().add("Referer", U(server + "/"));
+    request.headers().add("User-Agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/132.0.0.0 Safari/537.36");
+    request.set_body(payload);
+
+    http_response response = http_clients().send(server + "/render", request);
+    if (response.status_code() != status_codes::OK) {
+        cerr << "Error: HTTP request failed with status code " << response.status_code() << endl;
+        return "";
+    }
+    pplx::task<string> bodyTask = response.extract_string();
+    return extract_task_id(bodyTask.get());
+}
+
+// Function to parse an integer progress field from an /image/stream response
+int parse_progress_value(const string& value, int default_value, const string& name) {
+    if (value.empty()) {
+        return default_value;
+    }
+    try {
+        return stoi(value);
+    } catch (const invalid_argument& e) {
+        cerr << "Error: Invalid argument for " << name << ": " << e.what() << endl;
+    } catch (const out_of_range& e) {
+        cerr << "Error: Out of range for " << name << ": " << e.what() << endl;
+    }
+    return default_value;
+}
+
+// Outcome of waiting on a render task
+struct TaskOutcome {
+    string status;     // "completed", "error", or "lost" if its server stopped answering
+    string image_data; // Base64 data URL of the finished image
+};
+
+// Callback receiving a task's status and step progress on every poll
+typedef function<void(const string& status, int step, int total_steps)> ProgressCallback;
+
+// Single poller shared by every in-flight render of the process. Each tick pings every task's
+// session on its server for the task's status; /image/stream is then read per task for progress
+// or the image. A task whose server misses lost_after pings in a row is given up as lost.
+struct RenderPoller {
+    struct Watch {
+        string server;
+        string session;
+        string task;
+        ProgressCallback on_progress;
+        promise<TaskOutcome> outcome;
+        int missed_pings = 0;
+        bool cancelled = false; // Set by unwatch(), under watches_mutex
+    };
+
+    static const int lost_after = 3;
+
+    chrono::milliseconds interval;
+    mutex watches_mutex;
+    condition_variable watches_changed;
+    map<string, shared_ptr<Watch>> watches;
+    bool new_watch = false;
+    bool stopping = false;
+    thread worker;
+
+    explicit RenderPoller(chrono::milliseconds interval = chrono::seconds(5)) : interval(interval) {
+        worker = thread(&RenderPoller::run, this);
+    }
+
+    ~RenderPoller() {
+        {
+            lock_guard<mutex> lock(watches_mutex);
+            stopping = true;
+        }
+        watches_changed.notify_all();
+        worker.join();
+    }
+
+    // Start watching a task submitted to a server in a session; the future resolves once it
+    // completes, fails or is lost
+    future<TaskOutcome> watch(const string& server, const string& session, const string& task, ProgressCallback on_progress) {
+        shared_ptr<Watch> entry = make_shared<Watch>();
+        entry->server = server;
+        entry->session = session;
+        entry->task = task;
+        entry->on_progress = on_progress;
+        future<TaskOutcome> outcome = entry->outcome.get_future();
+        {
+            lock_guard<mutex> lock(watches_mutex);
+            watches[server + " " + task] = entry; // Task IDs are only unique per server
+            new_watch = true;
+        }
+        watches_changed.notify_all();
+        return outcome;
+    }
+
+    // Stop watching a task, e.g. one that was given up on; its future is never resolved. Once this
+    // returns, the task's progress callback is not running and will not be called again.
+    void unwatch(const string& server, const string& task) {
+        lock_guard<mutex> lock(watches_mutex);
+        auto entry = watches.find(server + " " + task);
+        if (entry != watches.end()) {
+            entry->second->cancelled = true;
+            watches.erase(entry);
+        }
+    }
+
+private:
+    void run() {
+        unique_lock<mutex> lock(watches_mutex);
+        while (true) {
+            watches_changed.wait(lock, [this]() { return stopping || !watches.empty(); });
+            if (stopping) {
+                return;
+            }
+            new_watch = false;
+            vector<shared_ptr<Watch>> current;
+            for (const auto& entry : watches) {
+                current.push_back(entry.second);
+            }
+            lock.unlock();
+
+            vector<string> finished = poll_once(current);
+
+            lock.lock();
+            for (const string& task : finished) {
+                watches.erase(task);
+            }
+            // Sleep until the next tick, waking early for newly submitted tasks
+            if (!watches.empty()) {
+                watches_changed.wait_for(lock, interval, [this]() { return stopping || new_watch; });
+            }
+        }
+    }
+
+    // Poll every watched task once and return the ones that finished
+    vector<string> poll_once(const vector<shared_ptr<Watch>>& current) {
+        vector<string> finished;
+        for (const auto& entry : current) {
+            string status_url = entry->server + "/ping?session_id=" + entry->session;
+            string status_response = fetch_url(status_url);
+            string status = "unknown";
+            if (status_response.empty()) {
+                if (++entry->missed_pings >= lost_after) {
+                    resolve(*entry, {"lost", ""});
+                    finished.push_back(entry->server + " " + entry->task);
                 }
+                continue;
+            }
+            entry->missed_pings = 0;
+            string task_status = extract_task_status(status_response, entry->task);
+            if (!task_status.empty()) {
+                status = task_status;
+            }
 
-                if (status == "error") {
-                    cerr << "\rError during task execution.                                      " << endl;
-                    return 1;
+            string stream_url = entry->server + "/image/stream/" + entry->task;
+            if (status == "error") {
+                resolve(*entry, {status, ""});
+                finished.push_back(entry->server + " " + entry->task);
+            } else if (status == "completed") {
+                // Extract image data
+                string stream_response = fetch_url(stream_url);
+                resolve(*entry, {status, extract_json_value(stream_response, "data")});
+                finished.push_back(entry->server + " " + entry->task);
+            } else if (entry->on_progress) {
+                string stream_response = fetch_url(stream_url);
+                int steps = parse_progress_value(extract_json_value(stream_response, "step"), 0, "steps");
+                int total_steps = parse_progress_value(extract_json_value(stream_response, "total_steps"), 1, "total_steps");
+                // Under the lock, so a task given up on meanwhile is not reported to a caller that has moved on
+                lock_guard<mutex> lock(watches_mutex);
+                if (!entry->cancelled) {
+                    entry->on_progress(status, steps, total_steps);
                 }
+            }
+        }
+        return finished;
+    }
 
-                if (status != "completed") {
-                    string stream_url = SERVER_ADDRESS + "/image/stream/" + task;
-                    string stream_response = fetch_url(stream_url);
+    // Function to hand a task's outcome to its waiter, unless the task was unwatched meanwhile
+    void resolve(Watch& entry, const TaskOutcome& outcome) {
+        lock_guard<mutex> lock(watches_mutex);
+        if (!entry.cancelled) {
+            entry.outcome.set_value(outcome);
+        }
+    }
+};
+
+// Function to decode the base64 payload of a data URL
+vector<unsigned char> decode_base64_image(const string& image_data) {
+    string base64_stripped = image_data.substr(image_data.find(',') + 1);
+
+    // Convert base64 string to byte array
+    const std::string base64_chars =
+         "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+         "abcdefghijklmnopqrstuvwxyz"
+         "0123456789+/";
+
+    std::vector<unsigned char> out_bytes;
+    out_bytes.reserve(base64_stripped.size() / 4 * 3);
+
+    int val = 0, valb = -8;
+    for (unsigned char c : base64_stripped) {
+        if (c == '=')
+            break;
+        size_t index = base64_chars.find(c);
+        if (index == std::string::npos)
+            continue;
+
+        val = (val << 6) | index;
+        valb += 6;
+
+        if (valb >= 0) {
+            out_bytes.push_back(char((val >> valb) & 0xFF));
+            valb -= 8;
+        }
+    }
+    return out_bytes;
+}
 
-                    string steps_value = extract_json_value(stream_response, "step");
-                    string total_steps_value = extract_json_value(stream_response, "total_steps");
+// Function to save image bytes to the output path, creating its directory if needed
+bool save_image(const string& output_filename, const vector<unsigned char>& image_bytes) {
+    // Extract directory path from the output filename
+    string dir_path = parent_directory(output_filename);
 
-                    int steps = 0;
-                    int total_steps = 1;
+    // Create the directory if it doesn't exist
+    if (!createDirectory(dir_path)) {
+        cerr << "Error: Could not create or access directory " << dir_path << endl;
+        return false;
+    }
 
-                    if (!steps_value.empty()) {
-                        try {
-                            steps = stoi(steps_value);
-                        } catch (const invalid_argument& e) {
-                            cerr << "Error: Invalid argument for steps: " << e.what() << endl;
-                        } catch (const out_of_range& e) {
-                            cerr << "Error: Out of range for steps: " << e.what() << endl;
-                        }
-                    }
+    // Write image data to a temporary file and rename it into place, so an
+    // existing output that is hard-linked into the cache is never overwritten in place
+    string temp_filename = output_filename + ".tmp";
+    ofstream image_file(temp_filename, ios::binary);
+    image_file.write(reinterpret_cast<const char*>(image_bytes.data()), image_bytes.size());
+    image_file.close();
+    if (image_file.fail() || rename(temp_filename.c_str(), output_filename.c_str()) != 0) {
+        cerr << "Error: Could not write image to " << output_filename << endl;
+        return false;
+    }
+    return true;
+}
 
-                    if (!total_steps_value.empty()) {
-                        try {
-                            total_steps = stoi(total_steps_value);
-                        } catch (const invalid_argument& e) {
-                            cerr << "Error: Invalid argument for total_steps: " << e.what() << endl;
-                        } catch (const out_of_range& e) {
-                            cerr << "Error: Out of range for total_steps: " << e.what() << endl;
-                        }
-                    }
+// Function to get the milliseconds elapsed since a point in time
+double elapsed_ms(chrono::steady_clock::time_point since) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
 
-                    float percentage = (float)steps / total_steps * 100.0f;
+// Descriptor that receives progress events, from --progress-fd (-1 for none). Each event is one
+// JSON line naming the job's output: submitted, step, decoded, saved, cached or failed.
+int progress_fd = -1;
+mutex progress_mutex;
 
-                    cout << "\rStatus: " << status << " | Progress: " << fixed << setprecision(2) << percentage << "%                                      " << flush;
+// Function to write one progress event, if a progress descriptor was given. Lines are written
+// whole, so the poller thread and the render threads never interleave them.
+void emit_progress(const string& event, const RenderJob& job, json::value fields = json::value::object()) {
+    if (progress_fd < 0) {
+        return;
+    }
+    fields[U("event")] = json::value::string(U(event));
+    fields[U("output")] = json::value::string(U(job.output_filename));
+    string line = fields.serialize() + "\n";
+    lock_guard<mutex> lock(progress_mutex);
+    size_t written = 0;
+    while (progress_fd >= 0 && written < line.size()) {
+        ssize_t n = write(progress_fd, line.data() + written, line.size() - written);
+        if (n > 0) {
+            written += n;
+        } else if (errno != EINTR) {
+            progress_fd = -1; // Nobody is listening any more
+        }
+    }
+}
 
-                    if (status == "buffer") {
-                        //cout << "Status is buffer, continuing to wait..." << endl;
-                    }
+// Function to report a job that ended without an image
+void emit_failure(const RenderJob& job, const string& error) {
+    json::value fields = json::value::object();
+    fields[U("error")] = json::value::string(U(error));
+    emit_progress("failed", job, fields);
+}
 
-                    this_thread::sleep_for(chrono::seconds(5));
-                } else {
-                    // Extract image data
-                    string stream_url = SERVER_ADDRESS + "/image/stream/" + task;
-                    string stream_response = fetch_url(stream_url);
-                    image_data = extract_json_value(stream_response, "data");
+// Outcome of one render job, with timings for batch reports
+struct RenderResult {
+    string status = "error"; // "completed", "cached" or "error"
+    string error;
+    string server; // Where it rendered, or was last sent
+    int attempts = 0; // Servers it was sent to
+    string task;
+    double submit_ms = 0;
+    double render_ms = 0;
+    double save_ms = 0;
+    double total_ms = 0;
+};
+
+// Function to run one render job end to end: cache lookup, submission, polling and saving
+RenderResult run_render_job(const RenderJob& job, RenderPoller& poller, bool use_cache, ProgressCallback on_progress) {
+    RenderResult result;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    string render_params = build_render_params(job);
+
+    // Serve repeat renders from the cache. A random seed never repeats, so those renders bypass it.
+    RenderCache cache = RenderCache::from_environment();
+    bool cacheable = use_cache && !job.random_seed;
+    string cache_key = sha256_hex(render_params);
+    if (cacheable) {
+        if (!createDirectory(parent_directory(job.output_filename))) {
+            result.error = "could not create directory " + parent_directory(job.output_filename);
+            cerr << "Error: Could not create or access directory " << parent_directory(job.output_filename) << endl;
+            return result;
+        }
+        if (cache.fetch(cache_key, job.output_filename)) {
+            cout << "Cache hit (" << cache_key.substr(0, 12) << "), image saved to " << job.output_filename << endl;
+            emit_progress("cached", job);
+            result.status = "cached";
+            result.total_ms = elapsed_ms(start);
+            return result;
+        }
+    }
+
+    // Send the request to the server expected to finish it soonest, in a session of its own, and
+    // monitor the task. If the server fails, send it to the next best server.
+    RenderDispatcher& dispatcher = render_servers();
+    vector<bool> tried(dispatcher.servers.size(), false);
+    TaskOutcome outcome;
+    while (true) {
+        if (stop_requested) {
+            result.error = "cancelled";
+            emit_failure(job, result.error);
+            result.total_ms = elapsed_ms(start);
+            return result;
+        }
+        int server = dispatcher.pick(job, tried);
+        if (server < 0) {
+            result.error = result.attempts > 0 ? "every render server failed" : "no render server available";
+            emit_failure(job, result.error);
+            cerr << "Error: " << (result.attempts > 0 ? "Every render server failed." : "No render server available.") << endl;
+            result.total_ms = elapsed_ms(start);
+            return result;
+        }
+        tried[server] = true;
+        result.attempts++;
+        result.server = dispatcher.base(server);
+        string session = dispatcher.new_session_id();
+        result.task.clear();
+        try {
+            result.task = submit_render(result.server, render_params + ",\"session_id\":\"" + session + "\"}");
+        } catch (const std::exception& e) {
+            cerr << "Error: " << result.server << ": " << e.what() << endl;
+        }
+        result.submit_ms = elapsed_ms(start);
+        if (result.task.empty()) {
+            dispatcher.finish(server, job, 0, true);
+            cerr << "Error: Render request to " << result.server << " failed." << endl;
+            continue;
+        }
+        json::value submitted = json::value::object();
+        submitted[U("task")] = json::value::string(U(result.task));
+        submitted[U("server")] = json::value::string(U(result.server));
+        submitted[U("attempt")] = json::value::number(result.attempts);
+        emit_progress("submitted", job, submitted);
+
+        chrono::steady_clock::time_point render_start = chrono::steady_clock::now();
+        // The callback runs on the poller thread and may outlive this call, so it holds copies
+        ProgressCallback report_progress = on_progress;
+        if (progress_fd >= 0) {
+            string task = result.task;
+            report_progress = [job, task, on_progress](const string& status, int step, int total_steps) {
+                json::value fields = json::value::object();
+                fields[U("task")] = json::value::string(U(task));
+                fields[U("status")] = json::value::string(U(status));
+                fields[U("step")] = json::value::number(step);
+                fields[U("total")] = json::value::number(total_steps);
+                emit_progress("step", job, fields);
+                if (on_progress) {
+                    on_progress(status, step, total_steps);
                 }
-            } while (status != "completed");
+            };
+        }
+        future<TaskOutcome> pending = poller.watch(result.server, session, result.task, report_progress);
+        string given_up;
+        while (pending.wait_for(chrono::milliseconds(200)) != future_status::ready) {
+            if (stop_requested) {
+                given_up = "cancelled";
+            } else if (job.timeout_seconds > 0 && elapsed_ms(start) > job.timeout_seconds * 1000) {
+                given_up = "timed out";
+            } else {
+                continue;
+            }
+            break;
+        }
+        result.render_ms = elapsed_ms(render_start);
+        if (!given_up.empty()) {
+            // Free the server for other work rather than leaving the abandoned render running on it
+            poller.unwatch(result.server, result.task);
+            fetch_url(result.server + "/image/stop?task=" + result.task);
+            dispatcher.finish(server, job, 0, false);
+            if (on_progress) {
+                cout << endl;
+            }
+            cerr << "Error: Render " << given_up << ", stopped task " << result.task << " on " << result.server << "." << endl;
+            result.error = given_up;
+            emit_failure(job, result.error);
+            result.total_ms = elapsed_ms(start);
+            return result;
+        }
+        outcome = pending.get();
+        if (outcome.status == "lost") {
+            dispatcher.finish(server, job, 0, true);
+            cerr << "\rError: " << result.server << " stopped answering, sending the render elsewhere." << endl;
+            continue;
+        }
+        dispatcher.finish(server, job, outcome.status == "completed" ? result.render_ms : 0, false);
+        break;
+    }
 
+    try {
+        if (on_progress) {
             cout << endl;
+        }
+        if (outcome.status == "error") {
+            cerr << "\rError during task execution.                                      " << endl;
+            result.error = "task failed";
+            emit_failure(job, result.error);
+            return result;
+        }
 
-            // Save image to file
-            if (!image_data.empty()) {
-                // Decode base64 image data
-                string base64_stripped = image_data.substr(image_data.find(',') + 1);
-                vector<unsigned char> decoded_image_data;
-                
-                // Decode base64
-                
-                // Convert base64 string to byte array
-                const std::string base64_chars = 
-                     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                     "abcdefghijklmnopqrstuvwxyz"
-                     "0123456789+/";
-
-                std::vector<unsigned char> in_bytes(base64_stripped.begin(), base64_stripped.end());
-                std::vector<unsigned char> out_bytes;
-
-                int val = 0, valb = -8;
-                for (unsigned char c : in_bytes) {
-                    if (c == '=')
-                        break;
-                    size_t index = base64_chars.find(c);
-                    if (index == std::string::npos)
-                        continue;
-
-                    val = (val << 6) | index;
-                    valb += 6;
-
-                    if (valb >= 0) {
-                        out_bytes.push_back(char((val >> valb) & 0xFF));
-                        valb -= 8;
-                    }
+        // Save image to file
+        if (outcome.image_data.empty()) {
+            cerr << "Error: Image data is empty." << endl;
+            result.error = "image data is empty";
+            emit_failure(job, result.error);
+            return result;
+        }
+        chrono::steady_clock::time_point save_start = chrono::steady_clock::now();
+        vector<unsigned char> image_bytes = decode_base64_image(outcome.image_data);
+        json::value decoded = json::value::object();
+        decoded[U("bytes")] = json::value::number(static_cast<uint64_t>(image_bytes.size()));
+        emit_progress("decoded", job, decoded);
+        if (!save_image(job.output_filename, image_bytes)) {
+            result.error = "could not write " + job.output_filename;
+            emit_failure(job, result.error);
+            return result;
+        }
+        cout << "Image saved to " << job.output_filename << endl;
+        if (cacheable) {
+            cache.store(cache_key, job.output_filename);
+        }
+        result.save_ms = elapsed_ms(save_start);
+        result.status = "completed";
+        json::value saved = json::value::object();
+        saved[U("task")] = json::value::string(U(result.task));
+        saved[U("server")] = json::value::string(U(result.server));
+        saved[U("render_ms")] = json::value::number(result.render_ms);
+        emit_progress("saved", job, saved);
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        result.error = e.what();
+        emit_failure(job, result.error);
+    }
+    result.total_ms = elapsed_ms(start);
+    return result;
+}
+
+// Function to derive the quick first pass of a progressive render: a quarter of the steps
+// (at least 4) at half the resolution, rounded down to the multiple of 64 the models expect
+RenderJob preview_job_for(const RenderJob& job) {
+    RenderJob preview = job;
+    preview.num_inference_steps = min(job.num_inference_steps, max(4, job.num_inference_steps / 4));
+    preview.width = max(128, job.width / 2 / 64 * 64);
+    preview.height = max(128, job.height / 2 / 64 * 64);
+    preview.progressive = false;
+    return preview;
+}
+
+// Function to serve a job straight from the render cache, if it is there
+bool fetch_cached_render(const RenderJob& job, bool use_cache) {
+    if (!use_cache || job.random_seed || !createDirectory(parent_directory(job.output_filename))) {
+        return false;
+    }
+    string cache_key = sha256_hex(build_render_params(job));
+    if (!RenderCache::from_environment().fetch(cache_key, job.output_filename)) {
+        return false;
+    }
+    cout << "Cache hit (" << cache_key.substr(0, 12) << "), image saved to " << job.output_filename << endl;
+    return true;
+}
+
+// Function to get the current wall-clock time in milliseconds
+long long epoch_ms() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Function to append the preview and final latencies of a progressive render to the latency log
+void record_progressive_latency(const string& output_filename, double preview_ms, double final_ms, const string& final_status) {
+    string log_path = DEFAULT_LATENCY_LOG;
+    if (const char* env_log = getenv("EASY_DIFFUSION_LATENCY_LOG")) {
+        log_path = env_log;
+    }
+    json::value entry = json::value::object();
+    entry[U("output")] = json::value::string(U(output_filename));
+    entry[U("preview_ms")] = json::value::number(preview_ms);
+    entry[U("final_ms")] = json::value::number(final_ms);
+    entry[U("final_status")] = json::value::string(U(final_status));
+    ofstream log_file(log_path, ios::app);
+    log_file << entry.serialize() << endl;
+}
+
+// Function to start the full-quality pass of a progressive render as a detached, low-priority
+// process, so this process (and whoever is waiting on its output) can move on once the preview is saved
+bool spawn_refinement(const RenderJob& job, bool use_cache, double preview_ms, long long started_ms) {
+    vector<string> args = {"easy_diffusion", job.prompt, to_string(job.num_inference_steps),
+                           to_string(job.width) + "x" + to_string(job.height), job.output_filename,
+                           "--seed", to_string(job.seed),
+                           "--refine-of", to_string(preview_ms), to_string(started_ms)};
+    if (!use_cache) {
+        args.push_back("--no-cache");
+    }
+    if (job.timeout_seconds > 0) {
+        args.push_back("--timeout");
+        args.push_back(to_string(job.timeout_seconds));
+    }
+    vector<char*> exec_args;
+    for (string& arg : args) {
+        exec_args.push_back(&arg[0]);
+    }
+    exec_args.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Only async-signal-safe calls until exec, since the parent has other threads running
+        setsid();
+        int null_fd = open("/dev/null", O_RDWR);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+        }
+        execv("/proc/self/exe", exec_args.data());
+        _exit(127);
+    }
+    return pid > 0;
+}
+
+// Function to parse one JSONL batch line into a render job. Fields: prompt (required),
+// negative_prompt, steps, resolution ("WxH") or width/height, seed, model, loras, output, progressive.
+bool parse_batch_job(const string& line, RenderJob& job, string& error) {
+    try {
+        json::value fields = json::value::parse(U(line));
+        if (!fields.is_object() || !fields.has_field(U("prompt")) || !fields.at(U("prompt")).is_string()) {
+            error = "missing prompt";
+            return false;
+        }
+        job.prompt = fields.at(U("prompt")).as_string();
+        if (fields.has_field(U("negative_prompt"))) {
+            job.neg_prompt = fields.at(U("negative_prompt")).as_string();
+        }
+        if (fields.has_field(U("steps"))) {
+            job.num_inference_steps = fields.at(U("steps")).as_integer();
+        }
+        if (fields.has_field(U("resolution"))) {
+            parse_resolution(fields.at(U("resolution")).as_string(), job.width, job.height);
+        }
+        if (fields.has_field(U("width"))) {
+            job.width = fields.at(U("width")).as_integer();
+        }
+        if (fields.has_field(U("height"))) {
+            job.height = fields.at(U("height")).as_integer();
+        }
+        if (fields.has_field(U("seed"))) {
+            job.seed = static_cast<unsigned int>(fields.at(U("seed")).as_double());
+            job.random_seed = false;
+        }
+        if (fields.has_field(U("model"))) {
+            job.model = fields.at(U("model")).as_string();
+        }
+        if (fields.has_field(U("loras"))) {
+            job.loras.clear();
+            for (const json::value& lora : fields.at(U("loras")).as_array()) {
+                job.loras.push_back(lora.as_string());
+            }
+        }
+        if (fields.has_field(U("output"))) {
+            job.output_filename = fields.at(U("output")).as_string();
+        }
+        if (fields.has_field(U("progressive"))) {
+            job.progressive = fields.at(U("progressive")).as_bool();
+        }
+        if (fields.has_field(U("timeout"))) {
+            job.timeout_seconds = fields.at(U("timeout")).as_double();
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+    return true;
+}
+
+// Function to run every job of a JSONL batch with at most `concurrency` renders in flight.
+// All jobs share the client registry and one poller; a JSONL result line is written per render.
+// Progressive jobs queue their full-quality pass behind every first pass, so refinements never
+// delay another job's first image. Once a stop is requested, jobs not yet submitted are reported
+// as cancelled. Returns the number of failed jobs.
+int run_batch(istream& jobs_in, ostream& results_out, int concurrency, bool use_cache, bool progressive, double timeout_seconds) {
+    struct BatchEntry {
+        int line_number;
+        RenderJob job;
+        string parse_error;
+    };
+
+    struct Refinement {
+        size_t entry;
+        double preview_ms;
+        chrono::steady_clock::time_point started;
+    };
+
+    vector<BatchEntry> entries;
+    string line;
+    int line_number = 0;
+    while (getline(jobs_in, line)) {
+        ++line_number;
+        if (line.find_first_not_of(" \t\r") == string::npos) {
+            continue;
+        }
+        BatchEntry entry;
+        entry.line_number = line_number;
+        entry.job.seed = generate_seed() + line_number;
+        entry.job.output_filename = "output_" + to_string(line_number) + ".png";
+        entry.job.progressive = progressive;
+        entry.job.timeout_seconds = timeout_seconds;
+        parse_batch_job(line, entry.job, entry.parse_error);
+        entries.push_back(entry);
+    }
+
+    RenderPoller poller(progress_fd >= 0 ? chrono::seconds(1) : chrono::seconds(5));
+    mutex results_mutex;
+    atomic<int> failures(0);
+    chrono::steady_clock::time_point batch_start = chrono::steady_clock::now();
+
+    mutex queue_mutex;
+    condition_variable queue_changed;
+    size_t next_entry = 0;
+    int first_passes_running = 0;
+    deque<Refinement> refinements;
+
+    auto report = [&](const BatchEntry& entry, const string& pass, const RenderResult& result, double queue_ms) {
+        json::value line = json::value::object();
+        line[U("line")] = json::value::number(entry.line_number);
+        line[U("output")] = json::value::string(U(entry.job.output_filename));
+        if (!pass.empty()) {
+            line[U("pass")] = json::value::string(U(pass));
+        }
+        line[U("status")] = json::value::string(U(result.status));
+        if (!result.error.empty()) {
+            line[U("error")] = json::value::string(U(result.error));
+        }
+        if (!result.task.empty()) {
+            line[U("task")] = json::value::string(U(result.task));
+        }
+        if (!result.server.empty()) {
+            line[U("server")] = json::value::string(U(result.server));
+            line[U("attempts")] = json::value::number(result.attempts);
+        }
+        line[U("seed")] = json::value::number(static_cast<uint64_t>(entry.job.seed));
+        line[U("queue_ms")] = json::value::number(queue_ms);
+        line[U("submit_ms")] = json::value::number(result.submit_ms);
+        line[U("render_ms")] = json::value::number(result.render_ms);
+        line[U("save_ms")] = json::value::number(result.save_ms);
+        line[U("total_ms")] = json::value::number(result.total_ms);
+
+        lock_guard<mutex> lock(results_mutex);
+        results_out << line.serialize() << endl;
+    };
+
+    // Run the first (or only) pass of a job; returns true if it left a refinement to queue
+    auto run_first_pass = [&](const BatchEntry& entry, double queue_ms) -> bool {
+        RenderResult result;
+        if (!entry.parse_error.empty()) {
+            result.error = "invalid job: " + entry.parse_error;
+        } else if (!entry.job.progressive) {
+            result = run_render_job(entry.job, poller, use_cache, nullptr);
+        } else if (fetch_cached_render(entry.job, use_cache)) {
+            result.status = "cached";
+            report(entry, "final", result, queue_ms);
+            return false;
+        } else {
+            result = run_render_job(preview_job_for(entry.job), poller, use_cache, nullptr);
+            report(entry, "preview", result, queue_ms);
+            return true;
+        }
+        if (result.status == "error") {
+            failures++;
+        }
+        report(entry, "", result, queue_ms);
+        return false;
+    };
+
+    auto worker = [&]() {
+        unique_lock<mutex> lock(queue_mutex);
+        while (true) {
+            if (next_entry < entries.size()) {
+                size_t i = next_entry++;
+                first_passes_running++;
+                lock.unlock();
+                chrono::steady_clock::time_point started = chrono::steady_clock::now();
+                bool refine = run_first_pass(entries[i], elapsed_ms(batch_start));
+                double preview_ms = elapsed_ms(started);
+                lock.lock();
+                if (refine) {
+                    refinements.push_back({i, preview_ms, started});
                 }
-                
-                // Extract directory path from the output filename
-                char *output_filename_cstr = new char[output_filename.length() + 1];
-                strcpy(output_filename_cstr, output_filename.c_str());
-                char *dir_name = dirname(output_filename_cstr);
-                string dir_path = dir_name;
-                delete[] output_filename_cstr;
-
-                // Create the directory if it doesn't exist
-                if (!createDirectory(dir_path)) {
-                    cerr << "Error: Could not create or access directory " << dir_path << endl;
-                    return 1;
+                first_passes_running--;
+                queue_changed.notify_all();
+            } else if (!refinements.empty()) {
+                Refinement refinement = refinements.front();
+                refinements.pop_front();
+                lock.unlock();
+                const BatchEntry& entry = entries[refinement.entry];
+                double queue_ms = elapsed_ms(batch_start);
+                RenderResult result = run_render_job(entry.job, poller, use_cache, nullptr);
+                if (result.status == "error") {
+                    failures++;
                 }
-
-                // Write image data to file
-                ofstream image_file(output_filename, ios::binary);
-                image_file.write(reinterpret_cast<const char*>(out_bytes.data()), out_bytes.size());
-                image_file.close();
-                cout << "Image saved to " << output_filename << endl;
+                report(entry, "final", result, queue_ms);
+                record_progressive_latency(entry.job.output_filename, refinement.preview_ms, elapsed_ms(refinement.started), result.status);
+                lock.lock();
+            } else if (first_passes_running == 0) {
+                return;
             } else {
-                cerr << "Error: Image data is empty." << endl;
+                queue_changed.wait(lock);
             }
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 0; i < max(1, concurrency); ++i) {
+        workers.push_back(thread(worker));
+    }
+    for (thread& t : workers) {
+        t.join();
+    }
+    return failures;
+}
+
+int main(int argc, char* argv[]) {
+    srand(time(0)); // Seed the random number generator
 
+    RenderJob job;
+    job.seed = generate_seed();
+
+    // Separate the --options from the positional arguments
+    vector<string> args;
+    bool use_cache = true;
+    string batch_path;
+    string results_path;
+    int concurrency = 2;
+    bool progressive = false;
+    bool preview_only = false; // Leave the full-quality pass to the caller, which runs it once all its previews are done
+    bool connection_stats = false;
+    double refine_preview_ms = -1; // Set when this process is the full-quality pass of a progressive render
+    long long refine_started_ms = 0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            try {
+                job.seed = stoul(argv[++i]);
+                job.random_seed = false;
+            } catch (const std::exception& e) {
+                cerr << "Error: Invalid argument for --seed. Using a random seed." << endl;
+            }
+        } else if (arg == "--no-cache") {
+            use_cache = false;
+        } else if (arg == "--connection-stats") {
+            connection_stats = true;
+        } else if (arg == "--servers" && i + 1 < argc) {
+            // Through the environment, so background refinements use the same servers
+            setenv("EASY_DIFFUSION_SERVERS", argv[++i], 1);
+        } else if (arg == "--progressive") {
+            progressive = true;
+        } else if (arg == "--preview-only") {
+            preview_only = true;
+        } else if (arg == "--progress-fd" && i + 1 < argc) {
+            progress_fd = atoi(argv[++i]);
+            // Background refinements must not inherit it, or they would outlive the reader
+            if (fcntl(progress_fd, F_SETFD, FD_CLOEXEC) != 0) {
+                cerr << "Error: --progress-fd " << progress_fd << " is not an open descriptor." << endl;
+                progress_fd = -1;
+            }
+            signal(SIGPIPE, SIG_IGN); // A reader that went away only ends the events
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            job.timeout_seconds = max(0.0, atof(argv[++i]));
+        } else if (arg == "--refine-of" && i + 2 < argc) {
+            refine_preview_ms = atof(argv[++i]);
+            refine_started_ms = atoll(argv[++i]);
+            setpriority(PRIO_PROCESS, 0, 10);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batch_path = argv[++i];
+        } else if (arg == "--results" && i + 1 < argc) {
+            results_path = argv[++i];
+        } else if (arg == "--concurrency" && i + 1 < argc) {
+            try {
+                concurrency = stoi(argv[++i]);
+            } catch (const std::exception& e) {
+                cerr << "Error: Invalid argument for --concurrency. Using default value of " << concurrency << "." << endl;
+            }
         } else {
-            cerr << "Error: HTTP request failed with status code " << response.status_code() << endl;
-            return 1;
+            args.push_back(arg);
         }
-    } catch (const std::exception& e) {
-        cerr << "Error: " << e.what() << endl;
-        return 1;
     }
 
-    return 0;
+    // Stop in-flight renders on their servers instead of leaving them running when interrupted
+    struct sigaction stop_action;
+    memset(&stop_action, 0, sizeof(stop_action));
+    stop_action.sa_handler = request_stop;
+    sigaction(SIGINT, &stop_action, nullptr);
+    sigaction(SIGTERM, &stop_action, nullptr);
+
+    if (connection_stats) {
+        // Construct the registry, backend and server lists first so the stats print before they are destroyed
+        http_clients();
+        llm_backends();
+        render_servers();
+        atexit([]() {
+            http_clients().print_stats(cerr);
+            llm_backends().print_stats(cerr);
+            render_servers().print_stats(cerr);
+        });
+    }
+
+    // Batch mode: one JSONL job per line from a file or stdin ("-")
+    if (!batch_path.empty()) {
+        ifstream jobs_file;
+        if (batch_path != "-") {
+            jobs_file.open(batch_path);
+            if (!jobs_file) {
+                cerr << "Error: Could not open batch file " << batch_path << endl;
+                return 1;
+            }
+        }
+        ofstream results_file;
+        if (!results_path.empty()) {
+            results_file.open(results_path, ios::app);
+            if (!results_file) {
+                cerr << "Error: Could not open results file " << results_path << endl;
+                return 1;
+            }
+        }
+        // Result lines get the real stdout (unless --results is given); all other output moves to stderr
+        ostream results_out(results_path.empty() ? cout.rdbuf() : results_file.rdbuf());
+        cout.rdbuf(cerr.rdbuf());
+        int failures = run_batch(batch_path == "-" ? cin : jobs_file, results_out, concurrency, use_cache, progressive, job.timeout_seconds);
+        return stop_requested ? 143 : failures == 0 ? 0 : 1;
+    }
+
+    // Get prompt from command line or user input
+    if (args.size() > 0) {
+        job.prompt = args[0];
+    } else {
+        cout << "Enter prompt: ";
+        getline(cin, job.prompt);
+    }
+
+    // Get num_inference_steps from command line or use default value
+    if (args.size() > 1) {
+        try {
+            job.num_inference_steps = stoi(args[1]);
+        } catch (const invalid_argument& e) {
+            cerr << "Error: Invalid argument for num_inference_steps. Using default value of " << job.num_inference_steps << "." << endl;
+        } catch (const out_of_range& e) {
+            cerr << "Error: Out of range for num_inference_steps. Using default value of " << job.num_inference_steps << "." << endl;
+        }
+    }
+
+    // Get width and height from command line or use default value
+    if (args.size() > 2) {
+        parse_resolution(args[2], job.width, job.height);
+    }
+
+    // Get output filename from command line or use default value
+    if (args.size() > 3) {
+        job.output_filename = args[3];
+    }
+
+    cout << "Prompt: " << job.prompt << " | Negative: " << job.neg_prompt << " | Inference Steps: " << job.num_inference_steps << " | Width: " << job.width << " | Height: " << job.height << " | Output Filename: " << job.output_filename << endl;
+
+    RenderPoller poller(progress_fd >= 0 ? chrono::seconds(1) : chrono::seconds(5)); // Livelier steps for a progress reader
+    ProgressCallback show_progress = [](const string& status, int steps, int total_steps) {
+        float percentage = (float)steps / total_steps * 100.0f;
+        cout << "\rStatus: " << status << " | Progress: " << fixed << setprecision(2) << percentage << "%                                      " << flush;
+    };
+
+    // Progressive mode: save a quick preview, then hand the full-quality pass to a background process
+    if (progressive) {
+        if (fetch_cached_render(job, use_cache)) {
+            return 0;
+        }
+        long long started_ms = epoch_ms();
+        RenderJob preview = preview_job_for(job);
+        cout << "Rendering preview | Inference Steps: " << preview.num_inference_steps << " | Width: " << preview.width << " | Height: " << preview.height << endl;
+        RenderResult preview_result = run_render_job(preview, poller, use_cache, show_progress);
+        if (stop_requested) {
+            return 143;
+        }
+        if (preview_result.status != "error" && preview_only) {
+            cout << "Preview ready: " << job.output_filename << endl;
+            return 0;
+        }
+        if (preview_result.status != "error" && spawn_refinement(job, use_cache, preview_result.total_ms, started_ms)) {
+            cout << "Preview ready: " << job.output_filename << " (full quality render continues in the background)" << endl;
+            return 0;
+        }
+        cerr << "Error: Preview failed, rendering at full quality instead." << endl;
+    }
+
+    RenderResult result = run_render_job(job, poller, use_cache, show_progress);
+
+    if (refine_preview_ms >= 0) {
+        record_progressive_latency(job.output_filename, refine_preview_ms, epoch_ms() - refine_started_ms, result.status);
+    }
+
+    // Exit codes follow timeout(1) and SIGTERM, so callers can tell a deadline from a failure
+    if (result.error == "timed out") {
+        return 124;
+    }
+    if (result.error == "cancelled") {
+        return 143;
+    }
+    return result.status == "error" ? 1 : 0;
 }